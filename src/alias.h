@@ -33,7 +33,10 @@
 // 2. Pointer to lines (alias->lines) is not persistent and must be checked for NULL value. Access to lines
 //    is protected by alias' RWlock (see e.g. alias_is_empty() )
 //
-// TODO: "goto [+|-]NUM|end" command  (only available within an alias) - go to specified line,+-lines, last line
+// CONTROL FLOW:
+// Besides ordinary commands, an alias can contain statements which are only available within an alias:
+// "goto", "loop", "skip" and "break" (see alias_parse_stmt() below). Whenever alias lines are changed, 
+// the alias is compiled into an array of ops (al->prog) which is executed by alias_exec0() with a program counter.
 
 #if COMPILING_ESPSHELL
 #if  WITH_ALIAS
@@ -50,14 +53,57 @@
 // /Aliases/ is an _Atomic pointer
 //
 struct alias {
-  struct alias *next;    // must be first field to be compatible with generic lists routines
-  rwlock_t      rw;      // RW lock to protect /lines/ list
-  argcargv_t   *lines;   // actual alias content (a list of argcargv_t *) TODO: make it _Atomic to simplify alias_is_empty()
-  char          name[0]; // asciiz alias name
+  struct alias    *next;      // must be first field to be compatible with generic lists routines
+  struct alias    *hnext;     // next alias in the same hash bucket (see Alias_hash[] below)
+  uint32_t         hash;      // hash of the /name/
+  rwlock_t         rw;        // RW lock to protect /lines/ list
+  argcargv_t      *lines;     // actual alias content (a list of argcargv_t *) TODO: make it _Atomic to simplify alias_is_empty()
+  struct alias_op *prog;      // compiled /lines/, an array of /prog_len/ elements. Protected by /rw/ 
+  uint16_t         prog_len;  // number of lines in the alias. /prog/ can be NULL even if /prog_len/ is not zero (out of memory)
+  uint8_t          nloops;    // number of "loop" statements in the /prog/
+  bool             trace;     // tracing enabled? (see "alias NAME trace on")
+  struct alias_stats *stats;  // execution statistics, allocated when tracing is enabled. Protected by /rw/
+  char             name[0];   // asciiz alias name
 };
 
 static _Atomic(struct alias *) Aliases = NULL;
 
+// Hash index over alias names. 
+// The /Aliases/ list above is kept for ordered display ("show alias"), while lookups by name
+// (alias_by_name(), "exec NAME", "if ... exec NAME") go through the hash index.
+//
+// Same rules as for the list apply: entries are never removed and existing ->hnext pointers are never
+// modified, so the index is lock-free: insertion is a CAS on the bucket head, readers just walk the chain.
+//
+#define ALIAS_HASH_BITS 6
+#define ALIAS_HASH_SIZE (1 << ALIAS_HASH_BITS)
+
+static _Atomic(struct alias *) Alias_hash[ALIAS_HASH_SIZE] = { 0 };
+
+// FNV-1a hash of an asciiz string
+//
+static uint32_t alias_hash(const char *name) {
+  uint32_t h = 2166136261UL;
+  while (*name) {
+    h ^= (unsigned char)*name++;
+    h *= 16777619UL;
+  }
+  return h;
+}
+
+// Bucket index for the hash value: use upper bits, as they are better mixed by FNV
+#define alias_bucket(_Hash) \
+  ((_Hash) >> (32 - ALIAS_HASH_BITS))
+
+// Search the hash chain starting at /al/ for the /name/ whose hash is /h/
+//
+static struct alias *alias_chain_find(struct alias *al, const char *name, uint32_t h) {
+  for (; al; al = al->hnext)
+    if (al->hash == h && !strcmp(name, al->name)) // can't use loose strcmp here: test and test2 would match
+      break;
+  return al;
+}
+
 // Check if alias is empty.
 // NOTE: calls rw_lock/unlock
 //
@@ -160,26 +206,387 @@ static int alias_show_lines(argcargv_t *s) {
   return i;
 }
 
+// -- Alias tracing --
+//
+// "alias NAME trace on|off|clear" enables per-line timing of the alias: every executed line (op) is timed 
+// with the CPU cycle counter and its start/end cycle counts are recorded into a ring buffer (Alias_trace[]). 
+// Per-line and per-alias statistics are updated as well, see "show alias NAME stats".
+//
+// The interpreter (alias_run()) is specialized by the compiler for both "trace" and "no trace" cases, so the
+// only overhead when tracing is disabled is a single branch per alias execution (see alias_exec0()).
+//
+// NOTE: Statistics are updated without locking (alias is locked for reading only): concurrent executions of the
+//       same alias can lose an update. This is acceptable for statistics.
+// NOTE: Cycle counters are per-core, and 32 bit wide: lines which take longer than 2^32 CPU cycles 
+//       (~17 seconds at 240MHz) will be accounted incorrectly.
+//
+#define ALIAS_TRACE_SIZE 64    // number of entries in the trace ring buffer. Must be a power of 2
+
+// Per-line statistics, in CPU cycles
+struct alias_lstat {
+  uint32_t count;              // number of executions
+  uint32_t max;                // longest execution time
+  uint64_t sum;                // sum of execution times, for the mean value
+};
+
+// Per-alias statistics. Allocated by alias_stats_alloc0(), reset whenever alias lines are changed
+struct alias_stats {
+  uint32_t runs;               // number of alias executions
+  uint32_t max_us;             // longest alias execution time, microseconds
+  uint64_t sum_us;             // sum of alias execution times, microseconds
+  uint16_t nlines;             // number of elements in line[]
+  struct alias_lstat line[0];  // per-line statistics
+};
+
+// A trace ring buffer entry: one executed line
+struct alias_trace {
+  struct alias *al;            // alias
+  uint16_t      line;          // line number, starting from 0
+  uint32_t      start;         // CPU cycle counter when the line was started 
+  uint32_t      end;           //   and when it was finished
+};
+
+static struct alias_trace *Alias_trace = NULL;     // allocated once, when tracing is enabled for the first time
+static _Atomic unsigned int Alias_trace_head = 0;  // next entry to write (wraps, use modulo ALIAS_TRACE_SIZE)
+
+// (Re)allocate statistics for the alias /al/. Statistics are reset.
+// Must be called with the alias locked for writing. Returns /false/ if out of memory: tracing gets disabled then.
+//
+static bool alias_stats_alloc0(struct alias *al) {
+
+  size_t siz = sizeof(struct alias_stats) + al->prog_len * sizeof(struct alias_lstat);
+
+  if (al->stats)
+    q_free(al->stats);
+
+  if ((al->stats = (struct alias_stats *)q_malloc(siz, MEM_ALIAS)) == NULL) {
+    al->trace = false;
+    return false;
+  }
+  memset(al->stats, 0, siz);
+  al->stats->nlines = al->prog_len;
+  return true;
+}
+
+// Account one executed line: update per-line statistics and write a ring buffer entry
+//
+static INLINE void alias_trace_line(struct alias *al, unsigned int pc, uint32_t start, uint32_t end) {
+
+  struct alias_lstat *ls = &al->stats->line[pc];
+  struct alias_trace *tr;
+  uint32_t dt = end - start;
+
+  ls->count++;
+  ls->sum += dt;
+  if (dt > ls->max)
+    ls->max = dt;
+
+  tr = &Alias_trace[atomic_fetch_add_explicit(&Alias_trace_head, 1, memory_order_relaxed) & (ALIAS_TRACE_SIZE - 1)];
+  tr->al = al;
+  tr->line = pc;
+  tr->start = start;
+  tr->end = end;
+}
+
+// Account one alias execution which took /us/ microseconds
+//
+static void alias_trace_run(struct alias *al, uint64_t us) {
+
+  struct alias_stats *st = al->stats;
+  uint32_t t = us > 0xffffffffULL ? 0xffffffff : (uint32_t)us;
+
+  st->runs++;
+  st->sum_us += t;
+  if (t > st->max_us)
+    st->max_us = t;
+}
+
+// -- Alias compiler --
+//
+// Control flow statements, only available within an alias:
+//
+// "goto [+|-]NUM|end [if COND]" : jump to line NUM, NUM lines forward or backward, or to the end of the alias
+// "loop [-]NUM COUNT"           : jump back to line NUM (or NUM lines back) until this line is reached COUNT times
+// "skip [NUM] if COND"          : skip NUM lines (default is 1) if COND is true
+// "break [if COND]"             : stop alias execution
+//
+// COND is either "low PIN", "high PIN" or a variable condition "$NAME eq|ne|lt|gt|le|ge VALUE" (see convar.h)
+//
+// Alias lines are compiled into an array of ops, one op per line: statements are parsed once, so executing
+// a "goto" costs a condition test, and ordinary lines are executed by calling their precached command handlers.
+// "skip" and "break" are compiled to "goto"
+//
+// "var NAME VALUE" lines are compiled too: the variable is resolved and the value is converted once, so
+// executing such line is a memcpy() (see alias_compile_var())
+//
+#define ALIAS_OP_LINE  0       // ordinary command
+#define ALIAS_OP_GOTO  1       // "goto", "skip" and "break"
+#define ALIAS_OP_LOOP  2       // "loop"
+#define ALIAS_OP_VAR   3       // "var NAME VALUE"
+
+#define ALIAS_COND_NONE 0      // unconditional
+#define ALIAS_COND_LOW  1      // "if low PIN"
+#define ALIAS_COND_HIGH 2      // "if high PIN"
+#define ALIAS_COND_VAR  3      // "if $NAME OP VALUE"
+
+#define ALIAS_MAX_LOOPS 8      // max number of "loop" statements per alias: loop counters live on the stack
+
+struct alias_op {
+  argcargv_t        *aa;       // the line
+  uint16_t           target;   // jump target (an index in the alias prog[])
+  uint16_t           count;    // "loop" : number of iterations
+  uint8_t            code;     // ALIAS_OP_LINE ... ALIAS_OP_VAR
+  uint8_t            slot;     // "loop" : index of the loop counter
+  uint8_t            cond;     // ALIAS_COND_NONE ... ALIAS_COND_VAR
+  uint8_t            pin;      // GPIO for ALIAS_COND_LOW/ALIAS_COND_HIGH
+  struct convar_cond var;      // variable condition for ALIAS_COND_VAR; variable and its new value for ALIAS_OP_VAR
+};
+
+// Is /name/ a control flow statement? Names must match exactly to not shadow ordinary commands
+//
+static bool alias_is_stmt(const char *name) {
+  return !strcmp(name, "goto") || !strcmp(name, "loop") || !strcmp(name, "skip") || !strcmp(name, "break");
+}
+
+// Read a jump target: "end", "+NUM", "-NUM" or "NUM" (a line number). 
+// /pc/ is the index of the statement line, /n/ is the number of lines in the alias.
+// Returns a negative value if /p/ is not a valid target
+//
+static int alias_parse_target(const char *p, unsigned int pc, unsigned int n) {
+
+  unsigned int num;
+
+  if (!q_strcmp(p, "end"))
+    return n;
+
+  if ((num = q_atol(p[0] == '+' || p[0] == '-' ? p + 1 : p, DEF_BAD)) == DEF_BAD)
+    return -1;
+
+  if (p[0] == '+')
+    return pc + num;
+  if (p[0] == '-')
+    return num > pc ? -1 : (int)(pc - num);
+
+  return num ? (int)num - 1 : -1;
+}
+
+// Parse "if COND" at argv[i]. COND must be the last thing on the line
+//
+static int alias_parse_cond(int argc, char **argv, unsigned int i, struct alias_op *op) {
+
+  unsigned int pin;
+
+  if (q_strcmp(argv[i], "if"))
+    return i;
+
+  if (++i >= argc)
+    return CMD_MISSING_ARG;
+
+  if (!q_strcmp(argv[i], "low") || !q_strcmp(argv[i], "high")) {
+    if (i + 1 >= argc)
+      return CMD_MISSING_ARG;
+    if (!pin_exist((pin = q_atol(argv[i + 1], DEF_BAD))))
+      return i + 1;
+    op->cond = argv[i][0] == 'l' ? ALIAS_COND_LOW : ALIAS_COND_HIGH;
+    op->pin = pin;
+    i += 2;
+  } else {
+    int err;
+
+    if ((err = convar_cond_parse(argc, argv, &i, &op->var, false)) != 0)
+      return err;
+    op->var.name = NULL; // may point to a static buffer, not used by the interpreter
+    op->cond = ALIAS_COND_VAR;
+  }
+  return i < argc ? i : 0;
+}
+
+// Parse a control flow statement /p/ located at line index /pc/ of an alias which has /n/ lines.
+// Fills the /op/. Returns 0 on success, or an error code (CMD_MISSING_ARG or an index of a bad argument)
+//
+// Forward jumps beyond the last line are accepted (lines can be added later) and are clamped by alias_compile0()
+//
+static int alias_parse_stmt(argcargv_t *p, unsigned int pc, unsigned int n, struct alias_op *op) {
+
+  int argc = p->argc, t;
+  char **argv = p->argv;
+  unsigned int num;
+
+  memset(op, 0, sizeof(*op));
+  op->aa = p;
+  op->code = ALIAS_OP_GOTO;
+
+  // "break [if COND]"
+  if (!strcmp(argv[0], "break")) {
+    op->target = n;
+    return argc > 1 ? alias_parse_cond(argc, argv, 1, op) : 0;
+  }
+
+  // "skip [NUM] if COND"
+  if (!strcmp(argv[0], "skip")) {
+    unsigned int i = 1;
+    num = 1;
+    if (argc > 1 && q_isnumeric(argv[1])) {
+      if ((num = q_atol(argv[1], 0)) < 1)
+        return 1;
+      i = 2;
+    }
+    if (i >= argc)
+      return CMD_MISSING_ARG;
+    op->target = pc + num + 1;
+    return alias_parse_cond(argc, argv, i, op);
+  }
+
+  if (argc < 2)
+    return CMD_MISSING_ARG;
+
+  if ((t = alias_parse_target(argv[1], pc, n)) < 0)
+    return 1;
+  op->target = t;
+
+  // "goto [+|-]NUM|end [if COND]"
+  if (!strcmp(argv[0], "goto"))
+    return argc > 2 ? alias_parse_cond(argc, argv, 2, op) : 0;
+
+  // "loop [-]NUM COUNT"
+  if (t > pc) {
+    HELP(q_print("% <e>\"loop\" can only jump backwards</>\r\n"));
+    return 1;
+  }
+  if (argc < 3)
+    return CMD_MISSING_ARG;
+  if ((num = q_atol(argv[2], 0)) < 1 || num > 0xffff)
+    return 2;
+  if (argc > 3)
+    return 3;
+  op->code = ALIAS_OP_LOOP;
+  op->count = num;
+  return 0;
+}
+
+// Try to compile "var NAME VALUE" line into an ALIAS_OP_VAR op. Lines which can not be compiled
+// (unknown variable, bad value, "var ADDRESS ...", background execution) are left as ALIAS_OP_LINE: errors
+// will be reported by cmd_var() when the line is executed
+//
+static void alias_compile_var(struct alias_op *op) {
+
+  argcargv_t *p = op->aa;
+  struct convar_handle h;
+
+  if (p->gpp != cmd_var || p->argc != 3 || p->has_amp || p->argv[2][0] == '&' || q_isnumeric(p->argv[1]))
+    return;
+
+  if (!convar_resolve(p->argv[1], &h, false) || convar_parse_value(&h, p->argv[2], &op->var.imm, false) != 0)
+    return;
+
+  op->var.ptr = h.ptr;
+  op->var.size = h.size;
+  op->code = ALIAS_OP_VAR;
+}
+
+// (Re)compile alias lines: build an array of ops (al->prog). Must be called with the alias locked for writing, 
+// every time alias lines are changed. 
+// On failure (out of memory) al->prog is NULL and alias can not be executed
+//
+static void alias_compile0(struct alias *al) {
+
+  argcargv_t *p;
+  struct alias_op *op;
+  unsigned int n = 0, pc;
+
+  if (al->prog) {
+    q_free(al->prog);
+    al->prog = NULL;
+  }
+  al->nloops = 0;
+
+  for (p = al->lines; p; p = p->next)
+    n++;
+
+  al->prog_len = n;
+
+  // Lines were changed: reset statistics
+  if (al->stats)
+    alias_stats_alloc0(al);
+
+  if (n == 0)
+    return;
+
+  if ((al->prog = (struct alias_op *)q_malloc(n * sizeof(struct alias_op), MEM_ALIAS)) == NULL) {
+    q_printf("%% Alias \"%s\": out of memory, alias can not be executed\r\n", al->name);
+    return;
+  }
+
+  for (pc = 0, p = al->lines; p; p = p->next, pc++) {
+
+    op = &al->prog[pc];
+
+    if (!alias_is_stmt(p->argv[0])) {
+      memset(op, 0, sizeof(*op));
+      op->aa = p;
+      alias_compile_var(op);
+      continue;
+    }
+
+    // Statements were checked when they were added to the alias, but jump targets could go out
+    // of range since then, because of deleted lines. 
+    if (alias_parse_stmt(p, pc, n, op) != 0) {
+      q_printf("%% Alias \"%s\", line %u: syntax error, line is ignored\r\n", al->name, pc + 1);
+      memset(op, 0, sizeof(*op));
+      op->aa = p;
+      op->code = ALIAS_OP_GOTO;
+      op->target = pc + 1;
+      continue;
+    }
+
+    if (op->target > n) {
+      VERBOSE(q_printf("%% Alias \"%s\", line %u: jump target is beyond the last line, using \"end\"\r\n", al->name, pc + 1));
+      op->target = n;
+    }
+
+    if (op->code == ALIAS_OP_LOOP) {
+      if (al->nloops >= ALIAS_MAX_LOOPS) {
+        q_printf("%% Alias \"%s\", line %u: too many loops (max is " xstr(ALIAS_MAX_LOOPS) "), line is ignored\r\n", al->name, pc + 1);
+        op->code = ALIAS_OP_GOTO;
+        op->target = pc + 1;
+      } else
+        op->slot = al->nloops++;
+    }
+  }
+}
+
+// Evaluate the condition of a "goto" op
+//
+static INLINE bool alias_cond_test(const struct alias_op *op) {
+  switch (op->cond) {
+    case ALIAS_COND_LOW:  return digitalForceRead(op->pin) == LOW;
+    case ALIAS_COND_HIGH: return digitalForceRead(op->pin) == HIGH;
+    case ALIAS_COND_VAR:  return convar_cond_test(&op->var);
+    default: break;
+  }
+  return true;
+}
+
 // Find an alias descriptor by alias name
 // Lockless version
 //
 struct alias *alias_by_name(const char *name) {
-  struct alias *al = atomic_load_explicit(&Aliases, memory_order_acquire);
-  // once al is loaded it is safe to walk through the list even if it is being modified: modification happens
-  // only to the /Aliases/ variable itself, no existing ->next pointers are modified
-  if (likely(name && *name))
-    for (; al; al = al->next)
-      //if (!q_strcmp(name, al->name))
-      if (!strcmp(name, al->name)) // can't use loose strcmp here: test and test2 would match
-        break;
-  return al;
+  if (likely(name && *name)) {
+    uint32_t h = alias_hash(name);
+    // once the bucket head is loaded it is safe to walk through the chain even if it is being modified: modification
+    // happens only to the bucket head itself, no existing ->hnext pointers are modified
+    return alias_chain_find(atomic_load_explicit(&Alias_hash[alias_bucket(h)], memory_order_acquire), name, h);
+  }
+  return NULL;
 }
 
 // Create new, empty alias OR find existing one
 //
 struct alias *alias_create_or_find(const char *name) {
 
-  struct alias *al;
+  struct alias *al, *head, *found;
+  _Atomic(struct alias *) *bucket;
+  uint32_t h;
 
   if (!name)
     return NULL;
@@ -190,8 +597,27 @@ struct alias *alias_create_or_find(const char *name) {
     if ((al = (struct alias *)q_malloc(sizeof(struct alias) + siz + 1, MEM_ALIAS)) != NULL) {
       strlcpy(al->name, name, siz + 1);
       al->lines = NULL;
+      al->prog = NULL;
+      al->prog_len = 0;
+      al->nloops = 0;
+      al->trace = false;
+      al->stats = NULL;
+      al->hash = h = alias_hash(name);
       rwlock_t tmp = RWLOCK_INITIALIZER_UNLOCKED;
       al->rw = tmp;
+
+      // insert into the hash bucket, lockless version. If the bucket head has changed, then someone else
+      // has inserted an alias into the same bucket: check that it is not an alias with the same name
+      bucket = &Alias_hash[alias_bucket(h)];
+      head = atomic_load_explicit(bucket, memory_order_acquire);
+      do {
+        if ((found = alias_chain_find(head, name, h)) != NULL) {
+          q_free(al);
+          return found;
+        }
+        al->hnext = head;
+      } while(!atomic_compare_exchange_strong_explicit(bucket, &head, al, memory_order_release, memory_order_acquire));
+
       // insert into the list head, lockless version
       do {
         al->next = atomic_load_explicit(&Aliases, memory_order_relaxed);
@@ -203,6 +629,72 @@ struct alias *alias_create_or_find(const char *name) {
 }
 
 
+// Display alias statistics collected while tracing was enabled: per-alias and per-line, followed by 
+// the most recent trace entries of this alias. Alias must be locked by the caller
+//
+static void alias_show_stats0(struct alias *al) {
+
+  struct alias_stats *st = al->stats;
+  struct alias_lstat *ls;
+  struct alias_trace *tr;
+  unsigned int i, head, n;
+  uint64_t ops, cycles;
+
+  if (!st) {
+    HELP(q_printf("%% No statistics. Use \"<i>alias %s trace on</>\" to enable tracing\r\n", al->name));
+    return;
+  }
+
+  q_printf("%% Alias \"%s\" : tracing is %s, executed %lu times, mean time %lu us, max %lu us\r\n",
+           al->name, 
+           al->trace ? "enabled" : "disabled", 
+           st->runs, 
+           st->runs ? (unsigned long)(st->sum_us / st->runs) : 0, 
+           st->max_us);
+
+  // Interpreter speed: executed ops, and the time spent outside of the lines, i.e. by the interpreter
+  // itself (dispatch, jumps, killpoints; tracing costs included). Compare with the cost of spawning a task
+  // per alias execution, which the interpreter has replaced
+  for (ops = cycles = i = 0; i < st->nlines; i++) {
+    ops += st->line[i].count;
+    cycles += st->line[i].sum;
+  }
+  if (ops) {
+    float overhead = (float)st->sum_us - (float)cycles / CPUFreq;
+    q_printf("%% Executed %llu ops, %.2f us per op, interpreter overhead %.2f us per op\r\n",
+             ops, (float)st->sum_us / ops, overhead > 0 ? overhead / ops : 0.0f);
+  }
+
+  q_print("% Line |   Count    | Mean, cycles | Max, cycles  | Mean, us | Command\r\n"
+          "%------+------------+--------------+--------------+----------+-----------\r\n");
+
+  for (i = 0; i < st->nlines && i < al->prog_len; i++) {
+    uint32_t mean;
+    ls = &st->line[i];
+    mean = ls->count ? (uint32_t)(ls->sum / ls->count) : 0;
+    q_printf("%% %4u | %10lu | %12lu | %12lu | %8.2f | ", i + 1, ls->count, mean, ls->max, (float)mean / CPUFreq);
+    if (al->prog)
+      userinput_show(al->prog[i].aa);
+    q_print(CRLF);
+  }
+
+  if (Alias_trace == NULL)
+    return;
+
+  // Walk the ring buffer from the oldest entry to the newest one
+  q_print("% Recent lines (CPU cycles):\r\n");
+  head = atomic_load_explicit(&Alias_trace_head, memory_order_relaxed);
+  for (n = 0, i = head; i < head + ALIAS_TRACE_SIZE; i++) {
+    tr = &Alias_trace[i & (ALIAS_TRACE_SIZE - 1)];
+    if (tr->al == al) {
+      q_printf("%% line %3u : start %10lu, end %10lu (%lu cycles)\r\n", tr->line + 1, tr->start, tr->end, tr->end - tr->start);
+      n++;
+    }
+  }
+  if (!n)
+    q_print("% None\r\n");
+}
+
 //"alias NAME"
 // Create/find an alias, set pointer to that alias as a Context, 
 // switch command list, change the prompt
@@ -235,6 +727,58 @@ static int cmd_alias_if(int argc, char **argv) {
   return CMD_FAILED;
 }
 
+// "alias NAME trace on|off|clear"
+// Enable/disable alias tracing, reset statistics (see "show alias NAME stats")
+//
+static int cmd_alias_trace(int argc, char **argv) {
+
+  struct alias *al;
+  bool ok = true;
+
+  if (argc < 4)
+    return CMD_MISSING_ARG;
+
+  if (q_strcmp(argv[2], "trace"))
+    return 2;
+
+  if ((al = alias_by_name(argv[1])) == NULL) {
+    q_printf("%% Unknown alias \"%s\" (\"<i>show alias</>\" to list names)\r\n", argv[1]);
+    return CMD_FAILED;
+  }
+
+  if (!q_strcmp(argv[3], "on")) {
+    // The ring buffer is shared by all aliases and is never freed
+    if (Alias_trace == NULL) {
+      if ((Alias_trace = (struct alias_trace *)q_malloc(ALIAS_TRACE_SIZE * sizeof(struct alias_trace), MEM_ALIAS)) == NULL)
+        return CMD_FAILED;
+      memset(Alias_trace, 0, ALIAS_TRACE_SIZE * sizeof(struct alias_trace));
+    }
+    rw_lockw(&al->rw);
+    if (al->stats || (ok = alias_stats_alloc0(al)) == true)
+      al->trace = true;
+    rw_unlockw(&al->rw);
+  } else if (!q_strcmp(argv[3], "off")) {
+    rw_lockw(&al->rw);
+    al->trace = false;
+    rw_unlockw(&al->rw);
+  } else if (!q_strcmp(argv[3], "clear")) {
+    rw_lockw(&al->rw);
+    if (al->stats)
+      ok = alias_stats_alloc0(al);
+    rw_unlockw(&al->rw);
+  } else
+    return 3;
+
+  if (!ok) {
+    q_print("% Out of memory, tracing is disabled\r\n");
+    return CMD_FAILED;
+  }
+
+  HELP(q_printf("%% Alias \"%s\" tracing is %s (\"<i>show alias %s stats</>\" to see results)\r\n", 
+                al->name, al->trace ? "enabled" : "disabled", al->name));
+  return 0;
+}
+
 // "quit" : replacement for "exit": command "exit" can belong to alias
 //
 static int cmd_alias_quit(int argc, char **argv) {
@@ -269,7 +813,7 @@ static int cmd_show_alias(int argc, char **argv) {
     if ((al = atomic_load_explicit(&Aliases, memory_order_acquire)) != NULL) {
       q_print("% List of defined aliases:\r\n");
       for (i = 1; al != NULL ; ++i, al = al->next)
-        q_printf("%% %d. \"%s\"%s\r\n",i,al->name,al->lines ? "" : ", empty");
+        q_printf("%% %d. \"%s\"%s%s\r\n",i,al->name,al->lines ? "" : ", empty", al->trace ? ", tracing" : "");
       HELP(q_print("% Use command \"<i>show alias NAME</>\" to display alias content\r\n"));
     } else
       HELP(q_print("% No aliases defined. (\"<i>alias NAME</>\" to create one)\r\n"));
@@ -278,7 +822,11 @@ static int cmd_show_alias(int argc, char **argv) {
     al = alias_by_name(argv[2]);
     if (al) {
       rw_lockr(&al->rw);
-      alias_show_lines(al->lines);
+      // "show alias NAME stats"
+      if (argc > 3 && !q_strcmp(argv[3], "stats"))
+        alias_show_stats0(al);
+      else
+        alias_show_lines(al->lines);
       rw_unlockr(&al->rw);
     }
     else
@@ -296,8 +844,9 @@ static int cmd_show_alias(int argc, char **argv) {
 static int cmd_alias_delete(int argc, char **argv) {
   THIS_ALIAS(al); // Fetch pointer to the alias we are editing
   rw_lockw(&al->rw);
-  alias_delete_line(&al->lines, argc > 1 ? q_atoi(argv[1],-1)
-                                         : 0);
+  if (alias_delete_line(&al->lines, argc > 1 ? q_atoi(argv[1],-1)
+                                             : 0))
+    alias_compile0(al);
   rw_unlockw(&al->rw);                                         
   return 0;
 }
@@ -327,6 +876,20 @@ static int cmd_alias_asterisk(int argc, char **argv) {
   // This pointer *must not* be used outside of this (alias editing) scope
   AA->gpp = NULL;
 
+  // Control flow statements ("goto", "loop", ...) have no handlers: check their syntax now, rather than
+  // on execution. Jump targets are relative to the line being added
+  if (alias_is_stmt(argv[0])) {
+    struct alias_op op;
+    int bad;
+
+    rw_lockr(&al->rw);
+    bad = alias_parse_stmt(AA, al->prog_len, al->prog_len + 1, &op);
+    rw_unlockr(&al->rw);
+    if (bad != 0)
+      return bad;
+    goto add_line;
+  }
+
   // Precache the command handler. Precaching will save time on first time alias is executed. Once alias was 
   // executed it remembers associated command handler to skip handler search process for subsequent execs (aliases usually
   // executed more than once)
@@ -347,9 +910,11 @@ static int cmd_alias_asterisk(int argc, char **argv) {
   keywords_set_ptr(tmp);
 
   //q_printf("\r\nPrecached handler %p\r\n",AA->gpp);
-
+add_line:
   rw_lockw(&al->rw);
   bool res = alias_add_line(&al->lines,AA);
+  if (res)
+    alias_compile0(al);
   rw_unlockw(&al->rw);
 
   if (res)
@@ -362,25 +927,190 @@ static int cmd_alias_asterisk(int argc, char **argv) {
 // TODO:"esp32-alias>save /FILENAME"
 // TODO: "esp32>alias NAME|* save /FILENAME"
 
-// Execute an alias: lock it for reading, go  through stored argcargv_t lists
-// and send them to the command processor. We do increment line's refcount before calling espshell_command()
-// because espshell_command() decrements it
+// Execute an alias: lock it for reading, run the compiled alias (al->prog) starting from its first line.
 //
-static int alias_exec(struct alias *al) {
+// Lines whose command handlers are known (precached) are executed by calling their handlers directly.
+// Other lines (background commands, commands from subdirectories which were not precached) are sent to the 
+// command processor. We do increment line's refcount before calling espshell_command() because 
+// espshell_command() decrements it
+//
+// alias_run() is the interpreter itself; /trace/ is a compile-time constant: see alias_exec0()
+//
+static INLINE int alias_run(struct alias *al, const bool trace) {
 
-  int ret = 0;
+  int ret = 0, bad;
+  unsigned int pc = 0, next;
+  uint16_t loops[ALIAS_MAX_LOOPS] = { 0 }; // "loop" counters, per execution
+  uint32_t t0 = 0;
+  uint64_t run0 = 0;
+  struct alias_op *op;
   argcargv_t *p;
-    
+  bool is_fore = is_foreground_task();
+
+  if (trace)
+    run0 = q_micros();
+
+  while (pc < al->prog_len) {
+
+    op = &al->prog[pc];
+    next = pc + 1;
+
+    if (trace)
+      t0 = cpu_ticks();
+
+    switch (op->code) {
+
+      case ALIAS_OP_GOTO:
+        if (alias_cond_test(op))
+          next = op->target;
+        break;
+
+      case ALIAS_OP_LOOP:
+        if (++loops[op->slot] < op->count)
+          next = op->target;
+        else
+          loops[op->slot] = 0; // reset the counter, so nested loops work
+        break;
+
+      case ALIAS_OP_VAR:
+        memcpy(op->var.ptr, &op->var.imm, op->var.size);
+        break;
+
+      default:
+        p = op->aa;
+        if (likely(p->gpp && !p->has_amp && p->argv[p->argc - 1][0] != '&')) {
+          if ((bad = p->gpp(p->argc, p->argv)) != 0)
+            espshell_display_error(bad, p->argc, p->argv);
+        } else {
+          userinput_ref(p);                   // espshell_command() does unref()
+          bad = espshell_command(NULL, p);
+        }
+        if (bad != 0) {
+          ret = CMD_FAILED; // if there were errors during execution, signal it as generic error:
+                            // no point in returning real code as it makes sence only for a particular argcargv, not for command "exec"
+          HELP(q_printf("%% Alias \"%s\" execution was interrupted because of errors (line %u)\r\n",al->name, pc + 1));
+          goto finished;
+        }
+    }
+
+    if (trace)
+      alias_trace_line(al, pc, t0, cpu_ticks());
+
+    // A killpoint: backward jumps can make an alias to run forever (e.g. "goto -1")
+    if (next <= pc) {
+      if (is_fore) {
+        if (anykey_pressed()) {
+          HELP(q_printf("%% Alias \"%s\" execution was interrupted by a keypress\r\n", al->name));
+          ret = CMD_FAILED;
+          goto finished;
+        }
+      } else {
+        uint32_t sig = 0;
+        if (task_wait_for_signal(&sig, 0))
+          if (sig == SIGNAL_TERM || sig == SIGNAL_KILL) {
+            ret = CMD_FAILED;
+            goto finished;
+          }
+      }
+    }
+    pc = next;
+  }
+finished:
+  if (trace)
+    alias_trace_run(al, q_micros() - run0);
+  return ret;
+}
+
+// Same as alias_exec() below, but expects the alias to be locked by the caller
+//
+static int alias_exec0(struct alias *al) {
+
+  if (unlikely(al->prog == NULL)) {
+    if (al->prog_len) {
+      q_printf("%% Alias \"%s\" is not compiled (out of memory?)\r\n", al->name);
+      return CMD_FAILED;
+    }
+    return 0;
+  }
+
+  // al->trace is only set if al->stats are allocated
+  return unlikely(al->trace) ? alias_run(al, true) 
+                             : alias_run(al, false);
+}
+
+static int alias_exec(struct alias *al) {
+
+  int ret;
+
   rw_lockr(&al->rw);
-    
+  ret = alias_exec0(al);
+  rw_unlockr(&al->rw);
+  return ret;
+}
+
+// Inline execution.
+//
+// Aliases triggered by "if" and "every" events are normally executed by a newly created task
+// (see alias_exec_in_background()), which costs a helper_arg, a copy of the Cwd and a task creation:
+// milliseconds. Short aliases which can not block (e.g. "pin 2 toggle") can be executed directly
+// by ifc_task() instead, which takes microseconds.
+//
+// An alias can be executed inline if it has no more than ALIAS_INLINE_MAX_LINES lines and every
+// line is a "pin", "pwm", "var" or "echo" command without "delay", "loop" or "&". This is checked on
+// every execution, because an alias can be edited at any time.
+//
+#define ALIAS_INLINE_MAX_LINES 4
+
+// Check if alias can be executed inline. Alias must be locked by the caller
+//
+static bool alias_is_inlineable0(struct alias *al) {
+
+  argcargv_t *p;
+  int i, n = 0;
+
   for (p = al->lines; p; p = p->next) {
-    userinput_ref(p);                   // espshell_command() does unref()
-    if (espshell_command(NULL, p) != 0) {// execute
-      ret = CMD_FAILED; // if there were errors during execution, signal it as generic error:
-                        // no point in returning real code as it makes sence only for a particular argcargv, not for command "exec"
-      HELP(q_printf("%% Alias \"%s\" execution was interrupted because of errors\r\n",al->name));
-      break;
-    }
+
+    if (++n > ALIAS_INLINE_MAX_LINES)
+      return false;
+
+    // Command handlers are precached when lines are added to the alias (see cmd_alias_asterisk()):
+    // no need to search for the command by its name
+    if (p->gpp != cmd_pin && p->gpp != cmd_pwm && p->gpp != cmd_var && p->gpp != cmd_echo)
+      return false;
+
+    if (p->has_amp || p->argv[p->argc - 1][0] == '&')
+      return false;
+
+    for (i = 1; i < p->argc; i++)
+      if (!q_strcmp(p->argv[i], "delay") || !q_strcmp(p->argv[i], "loop"))
+        return false;
+  }
+  return true;
+}
+
+static bool alias_is_inlineable(struct alias *al) {
+
+  bool ret;
+
+  rw_lockr(&al->rw);
+  ret = alias_is_inlineable0(al);
+  rw_unlockr(&al->rw);
+  return ret;
+}
+
+// Execute an alias in the context of the caller, if the alias is inlineable. 
+// /ifc/ and /tsta/ are the same as for alias_exec_in_background_ifc() and can be NULL and 0.
+// Returns /false/ if the alias can not be executed inline (and was not executed)
+//
+static bool alias_exec_inline(struct alias *al, struct ifcond *ifc, uint64_t tsta) {
+
+  bool ret;
+
+  rw_lockr(&al->rw);
+  if ((ret = alias_is_inlineable0(al)) == true) {
+    if (ifc)
+      ifc_account_latency(ifc, tsta);
+    alias_exec0(al);
   }
   rw_unlockr(&al->rw);
   return ret;
@@ -402,6 +1132,10 @@ static void alias_helper_task(void *arg) {
     if (ha->cwd)
       q_free(ha->cwd); // it was strdup()ed in ha_get()
 
+    // Alias was triggered by an "if" or "every" event: account the latency
+    if (ha->ifc)
+      ifc_account_latency(ha->ifc, ha->tsta);
+
     // delay, if required
     if (ha->delay_ms)
       q_delay(ha->delay_ms);
@@ -414,9 +1148,17 @@ static void alias_helper_task(void *arg) {
 
 // Execute alias as if it was with "&" symbol at the end 
 #define alias_exec_in_background(_Alias) \
-          alias_exec_in_background_delayed(_Alias, 0)
+          alias_exec_in_background0(_Alias, 0, NULL, 0)
+
+// Same as above, but with an initial delay
+#define alias_exec_in_background_delayed(_Alias, _Delay) \
+          alias_exec_in_background0(_Alias, _Delay, NULL, 0)
+
+// Same as above, but alias is executed in response to an ifcond event which happened at /_Tsta/
+#define alias_exec_in_background_ifc(_Alias, _Ifc, _Tsta) \
+          alias_exec_in_background0(_Alias, 0, _Ifc, _Tsta)
 
-static int alias_exec_in_background_delayed(struct alias *al, uint32_t delay_ms) {
+static int alias_exec_in_background0(struct alias *al, uint32_t delay_ms, struct ifcond *ifc, uint64_t tsta) {
   struct helper_arg *ha;
 
 // TODO: currently here is no mechanism to tell ESPShell which core to use for alias execution
@@ -426,6 +1168,8 @@ static int alias_exec_in_background_delayed(struct alias *al, uint32_t delay_ms)
       // ha->aa = NULL; maybe?
       ha->al = al;
       ha->delay_ms = delay_ms;
+      ha->ifc = ifc;
+      ha->tsta = tsta;
       return task_new(alias_helper_task,
                       ha,
                       al->name,
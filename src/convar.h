@@ -22,21 +22,30 @@
 // Registered variables are accessible through the "var" command:
 //   "var VARIABLE_NAME"           - display the variable (or an array element)
 //   "var VARIABLE_NAME VALUE"     - set the variable to a new value
+//   "var VARIABLE_NAME hex|dec|float" - display the variable (or an array) in a different format
 // Individual array elements (whether real arrays or pointers) can be accessed as VARIABLE_NAME[INDEX].
 //
+// Supported types are integers of 1,2,4 and 8 bytes, float and double, pointers and arrays of these.
+// Fields of an array of structures are registered as a separate array (see convar_addfa() in "espshell.h"):
+// such arrays have their elements located /stride/ bytes apart.
+//
 // TODO: Review this code. Possible buffer overflows may occur due to use of strcpy and sprintf. 
 // TODO: These should be replaced with strlcpy and snprintf.
 // TODO: Verify that variables with names longer than CONVAR_NAMELEN_MAX - 1 cannot be registered.
-// TODO: Add support "long long", 64bit type
 // TODO: Parse array sizes "[NUM]"
 
 //
 // "Console Variable" (convar) descriptors are created by convar_add() 
 // and linked into a singly linked list (head is "var_head"). 
 // Entries are created once and never deleted.
+//
+// Name lookups go through an index (see convar_find()): a hash table for exact names and a sorted
+// array for partial (shortened) names.
 
 struct convar {
   struct convar *next;     // next var in list
+  struct convar *hnext;    // next var in the same hash bucket (see Var_hash[])
+  uint32_t hash;           // hash of the /name/
   const char *name;        // var name
   void *ptr;               // &var or &gpp
   void *gpp;               // helper pointer to handle arrays 
@@ -48,28 +57,36 @@ struct convar {
   unsigned int ispa :  1;    // -- pointer ?
   unsigned int isua :  1;    // -- unsigned ?
     
-  unsigned int size:  3;    // variable size (1,2 or 4 bytes)
-  unsigned int sizea: 22;   // if variable is a pointer (or an array) then this field contains sizeof(array_element)
+  unsigned int size:  4;    // variable size (1,2,4 or 8 bytes)
+  unsigned int sizea: 21;   // if variable is a pointer (or an array) then this field contains sizeof(array_element)
                             // if, however, it is 0, then this means a generic pointer (memory size is unknown)
                             // this happens when accessing array elements, due to implementation. Fixing it requires too much effort.
   unsigned int counta;      // sizeof(array)/sizeof(array_element, i.e. nnumber of elements in the array)
+  unsigned int stride;      // distance between array elements, if it is not /sizea/ (fields of an array of structures)
 };
 
+// Distance between array elements, bytes
+#define convar_stride(_Var) \
+  ((_Var)->stride ? (_Var)->stride : (_Var)->sizea)
+
 // Composite variable value .
 // This is to perform "unsafe" C-style casts
 //
 typedef union composite_u {
-  unsigned char  uchar;  // unsigned char
-  signed char    ichar;  // signed --
-  unsigned short ush;    // unsigned short
-  signed short   ish;    // signed --
-  int            ival;   // signed int
-  unsigned int   uval;   // unsigned --
-  float          fval;   // float
+  unsigned char      uchar;  // unsigned char
+  signed char        ichar;  // signed --
+  unsigned short     ush;    // unsigned short
+  signed short       ish;    // signed --
+  int                ival;   // signed int
+  unsigned int       uval;   // unsigned --
+  float              fval;   // float
+  long long          llval;  // signed long long
+  unsigned long long ullval; // unsigned --
+  double             dval;   // double
 } composite_t;
 
 // Limits
-#define ARRAY_TOO_BIG       257 // don't display array content if its elements count exceeeds this number
+#define ARRAY_LONG          256 // arrays longer than this are displayed with a hint on how to interrupt the output
 
 #define CONVAR_NAMELEN_MAX  64 // max variable name length
 #define CONVAR_TYPELEN_MAX  32 // should be enough even for "unsigned long long"
@@ -85,11 +102,276 @@ typedef union composite_u {
 //       
 static struct convar *var_head = NULL;
 
+// Variables index.
+// Exact names are looked up in the hash table. Partial names ("var te" for "temperature") are looked up 
+// in the array of variables, sorted by name: all names starting with the same prefix are adjacent there, 
+// so one binary search finds the match and the next entry tells if there is an ambiguity.
+//
+// The hash table is updated on registration. The sorted array is rebuilt lazily, by the first lookup which 
+// misses the hash table after new variables were registered. 
+//
+#define VAR_HASH_BITS 6
+#define VAR_HASH_SIZE (1 << VAR_HASH_BITS)
+
+static struct convar  *Var_hash[VAR_HASH_SIZE] = { 0 };
+static struct convar **Var_sorted = NULL;      // array of /Var_sorted_count/ pointers, sorted by name
+static unsigned int    Var_sorted_count = 0;
+static unsigned int    Var_count = 0;          // number of registered variables
+static mutex_t         Var_mux = MUTEX_INIT;   // protects Var_sorted
+
+// FNV-1a hash of an asciiz string
+//
+static uint32_t convar_hash(const char *name) {
+  uint32_t h = 2166136261UL;
+  while (*name) {
+    h ^= (unsigned char)*name++;
+    h *= 16777619UL;
+  }
+  return h;
+}
+
+// Bucket index for the hash value: use upper bits, as they are better mixed by FNV
+#define convar_bucket(_Hash) \
+  ((_Hash) >> (32 - VAR_HASH_BITS))
+
+// Link new variable descriptor to the list and to the hash table.
+// Sorted array is rebuilt by the next partial name lookup
+//
+static void convar_link(struct convar *var) {
+
+  var->hash = convar_hash(var->name);
+  var->hnext = Var_hash[convar_bucket(var->hash)];
+  Var_hash[convar_bucket(var->hash)] = var;
+
+  var->next = var_head;
+  var_head = var;
+  Var_count++;
+}
+
+static int convar_sort_cb(const void *a, const void *b) {
+  return strcmp((*(struct convar * const *)a)->name, (*(struct convar * const *)b)->name);
+}
+
+// Rebuild the sorted array. Must be called with Var_mux locked
+//
+static void convar_sort0() {
+
+  struct convar *var, **arr;
+  unsigned int i, count = Var_count;
+
+  if ((arr = (struct convar **)q_malloc(count * sizeof(struct convar *), MEM_STATIC)) == NULL)
+    return;
+
+  for (i = 0, var = var_head; var && i < count; var = var->next)
+    arr[i++] = var;
+
+  qsort(arr, i, sizeof(struct convar *), convar_sort_cb);
+
+  if (Var_sorted)
+    q_free(Var_sorted);
+  Var_sorted = arr;
+  Var_sorted_count = i;
+}
+
+// Find variable descriptor by its name. Names can be shortened, as long as they are not ambiguous.
+// Array elements ("NAME[INDEX]") are not processed here, see convar_resolve()
+// Reentrant. /name/ is not modified. Prints error messages if /verbose/ is true
+//
+static struct convar *convar_find(const char *name, bool verbose) {
+
+  struct convar *var = NULL;
+  uint32_t h = convar_hash(name);
+  unsigned int lo, hi, mid;
+  size_t len;
+
+  // Try to find exact name match...
+  for (var = Var_hash[convar_bucket(h)]; var; var = var->hnext)
+    if (var->hash == h && !strcmp(name, var->name))
+      return var;
+
+  // try partial match: find the first name which is not less than /name/ 
+  len = strlen(name);
+  mutex_lock(Var_mux);
+
+  if (Var_sorted_count != Var_count)
+    convar_sort0();
+
+  for (lo = 0, hi = Var_sorted_count; lo < hi; ) {
+    mid = (lo + hi) / 2;
+    if (strcmp(Var_sorted[mid]->name, name) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (lo < Var_sorted_count && !strncmp(name, Var_sorted[lo]->name, len)) {
+    var = Var_sorted[lo];
+    if (lo + 1 < Var_sorted_count && !strncmp(name, Var_sorted[lo + 1]->name, len)) {
+      if (verbose)
+        q_printf("%% <e>Ambiguity: by \"%s\" did you mean \"%s\" or \"%s\"?</>\r\n",name, Var_sorted[lo + 1]->name, var->name);
+      var = NULL;
+    }
+  }
+
+  mutex_unlock(Var_mux);
+  return var;
+}
+
+// Resolved variable or array element: what is needed to read or write it, without a name lookup.
+// Handles can be cached: variables are never unregistered
+//
+struct convar_handle {
+  void          *ptr;          // address of the variable or of the array element
+  struct convar *var;          // variable descriptor (descriptor of the array, for array elements)
+  unsigned int   idx;          // array element index, valid if /element/ is set
+  uint8_t        size;         // 1, 2, 4 or 8 bytes
+  uint8_t        isf : 1;      // float?
+  uint8_t        isp : 1;      // pointer?
+  uint8_t        isu : 1;      // unsigned?
+  uint8_t        element : 1;  // an array element?
+};
+
+// Resolve variable name ("my_var", "my_v" or "arr[10]") to a handle.
+// Reentrant. /name/ is not modified. Prints error messages if /verbose/ is true.
+// Returns /false/ if variable can not be found
+//
+static bool convar_resolve(const char *name, struct convar_handle *h, bool verbose) {
+
+  struct convar *var;
+  const char *br;
+  unsigned int idx;
+
+  // Variable name is an array element? (e.g. "buff[11]")
+  if ((br = q_findchar(name,'[')) != NULL) {
+
+    char name0[CONVAR_NAMELEN_MAX], index[16];
+    const char *br2;
+    size_t len;
+
+    if ((br2 = q_findchar(br, ']')) == NULL) {
+      if (verbose)
+        q_print("% <e>Closing bracket \"]\" expected</>\r\n");
+      return false;
+    }
+
+    // Copy the index and the name parts: /name/ is not modified
+    len = br2 - br - 1;
+    if (len < sizeof(index)) {
+      memcpy(index, br + 1, len);
+      index[len] = '\0';
+    }
+    if (len >= sizeof(index) || (idx = q_atol(index, DEF_BAD)) == DEF_BAD) {
+      if (verbose)
+        q_print("% <e>Numeric index is expected inside []</>\r\n");
+      return false;
+    }
+
+    if ((len = br - name) >= sizeof(name0))
+      len = sizeof(name0) - 1;
+    memcpy(name0, name, len);
+    name0[len] = '\0';
+
+    if ((var = convar_find(name0, verbose)) == NULL)
+      return false;
+
+    // Index only applies to pointers and arrays
+    if (!var->isp) {
+      if (verbose)
+        q_printf("%% Variable \"%s\" is neither a pointer nor an array\r\n", var->name);
+      return false;
+    }
+
+    // Should we deny access to indicies beyound boundaries?
+    // In other hand it might be useful for accessing pointers as arrays
+    if (idx >= var->counta && var->counta > 1) { // an array. defenitely we don't want to go beyound its boundaries
+      if (verbose)
+        q_printf("%% Requested element %u is beyond the array range 0..%u\r\n", idx, var->counta - 1);
+      return false;
+      // Pointers unlike arrays always have their .counta set to 1, so we don't know the real boundaries.
+      // Arrays of size 1 are treated as pointers
+    }
+
+    h->var = var;
+    h->ptr = (char *)(var->gpp) + idx * convar_stride(var);
+    h->idx = idx;
+    h->size = var->sizea;
+    h->isf = var->isfa;
+    h->isp = var->ispa;
+    h->isu = var->isua;
+    h->element = 1;
+    return true;
+  }
+
+  // Requested variable is not an array element, it is just ordinary variable
+  if ((var = convar_find(name, verbose)) == NULL)
+    return false;
+
+  h->var = var;
+  h->ptr = var->ptr;
+  h->idx = 0;
+  h->size = var->size;
+  h->isf = var->isf;
+  h->isp = var->isp;
+  h->isu = var->isu;
+  h->element = 0;
+  return true;
+}
+
+// Convert text /p/ to a value of the variable's type.
+// Returns 0 on success, 
+//         1 if /p/ is not a number
+//        -1 if /p/ is a number which can not be assigned (float to an integer, negative to an unsigned). 
+//
+static int convar_parse_value(const struct convar_handle *h, const char *p, composite_t *u, bool verbose) {
+
+  if (h->isf) {
+    if (!isfloat(p)) {
+      if (verbose)
+        HELP(q_printf("%% <e>Variable \"%s\" expects a floating point argument</>\r\n", h->var->name));
+      return 1;
+    }
+    if (h->size == sizeof(double))
+      u->dval = atof(p);
+    else
+      u->fval = q_atof(p, 0);
+    return 0;
+  }
+
+  // Integers & pointer values.
+  // Warn if float argument is detected, or negative value is attempted for an unsigned variable
+  //
+  if (!q_isnumeric(p))
+    return 1;
+
+  if (q_findchar(p,'.')) {
+    if (verbose)
+      q_printf("%% <e>Variable \"%s\" is integer: value not changed</>\r\n", h->var->name);
+    return -1;
+  }
+
+  // The value is converted to a 64 bit integer: on a little-endian CPU its lower /h->size/ bytes
+  // are the same value, truncated to the variable size
+  //
+  // New value is a negative integer?
+  if (p[0] == '-') {
+    if (h->isu) {
+      if (verbose)
+        q_printf("%% <e>Variable \"%s\" is unsigned: value not changed</>\r\n", h->var->name);
+      return -1;
+    }
+    u->llval = -(long long)q_atoll(p + 1, 0);
+  } else
+  // New value is an unsigned integer
+    u->ullval = q_atoll(p, 0);
+
+  return 0;
+}
+
 
 // Check if variable has supported type. ESPShell supports only basic C types
-// which can fit 1,2 or 4 bytes
+// which can fit 1,2,4 or 8 bytes
 static bool convar_is_size_ok(unsigned int size) {
-  if (size != sizeof(char) && size != sizeof(short) && size != sizeof(int) && size != sizeof(float)) {
+  if (size != sizeof(char) && size != sizeof(short) && size != sizeof(int) && size != sizeof(long long)) {
     q_printf("%% Variable was not registered (unsupported size: %u)\r\n",size);
     return false;
   }
@@ -136,14 +418,13 @@ void espshell_varadd(const char *name, void *ptr, int size, bool isf, bool isp,
 
   if (convar_is_size_ok(size))
     if ((var = (struct convar *)q_malloc(sizeof(struct convar), MEM_STATIC)) != NULL) {
-      var->next = var_head;
       var->name = name;
       var->ptr = ptr;
       var->size = size;
       var->isf = isf ? 1 : 0;
       var->isp = isp ? 1 : 0;
       var->isu = isu ? 1 : 0;
-      var_head = var;
+      convar_link(var);
     }
 }
 
@@ -158,7 +439,6 @@ void espshell_varaddp(const char *name, void *ptr, int size, bool isf, bool isp,
   if ((isp && (size == 0)) || convar_is_size_ok(size))
     if ((var = (struct convar *)q_malloc(sizeof(struct convar), MEM_STATIC)) != NULL) {
    
-      var->next = var_head;
       var->name = name;
       var->gpp = *(void **)ptr; // this is required if we want to set/display values of a pointer (NAME[INDEX])
       var->ptr = ptr;
@@ -171,7 +451,7 @@ void espshell_varaddp(const char *name, void *ptr, int size, bool isf, bool isp,
       var->isfa = isf;
       var->isua = isu;
       var->ispa = isp;
-      var_head = var;
+      convar_link(var);
   }
 }
 
@@ -190,7 +470,6 @@ void espshell_varadda(const char *name, void *ptr, int size,int count, bool isf,
     if ((var = (struct convar *)q_malloc(sizeof(struct convar), MEM_STATIC)) != NULL) {
 
       var->gpp = ptr;                   // actual pointer to the array (i.e. &array[0])
-      var->next = var_head;
       var->name = name;
       var->ptr = &var->gpp;             // "address of a variable" for arrays it is always points to GPP
       var->isp = 1;                     // It is a pointer
@@ -202,7 +481,35 @@ void espshell_varadda(const char *name, void *ptr, int size,int count, bool isf,
       var->isfa = isf;                  // isXa is a twin brothers of their isX counterparts but related to the array element
       var->isua = isu;
       var->ispa = isp;
-      var_head = var;
+      convar_link(var);
+    }
+}
+
+// Register a field of an array of structures: an array of /count/ elements of /size/ bytes, /stride/ bytes apart.
+// /ptr/ is the address of the field of the first array element. Not supposed to be called directly, see 
+// the "convar_addfa()" macro
+//
+void espshell_varadds(const char *name, void *ptr, int size, int stride, int count, bool isf, bool isu) {
+
+  struct convar *var;
+
+  if (convar_is_size_ok(size))
+    if ((var = (struct convar *)q_malloc(sizeof(struct convar), MEM_STATIC)) != NULL) {
+
+      var->gpp = ptr;                   // address of the field of the first element
+      var->name = name;
+      var->ptr = &var->gpp;
+      var->isp = 1;
+      var->isf = 0;
+      var->isu = isu;
+      var->size = sizeof( void * );
+      var->sizea = size;                // field size
+      var->counta = count;              // number of elements in the array
+      var->stride = stride;             // sizeof(struct)
+      var->isfa = isf;
+      var->isua = isu;
+      var->ispa = 0;
+      convar_link(var);
     }
 }
 
@@ -210,26 +517,26 @@ void espshell_varadda(const char *name, void *ptr, int size,int count, bool isf,
 // E.g. returns "float" or "unsigned int *" in case of pointers or arrays
 // Never returns NULL
 //
+static const char *convar_typename0(unsigned int size, bool isf, bool isu, bool isp) {
+
+  static const char *names[] = { "unsigned char", "unsigned short", "unsigned int", "unsigned long long" };
+  static const char *pnames[] = { "unsigned char *", "unsigned short *", "unsigned int *", "unsigned long long *" };
+  int i = size == sizeof(long long) ? 3 : (size == sizeof(int) ? 2 : (size == sizeof(short) ? 1 : 0));
+
+  if (isf)
+    return size == sizeof(double) ? (isp ? "double *" : "double") 
+                                  : (isp ? "float *" : "float");
+
+  // Skip "unsigned " for signed types: "unsigned int" becomes "int"
+  return (isp ? pnames[i] : names[i]) + (isu ? 0 : 9);
+}
+
+// Same as above, for a variable descriptor
+//
 static const char *convar_typename(struct convar *var) {
 
-  const char *__uch  = "unsigned char";
-  const char *__ush  = "unsigned short";
-  const char *__uin  = "unsigned int";
-  //const char *__ull  = "unsigned long long";
-  const char *__ucha = "unsigned char *";
-  const char *__usha = "unsigned short *";
-  const char *__uina = "unsigned int *";
-  //const char *__ulla = "unsigned long long *";
-
-  int off = var->isu ? 0 : 9; // offset to strings like "unsigned int" to make them "int" (i.e. skip first 9 bytes)
-
-  return var ? (var->isf  ? "float"
-                          : (var->isp ? (var->isfa ? "float *" :
-                                        (var->ispa ? "void **" :
-                                        (var->sizea == sizeof(int)   ? __uina + off :
-                                        (var->sizea == sizeof(short) ? __usha + off : __ucha + off))))
-                          : (var->size == sizeof(int) ? __uin + off
-                          : (var->size == sizeof(short) ? __ush + off : __uch + off))))
+  return var ? (var->isp ? (var->ispa ? "void **" : convar_typename0(var->sizea, var->isfa, var->isu, true))
+                         : convar_typename0(var->size, var->isf, var->isu, false))
              : "(null)";
 }
 
@@ -267,94 +574,36 @@ static const char *convar_typename2(struct convar *var) {
 //
 // Returns a pointer to the descriptor
 // WARNING: For array elements a virtual variable is created & returned, and it is STATIC variable. So convar_get() function
-//          is NOT reentrant! Means, avoid running "var" command in a background.
-// WARNING: convar_get() can write to the string which is passed as its argument! All convar names are expected to come from an argv's
-//          so they are writeable. Dont attempt convar_get("String literal")!
-static struct convar *convar_get(char *name) {
+//          is NOT reentrant! Use convar_resolve() instead, where reentrancy matters
+//
+static struct convar *convar_get(const char *name) {
 
-  struct convar *var;
-  struct convar *candidate;
   static struct convar var0; // WARNING: NOT REENTRANT!
-  char *br;
-  unsigned int idx = 0;  // Index to array element if element == true
+  static char name0[CONVAR_NAMELEN_MAX] = { 0 };
+  struct convar_handle h;
 
   if (name == NULL)
     return var_head;
 
-  // Variable name is an array element? (e.g. "buff[11]")
-  // TODO: refactor to use read_array_size()
-  if ((br = (char *)q_findchar(name,'[')) != NULL) {
-
-    static char name0[CONVAR_NAMELEN_MAX] = { 0 };
-    char *index = br + 1;
-
-    *br = '\0';
-    
-    br = (char *)q_findchar(index,']');
-    if (!br) {
-      q_print("% <e>Closing bracket \"]\" expected</>\r\n");
-      return NULL;
-    }
-    *br = '\0';
-    if ((idx = q_atol(index,DEF_BAD)) == DEF_BAD) {
-      q_print("% <e>Numeric index is expected inside []</>\r\n");
-      return NULL;
-    }
-
-    // Recursive call. /name/ at this point was transformed from "Text[Index]"" to "Text"
-    // I.e. we are trying to get a descriptor for an array whose element was requested
-    if ((var = convar_get(name)) == NULL)
-      return NULL;
-
-    // Index only applies to pointers and arrays
-    if (!var->isp) {
-      q_printf("%% Variable \"%s\" is neither a pointer nor an array\r\n", name);
-      return NULL;
-    }
-    
-    // Should we deny access to indicies beyound boundaries?
-    // In other hand it might be useful for accessing pointers as arrays
-    if (idx >= var->counta) {
-      if (var->counta > 1) { // an array. defenitely we don't want to go beyound its boundaries
-        q_printf("%% Requested element %u is beyond the array range 0..%u\r\n", idx, var->counta - 1);
-        return NULL;
-      }
-      // Pointers unlike arrays always have their .counta set to 1, so we don't know the real boundaries.
-      // We just issue the warning and continue. Arrays of size 1 are treated as pointers so no warning will be issued
-    }
-
-    // create a virtual variable pointing to a requested array element
-    // and pass it to the code below
-    memset(&var0,0,sizeof(var0));
-    snprintf(name0,sizeof(name0) - 1,"%s[%u]",var->name,idx);
-    var0.name = name0;
-    var0.ptr = (char *)(var->gpp) + idx * var->sizea;
-    var0.isf = var->isfa;
-    var0.isp = var->ispa;
-    var0.isu = var->isua;
-    var0.size = var->sizea;
-    var0.counta = 1;
-
-    // Done
-    return &var0;
-  }
-
-  // Requested variable is not an array element, it is just ordinary variable
-  // Try to find exact name match...
-  for (var = var_head; var; var = var->next)
-    if (!strcmp(name, var->name))
-      return var;
-
-  // try partial match...
-  for (var = var_head, candidate = NULL; var; var = var->next)
-    if (!q_strcmp(name, var->name)) {
-      if (candidate) {
-        q_printf("%% <e>Ambiguity: by \"%s\" did you mean \"%s\" or \"%s\"?</>\r\n",name,var->name, candidate->name);
-        return NULL;
-      }
-      candidate = var;
-    }
-  return candidate;
+  // Variable name is not an array element? (e.g. "buff[11]")
+  if (q_findchar(name,'[') == NULL)
+    return convar_find(name, true);
+
+  if (!convar_resolve(name, &h, true))
+    return NULL;
+
+  // create a virtual variable pointing to a requested array element
+  memset(&var0,0,sizeof(var0));
+  snprintf(name0,sizeof(name0) - 1,"%s[%u]",h.var->name,h.idx);
+  var0.name = name0;
+  var0.ptr = h.ptr;
+  var0.isf = h.isf;
+  var0.isp = h.isp;
+  var0.isu = h.isu;
+  var0.size = h.size;
+  var0.counta = 1;
+
+  return &var0;
 }
 
 // Print the value of a variable.
@@ -373,10 +622,15 @@ static int convar_value_as_string(struct convar *var, char *out, int olen) {
 
     memcpy(&comp, var->ptr, var->size);
     if (var->isf)
-      snprintf(out, olen, "%f", comp.fval);
+      snprintf(out, olen, "%f", var->size == sizeof(double) ? comp.dval : comp.fval);
     else if (var->isp)
       snprintf(out, olen, "0x%x", comp.uval);
-    else if (var->isu) {
+    else if (var->size == sizeof(long long)) {
+      if (var->isu)
+        snprintf(out, olen, "%llu", comp.ullval);
+      else
+        snprintf(out, olen, "%lld", comp.llval);
+    } else if (var->isu) {
         unsigned int val = var->size == sizeof(int) ? comp.uval : (var->size == sizeof(short) ? comp.ush : comp.uchar);
         if (val > 1024)
           snprintf(out, olen, "%u //*%x*/", val, val);
@@ -392,48 +646,194 @@ static int convar_value_as_string(struct convar *var, char *out, int olen) {
 }
 
 
-#if 0
+// Compiled conditions on variables: "NAME eq|ne|lt|gt|le|ge VALUE" or "NAME changed".
+// Used by "if $NAME ..." (see ifcond.h) and by conditional statements in aliases (see alias.h)
+//
+// The variable is resolved once, when the condition is parsed, and the value to compare with
+// is converted to the variable's type, so evaluation is just a load and a compare.
+//
+// Comparison operators. Order must match convar_cond_ops[]
+#define CONVAR_OP_EQ      0
+#define CONVAR_OP_NE      1
+#define CONVAR_OP_LT      2
+#define CONVAR_OP_GT      3
+#define CONVAR_OP_LE      4
+#define CONVAR_OP_GE      5
+#define CONVAR_OP_CHANGED 6  // not a comparison: matches whenever variable value changes
+
+static const char *convar_cond_ops[] = { "eq", "ne", "lt", "gt", "le", "ge", "changed" };
+
+// Variable types
+#define CONVAR_COND_SIGNED   0
+#define CONVAR_COND_UNSIGNED 1
+#define CONVAR_COND_FLOAT    2
+
+// Values are compared as 64 bit integers (signed or unsigned) or as doubles: the value to compare with
+// (/imm/) is stored as llval, ullval or dval respectively
+//
+struct convar_cond {
+  void       *ptr;          // variable address
+  char       *name;         // variable name (as registered, e.g. "buf[3]")
+  composite_t imm;          // value to compare with, already converted to the variable type
+  uint8_t     size;         // variable size: 1, 2, 4 or 8 bytes
+  uint8_t     type;         // CONVAR_COND_SIGNED, CONVAR_COND_UNSIGNED or CONVAR_COND_FLOAT
+  uint8_t     op;           // CONVAR_OP_EQ ... CONVAR_OP_CHANGED
+};
+
+// Evaluate a condition: read the variable and compare it with the immediate value.
+// "changed" conditions always match: change detection is up to the caller
+//
+static bool convar_cond_test(const struct convar_cond *v) {
+
+  composite_t c = { 0 };
+  int r;
+
+  if (v->op == CONVAR_OP_CHANGED)
+    return true;
+
+  memcpy(&c, v->ptr, v->size);
+
+  if (v->type == CONVAR_COND_FLOAT) {
+    double val = v->size == sizeof(double) ? c.dval : c.fval;
+    r = (val > v->imm.dval) - (val < v->imm.dval);
+  } else if (v->type == CONVAR_COND_UNSIGNED) {
+    unsigned long long val = v->size == sizeof(long long) ? c.ullval : 
+                            (v->size == sizeof(int) ? c.uval : (v->size == sizeof(short) ? c.ush : c.uchar));
+    r = (val > v->imm.ullval) - (val < v->imm.ullval);
+  } else {
+    signed long long val = v->size == sizeof(long long) ? c.llval : 
+                          (v->size == sizeof(int) ? c.ival : (v->size == sizeof(short) ? c.ish : c.ichar));
+    r = (val > v->imm.llval) - (val < v->imm.llval);
+  }
 
-static void inline __attribute__((always_inline))
-_memcpy(char *dst, char *src, uint8_t count) {
-  switch(count) {
-    case 4: *dst++ = *src++; // FALLTHROUGH
-    case 3: *dst++ = *src++; // FALLTHROUGH
-    case 2: *dst++ = *src++; // FALLTHROUGH
-    case 1: *dst = *src;     // FALLTHROUGH
-    default:
-  };
+  switch (v->op) {
+    case CONVAR_OP_EQ: return r == 0;
+    case CONVAR_OP_NE: return r != 0;
+    case CONVAR_OP_LT: return r < 0;
+    case CONVAR_OP_GT: return r > 0;
+    case CONVAR_OP_LE: return r <= 0;
+    case CONVAR_OP_GE: return r >= 0;
+    default: break;
+  }
+  return false;
 }
 
-// Compare two variables
-// We need this for our ifcond.h module, which performs logic operations on variables
+// Print a condition ("$NAME OP VALUE" or "$NAME changed") into the /buf/
 //
-// Returns <0 if var < var2, >0 if var > var2 or 0 if var == var2
+static char *convar_cond_sprint(const struct convar_cond *v, char *buf, size_t len) {
+
+  const char *name = v->name ? v->name : "?";
+
+  if (v->op == CONVAR_OP_CHANGED)
+    snprintf(buf, len, "$%s changed", name);
+  else if (v->type == CONVAR_COND_FLOAT)
+    snprintf(buf, len, "$%s %s %f", name, convar_cond_ops[v->op], v->imm.dval);
+  else if (v->type == CONVAR_COND_UNSIGNED)
+    snprintf(buf, len, "$%s %s %llu", name, convar_cond_ops[v->op], v->imm.ullval);
+  else
+    snprintf(buf, len, "$%s %s %lld", name, convar_cond_ops[v->op], v->imm.llval);
+  return buf;
+}
+
+// Parse a condition: "$NAME eq|ne|lt|gt|le|ge VALUE" or "$NAME changed", starting at argv[*idx].
+// Leading "$" is optional. "changed" is accepted only if /changed_ok/ is true
+//
+// On success fills /v/, advances /*idx/ and returns 0. Returns CMD_MISSING_ARG or the index of the bad
+// argument otherwise. v->name is not a copy: it must be copied by the caller if it is to be stored
+// argv[] is not modified
 //
-//convar_map_variable() ?
-static int convar_compare(struct convar *var, struct convar *var2) {
+static int convar_cond_parse(int argc, char **argv, unsigned int *idx, struct convar_cond *v, bool changed_ok) {
+
+  struct convar_handle h;
+  const struct convar *var;
+  unsigned int i = *idx, op;
+  const char *p;
+  char *name;
 
-  if (var && var2) {
-    composite_t comp = { 0 }, comp2 = { 0 };
+  if (i + 1 >= argc)
+    return CMD_MISSING_ARG;
 
-    _memcpy((char *)&comp, (char *)var->ptr, var->size);
-    _memcpy((char *)&comp2, (char *)var2->ptr, var2->size);
+  name = argv[i][0] == '$' ? argv[i] + 1 : argv[i];
 
-    if (var->isf) return comp.fval - comp2.fval; else
-    if (var->isp) return comp.uval - comp2.uval; else
-    if (var->isu) return (int)(var->size == sizeof(int) ? comp.uval - comp2.uval
-                                                        : (var->size == sizeof(short) ? comp.ush - comp2.ush
-                                                                                      : comp.uchar - comp2.uchar)); else
-    return (int)(var->size == sizeof(int) ? comp.ival - comp2.ival
-                                          : (var->size == sizeof(short) ? comp.ish - comp2.ish
-                                                                        : comp.ichar - comp2.ichar));
+  if (!convar_resolve(name, &h, true)) {
+    HELP(q_printf("%% <e>Unknown variable \"%s\"</>, use \"var\" to list registered variables\r\n", name));
+    return i;
   }
-  return -1;
+  var = h.var;
+
+  if (h.isp) {
+    HELP(q_print("% <e>Pointers and arrays can not be compared, use array elements instead: NAME[INDEX]</>\r\n"));
+    return i;
+  }
+
+  if (!is_valid_address(h.ptr, h.size)) {
+    q_printf("%% <e>Variable address %p is not readable</>\r\n", h.ptr);
+    return i;
+  }
+
+  for (op = 0; op < sizeof(convar_cond_ops) / sizeof(convar_cond_ops[0]); op++)
+    if (!q_strcmp(argv[i + 1], convar_cond_ops[op]))
+      break;
+
+  if (op == sizeof(convar_cond_ops) / sizeof(convar_cond_ops[0]) || (op == CONVAR_OP_CHANGED && !changed_ok)) {
+    HELP(q_printf("%% <e>Expected \"eq\", \"ne\", \"lt\", \"gt\", \"le\", \"ge\"%s</>\r\n", changed_ok ? " or \"changed\"" : ""));
+    return i + 1;
+  }
+
+  memset(v, 0, sizeof(*v));
+  v->ptr = h.ptr;
+  v->size = h.size;
+  v->op = op;
+  v->type = h.isf ? CONVAR_COND_FLOAT : (h.isu ? CONVAR_COND_UNSIGNED : CONVAR_COND_SIGNED);
+
+  if (op != CONVAR_OP_CHANGED) {
+
+    if (i + 2 >= argc)
+      return CMD_MISSING_ARG;
+
+    p = argv[i + 2];
+
+    if (v->type == CONVAR_COND_FLOAT) {
+      if (!isfloat(p)) {
+        HELP(q_printf("%% <e>Variable \"%s\" expects a floating point argument</>\r\n", var->name));
+        return i + 2;
+      }
+      v->imm.dval = atof(p);
+    } else {
+      if (q_findchar(p, '.')) {
+        HELP(q_printf("%% <e>Variable \"%s\" is integer</>\r\n", var->name));
+        return i + 2;
+      }
+      if (p[0] == '-') {
+        if (v->type == CONVAR_COND_UNSIGNED) {
+          HELP(q_printf("%% <e>Variable \"%s\" is unsigned</>\r\n", var->name));
+          return i + 2;
+        }
+        if (!q_isnumeric(p + 1))
+          return i + 2;
+        v->imm.llval = -(long long)q_atoll(p + 1, 0);
+      } else if (!q_isnumeric(p))
+        return i + 2;
+      else
+        v->imm.ullval = q_atoll(p, 0);
+    }
+    i++;
+  }
+
+  // Array elements have no registered names: use the name as it was typed
+  v->name = h.element ? name : (char *)var->name;
+
+  *idx = i + 2;
+  return 0;
 }
-#endif
+
+// Display formats for "var NAME hex|dec|float". Order matches PA_HEX, PA_DEC and PA_FLOAT
+static const char *convar_formats[] = { "hex", "dec", "float" };
+
 // Show variable value by variable name
+// /fmt/ is one of PA_NATIVE, PA_HEX, PA_DEC or PA_FLOAT (see q_printarray())
 //
-static int convar_show_var(char *name) {
+static int convar_show_var(char *name, int fmt) {
 
   struct convar *var;
   char out[CONVAR_BUFSIZ]; 
@@ -443,6 +843,17 @@ static int convar_show_var(char *name) {
     return 1;
   }
 
+  // Scalar variable in a non-default format
+  if (fmt != PA_NATIVE && !var->isp) {
+    if (!is_valid_address(var->ptr, var->size)) {
+      q_printf("%% <e>Variable address %p is not readable</>\r\n", var->ptr);
+      return CMD_FAILED;
+    }
+    q_sprint_elem(out, sizeof(out), var->ptr, var->size, var->isu, var->isf, false, fmt);
+    q_printf("%% %s <i>%s</> = <g>%s</>;\r\n", convar_typename(var), var->name, out);
+    return 0;
+  }
+
   if (convar_value_as_string(var,out,sizeof(out)) == 0) {
 
     // For arrays and pointers display array base address
@@ -459,35 +870,24 @@ static int convar_show_var(char *name) {
           q_printf("%% Pointer <i>&%s</> == %p, <i>%s</> == <g>%s</>, sizeof(*%s) == %u\r\n", var->name, var->ptr, var->name, out, var->name, var->sizea);
       }
 
-      // In case of a pointer or array, print its content
-
-      if (var->counta < ARRAY_TOO_BIG) {
+      // In case of a pointer or array, print its content: all elements are rendered by q_printarray(),
+      // a line per 8 elements (4 for floating point and hex)
+      //
+      const char *base = *(void **)var->ptr;
+      unsigned int stride = convar_stride(var);
 
-        struct convar var0 = { 0 };
-
-        q_printf("\r\n%% %s = {\r\n", convar_typename2(var));
+      if (!is_valid_address(base, (var->counta - 1) * stride + var->sizea)) {
+        q_printf("%% <e>Array memory (%p) is not readable</>\r\n", base);
+        return CMD_FAILED;
+      }
 
-        // Create dummy variable. It will be used to display array elements
-        // Fill common fielfd, but leave .ptr not set
-        var0.name = var->name;
-        var0.isf = var->isfa;
-        var0.isp = var->ispa;
-        var0.isu = var->isua;
-        var0.size = var->sizea ? var->sizea : 1; // void pointers have sizea==0 and counta==1
+      if (var->counta > ARRAY_LONG && is_foreground_task())
+        HELP(q_print("% Long array, press <Enter> to interrupt the output\r\n"));
 
-        // Go through all elements, calculate real pointer for everyt array element
-        for (int i = 0; i < var->counta; i++) {
-          int err;
-          var0.ptr = (void *)((char *)(*(void **)var->ptr) + var->sizea * i); // love pointer arithmetic :)
-          err = convar_value_as_string(&var0,out,sizeof(out));
-          q_printf("%%    [%u] = <%c>%s</>,\r\n",
-                    i,
-                    !err ? 'g' : 'w', // color tag. red on failure, green on success
-                    out);
-        }
+      q_printf("\r\n%% %s = {\r\n", convar_typename2(var));
+      if (q_printarray(base, var->counta, stride, var->sizea, var->isua, var->isfa, var->ispa, fmt,
+                       (fmt == PA_HEX || fmt == PA_FLOAT || (fmt == PA_NATIVE && (var->isfa || var->ispa))) ? 4 : 8, false))
         q_print("% };\r\n");
-      } else 
-        q_print(", too many to display\r\n%% Use \"var Name[Index]\" to display individual array elements\r\n");
     } else
       q_printf("%% %s <i>%s</> = <g>%s</>;\r\n", convar_typename(var), var->name, out);
 
@@ -610,7 +1010,7 @@ static int cmd_var_show(int argc, char **argv) {
     if (q_isnumeric(argv[1]))
       return convar_show_number(argv[1]);
 
-  return convar_show_var(argv[1]);
+  return convar_show_var(argv[1], PA_NATIVE);
 }
 
 
@@ -694,6 +1094,14 @@ static int cmd_var(int argc, char **argv) {
     return 0;
   }
 
+  // "var watch ..." / "var unwatch ...", see watch.h
+  if (argc > 1 && (!strcmp(argv[1], "watch") || !strcmp(argv[1], "unwatch")))
+    return cmd_var_watch(argc, argv);
+
+  // "var export ...", see export.h
+  if (argc > 1 && !strcmp(argv[1], "export"))
+    return cmd_var_export(argc, argv);
+
   if (argc < 3)
     return cmd_var_show(argc, argv);
 
@@ -703,63 +1111,23 @@ static int cmd_var(int argc, char **argv) {
   if (q_isnumeric(argv[1]))
     return cmd_var_address(argc, argv);
 
+  // "var NAME hex|dec|float" : display in a different format
+  if (argc == 3 && !q_isnumeric(argv[2]))
+    for (int i = 0; i < sizeof(convar_formats) / sizeof(convar_formats[0]); i++)
+      if (!q_strcmp(argv[2], convar_formats[i]))
+        return convar_show_var(argv[1], PA_HEX + i);
+
   // Set variable
-  struct convar *var;
+  struct convar_handle h;
+  int err;
 
-  if ((var = convar_get(argv[1])) == NULL)
+  if (!convar_resolve(argv[1], &h, true))
     return 1;
 
-  if (var->isf) {
-    if (isfloat(argv[2])) {
-      u.fval = q_atof(argv[2], 0);
-    } else {
-      HELP(q_printf("%% <e>Variable \"%s\" expects a floating point argument</>\r\n", var->name));
-      return 2;
-    }
-  } else {
-    // Integers & pointer values.
-    // Warn if float argument is detected, or negative value is attempted for an unsigned variable
-    //
-    if (q_isnumeric(argv[2])) {
-      if (q_findchar(argv[2],'.')) {
-        q_printf("%% <e>Variable \"%s\" is integer: value not changed</>\r\n",var->name);
-        return 0;
-      }
+  if ((err = convar_parse_value(&h, argv[2], &u, true)) != 0)
+    return err < 0 ? 0 : 2;
 
-      // New value is a negative integer?
-      if (argv[2][0] == '-') {
-        if (var->isu) {
-          q_printf("%% <e>Variable \"%s\" is unsigned: value not changed</>\r\n",var->name);
-          return 0;
-        }
-        signed int val = -q_atol(&(argv[2][1]), 0);
-        if (var->size == sizeof(int))
-          u.ival  = val; else
-        if (var->size == sizeof(short))
-          u.ish   = val; else
-        if (var->size == sizeof(char)) 
-          u.ichar = val; 
-        else 
-          goto report_and_exit;
-      } else {
-      // New value is an unsigned integer?
-        unsigned int val = q_atol(argv[2], 0);
-        if (var->size == sizeof(int))
-          u.uval  = val; else
-        if (var->size == sizeof(short))
-          u.ush   = val; else
-        if (var->size == sizeof(char))
-          u.uchar = val;
-        else {
-report_and_exit:          
-          q_printf("%% Bad variable size: %u\r\n",var->size); 
-          return 0; 
-        }
-      }
-    } else 
-      return 2;
-  }
-  memcpy(var->ptr, &u, var->size);
+  memcpy(h.ptr, &u, h.size);
   return 0;
 }
 #endif // #if COMPILING_ESPSHELL
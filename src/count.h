@@ -26,20 +26,38 @@
  // 1. Immediate counting: command "count PIN_NUMBER", a blocking call. User waits for the command to complete
  // 2. Background counting: command "count ... &", user can issue new espshell commands immediately
  // 3. Triggered counting (either immediate or background: "count ... trigger" or  "count ... trigger &"
+ // 4. Gated counting: "count ... control PIN": PCNT hardware counts only while control pin is HIGH
  //
  // Terminology:
  // "measurement time", "wait" or "delay" - is the time interval when counter is counting (not paused). Accuracy of this one defines overall measurement accuracy
  // "trigger", "trigger state" - a counter, which is paused and gets resumed by the first incoming pulse; a counter waiting to be resumed
  // "pcnt overflow interrupt" - an ISR which gets called each time counter reaches 20000 pulses
  // "GPIO anyedge interrupt" - an ISR which gets called on incoming pulse
+ // "control pin", "gate" - a pin which enables (HIGH) or disables (LOW) counting. Gating is done by PCNT hardware, ESPShell only
+ //                         timestamps gate edges to know for how long the gate was open
+ //
+ // Sources of measurement error are estimated by count_error_budget() and are displayed by "show counters"
+ //
+ // Gate counting ("pulses per interval") has a quantization error of 1 pulse: at low frequencies it is useless
+ // (1 Hz signal, 1 second: the result is either 0, 1 or 2 Hz). For low frequencies ESPShell offers reciprocal counting
+ // ("reciprocal" keyword): every rising edge is timestamped (CPU cycles) by a GPIO ISR and frequency is calculated
+ // from the average period. Both methods run in parallel; the edge ISR switches itself off if the signal is too fast
+ // (COUNT_RECIP_MAX_HZ), and then gate counting result is used (see count_recip_better()).
+ // Reciprocal counting is opt-in because it needs the GPIO interrupt of the counted pin, which can be used by the
+ // sketch (attachInterrupt()) or by "if rising|falling". Such pins are refused
+ //
+ // Counters can record their history: "count ... log INTERVAL [file PATH]" samples pulse count every INTERVAL
+ // milliseconds into a per-counter ring buffer (COUNT_HISTORY samples) and, optionally, to a file (CSV or binary).
+ // History survives counter stop and is displayed by "show counters history"
+ //
+ // Units are claimed and released without locks: /pcnt_busy/ bitmask is the owner of the truth, /units[].in_use/
+ // mirrors it for display purposes. The only mutex left (PCNT_mux) serializes PCNT ISR service install/uninstall,
+ // which is a driver call sequence, not bookkeeping.
+ //
+ // Each PCNT unit has 2 channels, but both of them feed the same counter register: channel#1 can not be used
+ // to count pulses on a second pin independently. Multiple pins are measured simultaneously with a batch command,
+ // "count PIN1,PIN2,...,PINn", which uses one unit per pin and starts/stops all of them at once
  //
- // TODO: 1.0: "trigger" counter must record a timestamp & enable counting inside the ISR. 
- // TODO: Current implementation has a delay of tens
- // TODO: of microseconds before 1st pulse and actual counting since the code uses task notifications
- // TODO: Make /pcnt_counters/ _Atomic. Use atomic_load/atomic_store/atomic_fetch_add/sub
- // TODO: make lockless access to the units[] array: use _Atomic /.in_use/ for that
- // TODO: to get rid of all these mutexes
- // TODO: Make <1Hz display possible
  //
  //
 #if COMPILING_ESPSHELL
@@ -48,11 +66,26 @@
 #define PULSE_WAIT      1000           // Default measurement time, msec
 #define PCNT_OVERFLOW   20000          // PCNT interrupt every 20000 pulses (range is [1..2^16-1])
 #define COUNT_INFINITE  (uint64_t)(-1)  
+#define COUNT_ISR_LATENCY 500          // Estimated latency between a GPIO edge and our ISR code, CPU cycles (IDF GPIO ISR service dispatch)
+#define COUNT_API_LATENCY 250          // Estimated cost of pcnt_counter_resume() / pcnt_counter_pause() calls, CPU cycles
+#define COUNT_RECIP_PERIODS 64         // Number of last periods kept for jitter statistics (power of 2)
+#define COUNT_RECIP_MAX_HZ  20000      // Reciprocal counting is switched off for signals faster than this
+#define COUNT_GATE_MIN      1000       // Gate counting is preferred when at least this many pulses were counted (0.1% error)
+
+#define COUNT_HISTORY       256        // Counter history size, samples (power of 2)
+#define COUNT_LOG_MIN       10         // Shortest sampling interval, msec
+
+// Frequency measurement method
+#define COUNT_AUTO  0                  // select automatically, based on signal rate
+#define COUNT_GATE  1                  // pulses per interval (PCNT)
+#define COUNT_RECIP 2                  // reciprocal: average period (GPIO ISR timestamps)
 
 static int               pcnt_unit = PCNT_UNIT_0;        // First PCNT unit which is allowed to use by ESPShell, convar (accessible thru "var" command)
-static int               pcnt_counters = 0;              // Number of currently running counters.
+static _Atomic int          pcnt_counters = 0;            // Number of currently running counters.
+static _Atomic unsigned int pcnt_busy = 0;                // Bitmask of PCNT units claimed by ESPShell: bit0 is PCNT#0 and so on
+static int                  pcnt_isr_refs = 0;            // Number of units using PCNT ISR service. Protected by PCNT_mux
 
-static mutex_t PCNT_mux; // protects access to units[] array
+static mutex_t PCNT_mux; // protects PCNT ISR service install/uninstall
 
 // Hardware counters are described by /units/ array, whose elements are per-counter data;
 // units[0] is used for PCNT#0, unit[5] -> PCNT#5 and so on.
@@ -76,9 +109,16 @@ static volatile struct {
   unsigned int filter_enabled:1; // PCNT filter enabled?
 
   unsigned int filter_value:16;  // PCNT filter value, nanoseconds;
-  unsigned int reserved3:3;
+  unsigned int control:1;        // Counting is gated by the control pin /ctrl_pin/
+  unsigned int method:2;         // COUNT_AUTO, COUNT_GATE or COUNT_RECIP. For stopped counters: the method which was used
 
-  uint64_t tsta;           // q_micros() just before counting starts
+  unsigned int ctrl_pin:8;       // Control pin (only valid if /control/ is set)
+
+  uint64_t tsta;           // q_micros() just before counting starts. Set by the GPIO ISR for "trigger" counters
+  uint64_t gate_tsta;      // q_micros() when control pin went HIGH, 0 if gate is closed. Updated by the GPIO ISR
+  uint64_t gated;          // Total time the gate was open, microseconds. Updated by the GPIO ISR
+  float    rfreq;          // Reciprocal frequency, Hz (only valid if /method/ is COUNT_RECIP)
+  float    jitter;         // Period jitter (standard deviation), microseconds (same as above)
   task_t   taskid;         // ID of the task responsible for counting
 
 } units[PCNT_UNIT_MAX] = { 0 };
@@ -89,6 +129,7 @@ static volatile struct {
 struct trigger_arg {
   task_t taskid;  // counter's task id
   unsigned int pin;     // pin that has generated the interrupt
+  pcnt_unit_t unit;     // PCNT unit to start
 };
 
 
@@ -104,9 +145,10 @@ static void IRAM_ATTR pcnt_unit_interrupt(void *arg) {
 
 
 // ESPShell uses GPIO interrupt to catch the first pulse when counter is in "trigger" mode
-// Once pulse is detected the interrupt is fired (count_pin_anyedge_interrupt(void *)) which disables further interrupts
-// and unblocks counter task so counter can start counting. All these transient processes **may** have impact on accuracy
-// at higher frequencies.
+// Once pulse is detected the interrupt is fired (count_pin_anyedge_interrupt(void *)) which starts the PCNT unit,
+// records a timestamp, disables further interrupts and unblocks counter task. Starting the counter right in the ISR
+// (instead of doing it in the counter task) removes task wakeup latency (tens of microseconds) from the measurement:
+// what is left is the interrupt latency, COUNT_ISR_LATENCY
 //
 
 // "ISR Services" style interrupt handler.
@@ -115,13 +157,163 @@ static void IRAM_ATTR pcnt_unit_interrupt(void *arg) {
 static void IRAM_ATTR count_pin_anyedge_interrupt(void *arg) {
 
   struct trigger_arg *t = (struct trigger_arg *)arg;
-  
-  // Send an event to PCNT task blocking on TaskNotifyWait so it can unblock and start counting.
-  task_signal_from_isr(t->taskid, SIGNAL_GPIO);
+
+  // Start counting. pcnt_counter_resume() can not be used here: it is not in IRAM and it uses a spinlock
+  units[t->unit].tsta = q_micros();
+  pcnt_ll_start_count(&PCNT, t->unit);
+
   // Disable further interrupts immediately
-  // XXX
-  //gpio_set_intr_type(t->pin, GPIO_INTR_DISABLE);
   gpio_intr_disable(t->pin);
+
+  // Send an event to PCNT task blocking on TaskNotifyWait so it can unblock and continue with measurement
+  task_signal_from_isr(t->taskid, SIGNAL_GPIO);
+}
+
+// Control pin interrupt handler (gated counting). Fires on both edges of the control pin and accumulates the
+// time the gate was open. Counting itself is enabled/disabled by PCNT hardware, no software involved.
+//
+static void IRAM_ATTR count_ctrl_pin_interrupt(void *arg) {
+
+  const pcnt_unit_t unit = (const pcnt_unit_t )arg;
+  uint64_t now = q_micros();
+
+  if (gpio_ll_get_level(&GPIO, units[unit].ctrl_pin)) {
+    if (!units[unit].gate_tsta)
+      units[unit].gate_tsta = now;
+  } else if (units[unit].gate_tsta) {
+    units[unit].gated += now - units[unit].gate_tsta;
+    units[unit].gate_tsta = 0;
+  }
+}
+
+// Reciprocal counting state, one per PCNT unit. Written by count_recip_interrupt()
+//
+static volatile struct count_recip {
+  uint32_t last;                          // cpu_ticks() at the last edge
+  uint32_t edges;                         // number of edges seen
+  uint32_t min_period;                    // periods shorter than this (CPU cycles) switch reciprocal counting off
+  uint64_t sum;                           // sum of all periods, CPU cycles
+  uint32_t period[COUNT_RECIP_PERIODS];   // last periods, CPU cycles. A ring buffer
+  uint8_t  pin;
+  uint8_t  intr_type;                     // pin interrupt type before reciprocal counting has started
+  bool     off;                           // signal is too fast, ISR has disabled itself
+} recip[PCNT_UNIT_MAX];
+
+// Rising edge interrupt handler (reciprocal counting): records periods in CPU cycles.
+// Periods are measured with a 32-bit cycle counter, which limits the lowest frequency to ~0.06 Hz at 240MHz
+//
+static void IRAM_ATTR count_recip_interrupt(void *arg) {
+
+  volatile struct count_recip *r = (volatile struct count_recip *)arg;
+  uint32_t now = cpu_ticks();
+
+  if (r->edges) {
+    uint32_t p = now - r->last;
+    if (p < r->min_period) {
+      // too fast: interrupt storm would steal all the CPU time. Leave it to PCNT
+      gpio_intr_disable(r->pin);
+      r->off = true;
+      return;
+    }
+    r->sum += p;
+    r->period[(r->edges - 1) & (COUNT_RECIP_PERIODS - 1)] = p;
+  }
+  r->last = now;
+  r->edges++;
+}
+
+// Is the /pin/ interrupt used by an "if rising|falling" condition or by the sketch? The GPIO ISR service allows
+// one handler per pin: installing ours would replace the existing one, and removing ours would leave the pin
+// with no handler at all. Sketch interrupts (attachInterrupt()) are detected by the interrupt enable bits
+//
+static bool count_pin_isr_busy(unsigned int pin) {
+#if WITH_ALIAS
+  if (ifc_pin_has_isr(pin)) {
+    VERBOSE(q_printf("%% GPIO%u interrupt is used by an \"if rising|falling\" condition\r\n", pin));
+    return true;
+  }
+#endif
+  if (GPIO.pin[pin].int_ena) {
+    VERBOSE(q_printf("%% GPIO%u interrupt is enabled (used by the sketch?)\r\n", pin));
+    return true;
+  }
+  return false;
+}
+
+// Start timestamping rising edges on /pin/ for the /unit/
+//
+static void count_recip_start(int unit, unsigned int pin) {
+
+  volatile struct count_recip *r = &recip[unit];
+
+  r->edges = 0;
+  r->sum = 0;
+  r->off = false;
+  r->pin = pin;
+  r->min_period = CPUFreq * 1000000UL / COUNT_RECIP_MAX_HZ;
+  r->intr_type = GPIO.pin[pin].int_type;
+
+  gpio_install_isr_service((int)ARDUINO_ISR_FLAG);
+  gpio_set_intr_type(pin, GPIO_INTR_POSEDGE);
+  gpio_isr_handler_add(pin, count_recip_interrupt, (void *)r);
+  gpio_intr_enable(pin);
+}
+
+// Stop timestamping
+//
+static void count_recip_stop(int unit) {
+  gpio_intr_disable(recip[unit].pin);
+  gpio_set_intr_type(recip[unit].pin, (gpio_int_type_t)recip[unit].intr_type);
+  gpio_isr_handler_remove(recip[unit].pin);
+}
+
+// Calculate reciprocal frequency and period jitter.
+// /edges/      - number of edges timestamped
+// /sum/        - sum of all periods (edges - 1 periods), CPU cycles
+// /period/     - last periods (up to COUNT_RECIP_PERIODS), CPU cycles
+// /mhz/        - CPU frequency, MHz
+// /jitter/     - OUT: standard deviation of a period, microseconds
+//
+// Returns frequency in Hz or 0 if there is not enough data (less than 2 periods)
+//
+static float count_recip_calc(uint32_t edges, uint64_t sum, const volatile uint32_t *period, unsigned int mhz, float *jitter) {
+
+  unsigned int i, n;
+  float mean = 0, var = 0;
+
+  *jitter = 0;
+
+  if (edges < 3 || !sum || !mhz)
+    return 0;
+
+  // Jitter: standard deviation of last /n/ periods
+  n = edges - 1 > COUNT_RECIP_PERIODS ? COUNT_RECIP_PERIODS : edges - 1;
+  for (i = 0; i < n; i++)
+    mean += period[i];
+  mean /= n;
+  for (i = 0; i < n; i++)
+    var += (period[i] - mean) * (period[i] - mean);
+  *jitter = sqrtf(var / n) / mhz;
+
+  // Frequency: average period over the whole measurement
+  return (float)(edges - 1) * mhz * 1000000.0f / (float)sum;
+}
+
+// Select measurement method: reciprocal counting wins if it has data and gate counting has quantization
+// error worse than 1/COUNT_GATE_MIN. Forced methods are honored when possible
+//
+static bool count_recip_better(unsigned int method, unsigned int cnt, uint32_t edges, bool off) {
+
+  if (method == COUNT_GATE || off || edges < 3)
+    return false;
+  return method == COUNT_RECIP || cnt < COUNT_GATE_MIN;
+}
+
+// Time the gate was open so far, microseconds
+//
+static uint64_t count_gate_time(int unit) {
+  uint64_t open = units[unit].gate_tsta;
+  return units[unit].gated + (open ? q_micros() - open : 0);
 }
 
 
@@ -132,13 +324,13 @@ static void IRAM_ATTR count_pin_anyedge_interrupt(void *arg) {
 // when ESPShell interferes with sketch's PCNT code
 //
 // The function also increments global active counters count (/pcnt_counters/)
-
+// Lock-free: a unit belongs to whoever sets its bit in /pcnt_busy/ first
+//
 static int count_claim_unit() {
   pcnt_unit_t i;
 
-  mutex_lock(PCNT_mux);
   for (i = pcnt_unit; i < PCNT_UNIT_MAX; i++) {
-    if (!units[i].in_use) {
+    if (!(atomic_fetch_or(&pcnt_busy, BIT(i)) & BIT(i))) {
 
       // found one. mark it as /used/ and clear its counters
       units[i].in_use = 1;
@@ -151,27 +343,31 @@ static int count_claim_unit() {
       units[i].trigger = 0;
       units[i].been_triggered = 0;
       units[i].filter_enabled = 0;
+      units[i].control = 0;
+      units[i].ctrl_pin = 0;
+      units[i].gate_tsta = 0;
+      units[i].gated = 0;
+      units[i].method = COUNT_AUTO;
+      units[i].rfreq = 0;
+      units[i].jitter = 0;
       units[i].taskid = taskid_self(); 
-      pcnt_counters++;
-      mutex_unlock(PCNT_mux);
+      atomic_fetch_add(&pcnt_counters, 1);
       return (int)i;
     }
   }
   // Nothing found. 
-  mutex_unlock(PCNT_mux);
   return -1;
 }
 
 // Mark PCNT unit as "Stopped"
 //
 static void count_release_unit(int unit) {
-  mutex_lock(PCNT_mux);
   if (unit < PCNT_UNIT_MAX && unit >= 0 && units[unit].in_use) {
     units[unit].in_use = 0;
     units[unit].taskid = 0; // don't display irrelevant TaskID's: suspend/resume/kill on this ID will likely crash whole system
-    --pcnt_counters;
+    atomic_fetch_sub(&pcnt_counters, 1);
+    atomic_fetch_and(&pcnt_busy, ~BIT(unit));
   }
-  mutex_unlock(PCNT_mux);
 }
 
 // Configure & enable interrupts on the unit; installs ISR service and attaches "overflow interrupt" handler
@@ -183,7 +379,7 @@ static void count_claim_interrupt(pcnt_unit_t unit) {
   pcnt_event_disable(unit, PCNT_EVT_ZERO); // or you will get extra interrupts (x2)
 
   // Install ISR service, and register an interrupt handler. Don't use global PCNT interrupt here - it is buggy
-  if (pcnt_counters == 1)
+  if (pcnt_isr_refs++ == 0)
     pcnt_isr_service_install(0);
 
   pcnt_isr_handler_add(unit, pcnt_unit_interrupt, (void *)unit);
@@ -203,7 +399,7 @@ static void count_release_interrupt(pcnt_unit_t unit) {
   pcnt_isr_handler_remove(unit);
 
   // if there are no active counting units left - uninstall ISR service also
-  if (pcnt_counters < 2)
+  if (--pcnt_isr_refs == 0)
     pcnt_isr_service_uninstall();
   mutex_unlock(PCNT_mux);
 }
@@ -236,7 +432,8 @@ static unsigned int count_read_counter(int unit, unsigned int *freq, uint64_t *i
       cnt = units[unit].overflow * PCNT_OVERFLOW + 
             (unsigned int)count + 
             units[unit].been_triggered;                                   // +1 pulse if was triggered
-      tsta = q_micros() - units[unit].tsta;                               // microseconds elapsed so far (for the frequency calculation)
+      tsta = units[unit].control ? count_gate_time(unit)                  // gated counters: time the gate was open so far
+                                 : q_micros() - units[unit].tsta;         // microseconds elapsed so far (for the frequency calculation)
     }
   } else {
     // 2) Counter is stopped; values are already in units[]
@@ -244,8 +441,12 @@ static unsigned int count_read_counter(int unit, unsigned int *freq, uint64_t *i
     tsta = units[unit].interval;                              // Total time spent by command is stored in units[unit].interval
   }
 
-  if (freq)
-    *freq = tsta ? (uint32_t)((uint64_t)cnt * 1000000ULL / tsta) : 0;
+  if (freq) {
+    if (!units[unit].in_use && units[unit].method == COUNT_RECIP)
+      *freq = (unsigned int)(units[unit].rfreq + 0.5f);
+    else
+      *freq = tsta ? (uint32_t)((uint64_t)cnt * 1000000ULL / tsta) : 0;
+  }
 
   if (interval)
     *interval = tsta;
@@ -270,7 +471,6 @@ static const char *count_state_name(int unit) {
 //
 static int count_clear_counter(int pin) {
   int unit;
-  mutex_lock(PCNT_mux);
   for (unit = pcnt_unit; unit < PCNT_UNIT_MAX; unit++) {
     if (units[unit].pin == pin && units[unit].been_used) {
 
@@ -283,6 +483,9 @@ static int count_clear_counter(int pin) {
 
       if (units[unit].in_use) {
         units[unit].tsta = q_micros();
+        units[unit].gated = 0;
+        if (units[unit].gate_tsta)
+          units[unit].gate_tsta = units[unit].tsta;
         if (!units[unit].trigger)
           pcnt_counter_resume(unit);
       } else {
@@ -294,7 +497,6 @@ static int count_clear_counter(int pin) {
       q_printf("%% Counter #%u (%s state) has been cleared\r\n", unit, count_state_name(unit));
     }
   }
-  mutex_unlock(PCNT_mux);
   return 0;
 }
 
@@ -306,14 +508,15 @@ static int count_clear_counter(int pin) {
 // 3. A keypress is detected (not applicable for "background" commands)
 //
 // Returns /0/ when the further processing is better to be stopped
-//         />0/  when it is ok to continue with counting.
+//         />0/  when it is ok to continue with counting: the counter is already running (started by the ISR)
 // /0/ is returned when this function was interrupted by one of conditions above.
 //
-bool count_wait_for_the_first_pulse(unsigned int pin) {
+bool count_wait_for_the_first_pulse(unsigned int pin, pcnt_unit_t unit) {
 
   struct trigger_arg t = {          // argument for the ISR
     taskid_self(),
-    pin
+    pin,
+    unit
   };
 
   bool  ret = false,                // Return code. >0 everything is ok, a pulse has been received. 0=stop measurement, discard the result
@@ -355,25 +558,336 @@ bool count_wait_for_the_first_pulse(unsigned int pin) {
   return ret;
 }
 
+// Counter history: a sample is the number of pulses counted during the sampling interval
+//
+struct count_sample {
+  uint32_t t_ms;           // sample time, milliseconds since counting started
+  uint32_t pulses;         // pulses counted since previous sample
+};
+
+static struct count_history {
+  struct count_sample *s;  // COUNT_HISTORY samples. Allocated on first use, never freed
+  unsigned int head;       // total number of samples written. Next sample goes to s[head % COUNT_HISTORY]
+  unsigned int period;     // sampling interval, msec
+  unsigned int pin;        // GPIO where pulses were counted
+} history[PCNT_UNIT_MAX] = { 0 };
+
+// Sample running counter /unit/ every /period/ milliseconds for /wait/ milliseconds (or until interrupted if /wait/ is 
+// COUNT_INFINITE). Samples are stored in history[unit] and (optional) written to a file /fp/: as text (CSV) or binary
+// (struct count_sample, little endian) if /bin/ is true
+//
+static void count_log(int unit, uint64_t wait, unsigned int period, FILE *fp, bool bin) {
+
+  struct count_history *h = &history[unit];
+  struct count_sample sample;
+  uint64_t now, next, end;
+  unsigned int total, prev = 0, ms;
+
+  if (!h->s && (h->s = (struct count_sample *)q_malloc(sizeof(struct count_sample) * COUNT_HISTORY, MEM_STATIC)) == NULL) {
+    q_print("% <e>Out of memory: counter history is not available</>\r\n");
+    delay_interruptible(wait);
+    return;
+  }
+  h->head = 0;
+  h->period = period;
+  h->pin = units[unit].pin;
+
+  if (fp && !bin && fprintf(fp, "time_ms,pulses,frequency_hz\n") < 0) {
+    q_print("% <e>Write error: counter history is not saved to the file</>\r\n");
+    fp = NULL;
+  }
+
+  next = units[unit].tsta;
+  end = wait == COUNT_INFINITE ? 0 : units[unit].tsta + wait * 1000ULL;
+
+  while (true) {
+
+    // Sleep until the next sample is due. Sampling is aligned to the start time, so it does not drift
+    next += period * 1000ULL;
+    if (end && next > end)
+      next = end;
+    now = q_micros();
+    ms = next > now ? (unsigned int)((next - now) / 1000ULL) : 0;
+    if (delay_interruptible(ms) != ms)
+      break;
+    if (is_foreground_task() && anykey_pressed())
+      break;
+
+    total = count_read_counter(unit, NULL, NULL);
+    sample.t_ms = (uint32_t)((q_micros() - units[unit].tsta) / 1000ULL);
+    sample.pulses = total - prev;
+    prev = total;
+
+    h->s[h->head & (COUNT_HISTORY - 1)] = sample;
+    h->head++;
+
+    // On a write error (e.g. filesystem is full) sampling continues, but the file is not written anymore
+    if (fp) {
+      bool ok;
+      if (bin)
+        ok = fwrite(&sample, sizeof(sample), 1, fp) == 1;
+      else
+        ok = fprintf(fp, "%lu,%lu,%lu\n", (unsigned long)sample.t_ms, (unsigned long)sample.pulses, 
+                                          (unsigned long)((uint64_t)sample.pulses * 1000ULL / period)) >= 0;
+      if (!ok || fflush(fp) != 0) {
+        q_print("% <e>Write error: counter history is no longer saved to the file</>\r\n");
+        fp = NULL;
+      }
+    }
+
+    if (end && next >= end)
+      break;
+  }
+}
+
+// "show counters history [N]"
+// Display last N samples of every counter which has a history
+//
+static int count_show_history(unsigned int n) {
+
+  unsigned int unit, i, found = 0;
+
+  for (unit = 0; unit < PCNT_UNIT_MAX; unit++) {
+
+    struct count_history *h = &history[unit];
+
+    if (!h->s || !h->head)
+      continue;
+
+    found++;
+    q_printf("%% Counter #%u, GPIO%u, every %u ms, %u samples recorded:\r\n", unit, h->pin, h->period, h->head);
+    q_print("<r>%  Time, sec  |   Pulses   | Frequency, Hz</>\r\n");
+
+    i = h->head - (h->head > COUNT_HISTORY ? COUNT_HISTORY : h->head);
+    if (h->head - i > n)
+      i = h->head - n;
+
+    for (; i < h->head; i++) {
+      const struct count_sample *s = &h->s[i & (COUNT_HISTORY - 1)];
+      q_printf("%% %11.3f | %10lu | %10lu\r\n", s->t_ms / 1000.0f, (unsigned long)s->pulses,
+               (unsigned long)((uint64_t)s->pulses * 1000ULL / h->period));
+    }
+  }
+
+  if (!found)
+    HELP(q_print("% No counter history. Use \"<i>count PIN ... log INTERVAL</>\" to record one\r\n"));
+  return 0;
+}
+
+// Convert PCNT filter value /arg/ (a pulse width in nanoseconds) to APB cycles
+// Returns filter value in range [1..1023] or 0 if /arg/ is not a number
+//
+static unsigned short count_filter_cycles(const char *arg) {
+
+  short int low, high;               // min/max filter values. calculated from APB frequency. 
+  unsigned int val;
+
+  MUST_NOT_HAPPEN(APBFreq == 0);
+
+  // PCNT filter value register is 10-bit wide, with max value of 1023: the number is the "number of cycles of APB bus".
+  // Naive reading of Espressif docs on PCNT makes you think that 1 APB cycle is 1/80MHz, i.e. 12.5ns; Experiments with ESP32, however
+  // shows that APBFreq must be divided by 2 in order to get things working right.
+  // /low/     - lowest possible value for a register, i.e. 1 APB cycle, (25ns if APB is at 80MHz)
+  // /high/    - highest possible value, 1023 * 25 ns
+  // /1000.0f/ - a scalefactor to convert MHz to ns
+#define MAGIC_NUMBER 2      
+  low = (short int)(1000.0f * 1.0f / (float )(APBFreq/MAGIC_NUMBER) + 0.5f/* roundup */); 
+  high = (short int)(1023 * 1000.0f * 1.0f / (float )(APBFreq/MAGIC_NUMBER));
+#undef MAGIC_NUMBER
+
+  if (!arg || !isnum(arg)) {
+    HELP(q_printf("%% Pulse width in nanoseconds [%d .. %d] is expected\r\n"
+                  "%% Time interval precision is %u ns; means %uns and %uns are the same\r\n", low, high, low, 5*low + 1, 6*low - 1));
+    return 0;
+  }
+
+  val = q_atol(arg, 0);
+
+  // clamp filter value, convert it from nanoseconds to APB cycles (i.e. to 1..1023 range)
+  // We do substract 1 from the divisor to compensate for roundup of /low/ we made before. 
+  // This eventually may lead to values > 1023
+  if (val < low) val = low; else 
+  if (val > high) val = high;
+  if ((val = val / (low - 1)) > 1023) val = 1023;
+
+  return val ? val : 1;
+}
+
+// Configure PCNT unit to count rising edges on /pin/, stop and clear it.
+// /ctrl/ is a control pin (count only while it is HIGH) or UNUSED_PIN.
+// /filter/ is a filter value in APB cycles, or 0 to disable the filter
+//
+static void count_config_unit(int unit, unsigned int pin, int ctrl, unsigned short filter) {
+
+  pcnt_config_t cfg = { 0 };
+
+  cfg.pulse_gpio_num = pin;          // pin where we count pulses
+  cfg.ctrl_gpio_num = ctrl;
+  cfg.channel = PCNT_CHANNEL_0;
+  cfg.unit = unit;                   // Counter unit number. From 0 to 7 on ESP32
+  cfg.pos_mode = PCNT_COUNT_INC;     // Increase counter on positive edge
+  cfg.neg_mode = PCNT_COUNT_DIS;     // Do nothing on negative edge
+  cfg.counter_h_lim = PCNT_OVERFLOW; // Higher limit is 20000 pulses and then an interrupt is generated
+
+  if (ctrl != UNUSED_PIN) {
+    cfg.lctrl_mode = PCNT_MODE_DISABLE; // control pin is LOW: counter is frozen
+    cfg.hctrl_mode = PCNT_MODE_KEEP;    // control pin is HIGH: count pulses
+  }
+
+  pcnt_unit_config(&cfg);
+  pcnt_counter_pause(unit);
+  pcnt_counter_clear(unit);
+
+  if (filter) {
+    pcnt_set_filter_value(unit, filter);
+    pcnt_filter_enable(unit);
+  } else
+    pcnt_filter_disable(unit);
+}
+
+// Start (or stop) all units from the /units_mask/ at once: interrupts are disabled so nothing can get in between.
+// Returns common start (stop) timestamp
+//
+static uint64_t count_start_stop(unsigned int units_mask, bool start) {
+
+  uint64_t now;
+  int unit;
+
+  portDISABLE_INTERRUPTS();
+  for (unit = 0; unit < PCNT_UNIT_MAX; unit++)
+    if (units_mask & BIT(unit)) {
+      if (start)
+        pcnt_ll_start_count(&PCNT, unit);
+      else
+        pcnt_ll_stop_count(&PCNT, unit);
+    }
+  now = q_micros();
+  portENABLE_INTERRUPTS();
+
+  return now;
+}
+
+// Batch counting: "count PIN1,PIN2,...,PINn [NUMBER | infinite | filter LENGTH]*"
+// Every pin gets its own PCNT unit; all units are started and stopped at the same time and share
+// the same measurement interval
+//
+static int count_batch(int argc, char **argv) {
+
+  unsigned char  pins[PCNT_UNIT_MAX], unit_of[PCNT_UNIT_MAX];
+  unsigned int   n = 0, i, units_mask = 0, freq;
+  unsigned short filter = 0;
+  unsigned int   filter_ns = 0;
+  uint64_t       wait = PULSE_WAIT, tsta;
+  int16_t        count;
+  const char    *p = argv[1];
+  char           tok[16];
+  int            unit, ret = 0;
+
+  // Parse comma-separated pin list. argv[1] is not modified (see q_nextitem())
+  while (*p) {
+    unsigned int pin;
+
+    if (n >= PCNT_UNIT_MAX) {
+      q_print("% <e>Too many pins</>\r\n");
+      return 1;
+    }
+    if ((p = q_nextitem(p, tok, sizeof(tok))) == NULL || !pin_exist((pin = q_atol(tok, 255))) || pin_isvirtual(pin))
+      return 1;
+    pins[n++] = pin;
+  }
+
+  for (i = 2; i < argc; i++) {
+    if (!q_strcmp(argv[i],"filter")) {
+      if (++i >= argc || (filter = count_filter_cycles(argv[i])) == 0)
+        return CMD_MISSING_ARG;
+      filter_ns = q_atol(argv[i], 0);
+    } else
+    if (!q_strcmp(argv[i],"infinite")) wait = COUNT_INFINITE; else
+    if (isnum(argv[i])) wait = q_atol(argv[i], 1000);
+    else
+      return i;
+  }
+
+  // Claim all units at once or fail
+  for (i = 0; i < n; i++) {
+    if ((unit = count_claim_unit()) < 0) {
+      q_printf("%% <e>Not enough free counters for %u pins</>\r\n", n);
+      ret = CMD_FAILED;
+      goto release_units;
+    }
+    unit_of[i] = unit;
+    units_mask |= BIT(unit);
+    units[unit].pin = pins[i];
+    units[unit].interval = (wait == COUNT_INFINITE ? wait : wait * 1000ULL);
+    if (filter) {
+      units[unit].filter_enabled = 1;
+      units[unit].filter_value = filter_ns;
+    }
+    count_config_unit(unit, pins[i], UNUSED_PIN, filter);
+    count_claim_interrupt(unit);
+  }
+
+  q_printf("%% ⌚ Counting pulses on %u pins...", n);
+  if (is_foreground_task())
+    HELP(q_print("(press <Enter> to abort)"));
+  q_print(CRLF);
+
+  // START
+  tsta = count_start_stop(units_mask, true);
+  for (i = 0; i < n; i++)
+    units[unit_of[i]].tsta = tsta;
+  delay_interruptible(wait);
+  wait = count_start_stop(units_mask, false) - tsta;
+  // STOP
+
+  for (i = 0; i < n; i++) {
+    unit = unit_of[i];
+    pcnt_get_counter_value(unit, &count);
+    count_release_interrupt(unit);
+    units[unit].count = units[unit].overflow * PCNT_OVERFLOW + (unsigned int)count;
+    units[unit].interval = wait;
+    count_release_unit(unit);
+    count_read_counter(unit, &freq, NULL);
+    q_printf("%% GPIO%u: %u pulses in approx. %llu ms (%u Hz, %u IRQs)\r\n", units[unit].pin, units[unit].count, wait / 1000ULL, freq, units[unit].overflow);
+  }
+  return 0;
+
+release_units:
+  while (i--) {
+    count_release_interrupt(unit_of[i]);
+    count_release_unit(unit_of[i]);
+  }
+  return ret;
+}
+
 // Frequency meter / pulse counter main command
-//"count PIN [DELAY_MS | trigger | filter NANOSECONDS]*"
+//"count PIN [DELAY_MS | trigger | filter NANOSECONDS | control PIN]*"
 //"count PIN clear"
 //
 static int cmd_count(int argc, char **argv) {
 
-  pcnt_config_t cfg = { 0 };         // PCNT unit configuration
   unsigned int  pin;                 // Which pin is used to count pulses on?
   uint64_t      wait = PULSE_WAIT;   // Measurement time, in _milliseconds_. Default is 1000ms
   int16_t       count;               // Contents of a PCNT counter
   int           unit,                // PCNT unit number
                 i;                   // Index to argv
-  bool          filter = false;      // enable filtering
+  bool          filter = false,      // enable filtering
+                recip_on = false,    // reciprocal counting is running
+                recip_forced;        // "reciprocal" keyword was used
   unsigned short val;                // Normalized filter value [1..1023]
+  uint8_t       ctrl_intr = 0;       // Control pin interrupt type to restore
+  unsigned int  log_period = 0;      // History sampling interval, msec. 0 = no history
+  const char   *log_path = NULL;     // History file name
+  FILE         *log_fp = NULL;       // History file
   
   // must be at least 2 tokens ("count" and a pin number)
   if (argc < 2)
     return CMD_MISSING_ARG;
 
+  // "count PIN1,PIN2,...PINn"
+  if (strchr(argv[1], ','))
+    return count_batch(argc, argv);
+
   if (!pin_exist((pin = q_atol(argv[1], 255))))
     return 1; // arg1 is bad
 
@@ -394,68 +908,62 @@ static int cmd_count(int argc, char **argv) {
     return 0;
   }
 
-  // PCNT unit configuration: unit number, pin number, counting mode etc
-
-  cfg.pulse_gpio_num = pin;          // pin where we count pulses
-  cfg.ctrl_gpio_num = UNUSED_PIN;    // don't use "control pin" feature
-  cfg.channel = PCNT_CHANNEL_0;    
-  cfg.unit = unit;                   // Counter unit number. From 0 to 7 on ESP32
-  cfg.pos_mode = PCNT_COUNT_INC;     // Increase counter on positive edge
-  cfg.neg_mode = PCNT_COUNT_DIS;     // Do nothing on negative edge
-  cfg.counter_h_lim = PCNT_OVERFLOW; // Higher limit is 20000 pulses and then an interrupt is generated
-
   // Read rest of the parameters: DURATION and/or keywords "trigger", "filter" and others
   i = 1; 
   // start from the 2nd argument to the command: if it is the "filter" keyword, then read and check filter value
   while (++i < argc) {
     if (!q_strcmp(argv[i],"filter")) {
-      short int low, high;               // min/max filter values. calculated from APB frequency. 
 
-      MUST_NOT_HAPPEN(APBFreq == 0);
+      // position to the next argument (a filter value "count 10 trigger filter VALUE")
+      // numeric argument is expected
+      if (++i >= argc || (val = count_filter_cycles(argv[i])) == 0) {
+        count_release_unit(unit);
+        return CMD_MISSING_ARG;
+      }
+
+      filter = true;
+      // these 2 are purely for "show counters"
+      units[unit].filter_enabled = 1;
+      units[unit].filter_value = q_atol(argv[i], 0);
 
-      // PCNT filter value register is 10-bit wide, with max value of 1023: the number is the "number of cycles of APB bus".
-      // Naive reading of Espressif docs on PCNT makes you think that 1 APB cycle is 1/80MHz, i.e. 12.5ns; Experiments with ESP32, however
-      // shows that APBFreq must be divided by 2 in order to get things working right.
-      // /low/     - lowest possible value for a register, i.e. 1 APB cycle, (25ns if APB is at 80MHz)
-      // /high/    - highest possible value, 1023 * 25 ns
-      // /1000.0f/ - a scalefactor to convert MHz to ns
-#define MAGIC_NUMBER 2      
-      low = (short int)(1000.0f * 1.0f / (float )(APBFreq/MAGIC_NUMBER) + 0.5f/* roundup */); 
-      high = (short int)(1023 * 1000.0f * 1.0f / (float )(APBFreq/MAGIC_NUMBER));
-#undef MAGIC_NUMBER
+    } else
+    if (!q_strcmp(argv[i],"control")) {
+      unsigned int ctrl;
+      // "control PIN": count only while PIN is HIGH. 
       if (i + 1 >= argc) {
-bad_filter:        
-        HELP(q_printf("%% Pulse width in nanoseconds [%d .. %d] is expected\r\n"
-                      "%% Time interval precision is %u ns; means %uns and %uns are the same\r\n", low, high, low, 5*low + 1, 6*low - 1));
+        HELP(q_print("% Control pin number is expected\r\n"));
         count_release_unit(unit);
         return CMD_MISSING_ARG;
       }
-
-      // position to the next argument (a filter value "count 10 trigger filter VALUE")
-      // numeric argument is expected
       i++;
-      if (isnum(argv[i])) { 
-  
-        unsigned int val_ns;
-        val_ns = val = q_atol(argv[i],0);
-
-        // clamp filter value, convert it from nanoseconds to APB cycles (i.e. to 1..1023 range)
-        // We do substract 1 from the divisor to compensate for roundup of /low/ we made before. 
-        // This eventually may lead to values > 1023
-        if (val < low) val = low; else 
-        if (val > high) val = high;
-        if ((val = val / (low - 1)) > 1023) val = 1023;
-
-        filter = true;
-        // these 2 are purely for "show counters"
-        units[unit].filter_enabled = 1;
-        units[unit].filter_value = val_ns;
-        
-      } else
-        goto bad_filter;
-
+      if (!pin_exist((ctrl = q_atol(argv[i], 255))) || ctrl == pin || pin_isvirtual(ctrl)) {
+        count_release_unit(unit);
+        return i;
+      }
+      if (count_pin_isr_busy(ctrl)) {
+        q_printf("%% <e>GPIO%u can not be a control pin: its interrupt is in use</>\r\n", ctrl);
+        count_release_unit(unit);
+        return CMD_FAILED;
+      }
+      units[unit].control = 1;
+      units[unit].ctrl_pin = ctrl;
     } else
     if (!q_strcmp(argv[i],"trigger")) units[unit].trigger = 1; else
+    if (!q_strcmp(argv[i],"reciprocal")) units[unit].method = COUNT_RECIP; else
+    if (!q_strcmp(argv[i],"log")) {
+      // "log INTERVAL [file PATH]"
+      if (i + 1 >= argc || (log_period = q_atol(argv[i + 1], 0)) < COUNT_LOG_MIN) {
+        HELP(q_print("% Sampling interval (milliseconds, " xstr(COUNT_LOG_MIN) " or more) is expected\r\n"));
+        count_release_unit(unit);
+        return i + 1 < argc ? i + 1 : CMD_MISSING_ARG;
+      }
+      i++;
+      if (i + 2 < argc && !q_strcmp(argv[i + 1],"file")) {
+        log_path = argv[i + 2];
+        i += 2;
+      }
+    } else
+    if (!q_strcmp(argv[i],"gate")) units[unit].method = COUNT_GATE; else
     if (!q_strcmp(argv[i],"infinite")) wait = COUNT_INFINITE; else
     if (isnum(argv[i])) wait = q_atol(argv[i], 1000);
     else {
@@ -465,27 +973,55 @@ bad_filter:
     }
   }
   // Done processing command arguments.
+  recip_forced = units[unit].method == COUNT_RECIP;
+
+  // Reciprocal counting installs a GPIO ISR on the counted pin. Not possible if the pin interrupt is in use
+  if (recip_forced && units[unit].control) {
+    q_print("% <e>\"reciprocal\" and \"control\" can not be used together</>\r\n");
+    count_release_unit(unit);
+    return CMD_FAILED;
+  }
+  if (recip_forced && count_pin_isr_busy(pin)) {
+    q_printf("%% <e>Reciprocal counting is not available: GPIO%u interrupt is in use</>\r\n", pin);
+    count_release_unit(unit);
+    return CMD_FAILED;
+  }
+
+  if (units[unit].control && units[unit].trigger) {
+    q_print("% <e>\"trigger\" and \"control\" can not be used together</>\r\n");
+    count_release_unit(unit);
+    return CMD_FAILED;
+  }
+
+  // History file: binary if its name ends with ".bin", CSV otherwise
+  if (log_path) {
+#if WITH_FS
+    if ((log_fp = files_fopen(log_path, "w")) == NULL) {
+      count_release_unit(unit);
+      return CMD_FAILED;
+    }
+#else
+    HELP(q_print("% <e>File output requires filesystem support (WITH_FS)</>\r\n"));
+    count_release_unit(unit);
+    return CMD_FAILED;
+#endif
+  }
 
   // Store counter parameters
   units[unit].pin = pin;
   units[unit].interval = (wait == COUNT_INFINITE ? wait : wait * 1000ULL); // store planned time, update it with real one later
   
   q_printf("%% %s pulses on GPIO%d...", units[unit].trigger ? "⏳ Waiting for" : "⌚ Counting", pin);
+  if (units[unit].control)
+    q_printf("(gated by GPIO%u) ", units[unit].ctrl_pin);
   if (is_foreground_task())
     HELP(q_print("(press <Enter> to abort)"));
   q_print(CRLF);
 
   // Configure selected PCNT unit, stop and clear it
-  pcnt_unit_config(&cfg);
-  pcnt_counter_pause(unit);
-  pcnt_counter_clear(unit);
-
-  if (filter) {
-    pcnt_set_filter_value(unit, val );
-    pcnt_filter_enable(unit);
+  count_config_unit(unit, pin, units[unit].control ? (int)units[unit].ctrl_pin : UNUSED_PIN, filter ? val : 0);
+  if (filter)
     VERBOSE(q_printf("%% PCNT filter is enabled: %u APB cycles (%u ns)\r\n",(uint16_t)val, units[unit].filter_value));
-  } else
-    pcnt_filter_disable(unit);
 
 
   // Allocate & attach interrupt handler for the unit. Unit is configured to generate an interrupt every 20000 pulses.
@@ -494,28 +1030,67 @@ bad_filter:
   // A "trigger" keyword. Wait until first pulse, then proceed normally
   if (units[unit].trigger == 1) {
     
-    units[unit].been_triggered = count_wait_for_the_first_pulse(pin) ? 1 : 0;
+    units[unit].been_triggered = count_wait_for_the_first_pulse(pin, unit) ? 1 : 0;
     units[unit].trigger = 0;
 
     // interrupted by the "kill" or a keypress while was in waiting state? 
     if (units[unit].been_triggered == 0) {
               q_print("% Interrupted\r\n");
+      pcnt_counter_pause(unit);             // in case ISR has fired right before we were interrupted
       wait = 0;
       goto release_hardware_and_exit;
     }
   }
 
+  // Gated counting: start tracking gate edges. Initial gate state is read before interrupts are enabled
+  if (units[unit].control) {
+    ctrl_intr = GPIO.pin[units[unit].ctrl_pin].int_type;
+    gpio_install_isr_service((int)ARDUINO_ISR_FLAG);
+    gpio_set_intr_type(units[unit].ctrl_pin, GPIO_INTR_ANYEDGE);
+    gpio_isr_handler_add(units[unit].ctrl_pin, count_ctrl_pin_interrupt, (void *)unit);
+    units[unit].gate_tsta = gpio_get_level(units[unit].ctrl_pin) ? q_micros() : 0;
+    gpio_intr_enable(units[unit].ctrl_pin);
+  }
 
    MUST_NOT_HAPPEN(wait == 0);
 
+  // Timestamp edges for reciprocal counting. Not used for gated counting: the gate would have to be applied
+  // to edge timestamps as well
+  if (recip_forced) {
+    count_recip_start(unit, pin);
+    recip_on = true;
+  }
+
   // Actual measurement is made here:
   // START
-  units[unit].tsta = q_micros();            // record a timestamp in micro seconds
-  pcnt_counter_resume(unit);                // enable counter
-  delay_interruptible(wait);                // delay 
+  if (!units[unit].been_triggered) {        // "trigger" counters are started by the ISR already
+    units[unit].tsta = q_micros();          // record a timestamp in micro seconds
+    pcnt_counter_resume(unit);              // enable counter
+  }
+  if (log_period)                           // delay (and record history)
+    count_log(unit, wait, log_period, log_fp, log_path && strlen(log_path) > 4 && !strcmp(log_path + strlen(log_path) - 4, ".bin"));
+  else
+    delay_interruptible(wait);
   pcnt_counter_pause(unit);                 // stop counting as soon as possible to get more accurate results, especially at higher frequencies
   wait = q_micros() - units[unit].tsta;     // actual measurement time in MICROSECONDS
   // STOP
+
+  if (recip_on)
+    count_recip_stop(unit);
+
+#if WITH_FS
+  if (log_fp)
+    files_fclose(log_fp);
+#endif
+
+  // Gated counting: measurement time is the time the gate was open
+  if (units[unit].control) {
+    gpio_intr_disable(units[unit].ctrl_pin);
+    gpio_set_intr_type(units[unit].ctrl_pin, (gpio_int_type_t)ctrl_intr);
+    gpio_isr_handler_remove(units[unit].ctrl_pin);
+    wait = count_gate_time(unit);
+    units[unit].gate_tsta = 0;
+  }
   
  // Free up resources associated with the counter. Free up interrupt, stop and clear counter, calculate
  // frequency, pulses count (yes it is calculated). Store calculated values & a timestamp in /units[]/ for later reference
@@ -531,47 +1106,117 @@ release_hardware_and_exit:
 
   units[unit].interval = wait; 
 
+  // Select measurement method
+  units[unit].method = COUNT_GATE;
+  if (recip_on) {
+    if (count_recip_better(COUNT_RECIP, units[unit].count, recip[unit].edges, recip[unit].off)) {
+      float jitter;
+      units[unit].method = COUNT_RECIP;
+      units[unit].rfreq = count_recip_calc(recip[unit].edges, recip[unit].sum, recip[unit].period, CPUFreq, &jitter);
+      units[unit].jitter = jitter;
+    } else if (recip[unit].off)
+      q_print("% Signal is too fast for reciprocal counting, gate counting is used\r\n");
+  }
+
   // mark this PCNT unit as unused
   count_release_unit(unit);
 
   // print measurement results. 
   unsigned int freq;
   count_read_counter(unit,&freq,NULL);
-  q_printf("%% %u pulses in approx. %llu ms (%u Hz, %u IRQs)\r\n", units[unit].count, units[unit].interval / 1000ULL, freq, units[unit].overflow);
+  if (units[unit].method == COUNT_RECIP)
+    q_printf("%% %u pulses in approx. %llu ms (%.3f Hz reciprocal, jitter %.2f us)\r\n", units[unit].count, units[unit].interval / 1000ULL, units[unit].rfreq, units[unit].jitter);
+  else
+    q_printf("%% %u pulses in approx. %llu ms (%u Hz, %u IRQs)\r\n", units[unit].count, units[unit].interval / 1000ULL, freq, units[unit].overflow);
 
   return 0;
 }
 
+// Estimate measurement error of a stopped counter and display it.
+// Timing error is the sum of start and stop latencies plus timestamp resolution (1us): start latency is
+// the interrupt latency for "trigger" and "control" counters, and the cost of pcnt_counter_resume() for others.
+// Pulses which arrive after the triggering edge but before the counter is started are lost
+//
+static void count_error_budget(int unit) {
+
+  unsigned int freq, start_ns, err_ns, ppm;
+  uint64_t interval;
+  const char *how;
+
+  count_read_counter(unit, &freq, &interval);
+  if (!interval)
+    return;
+
+  // Reciprocal counting: timing error of every edge is the interrupt latency jitter; it is averaged out
+  // over the measurement, what is left is displayed as period jitter
+  if (units[unit].method == COUNT_RECIP) {
+    q_printf("%%  %d | reciprocal counting, %.3f Hz, period jitter %.2f us\r\n", unit, units[unit].rfreq, units[unit].jitter);
+    return;
+  }
+
+  if (units[unit].control) {
+    // both gate edges are delayed by the same ISR latency: only its jitter matters. count it twice (open & close)
+    start_ns = COUNT_ISR_LATENCY * 1000UL / CPUFreq;
+    err_ns = 2 * start_ns + 1000;
+    how = "gated";
+  } else {
+    start_ns = (units[unit].been_triggered ? COUNT_ISR_LATENCY : COUNT_API_LATENCY) * 1000UL / CPUFreq;
+    err_ns = start_ns + COUNT_API_LATENCY * 1000UL / CPUFreq + 1000;
+    how = units[unit].been_triggered ? "trigger ISR" : "task";
+  }
+
+  ppm = (unsigned int)(err_ns * 1000ULL / interval);
+
+  q_printf("%%  %d | start latency ~%u ns (%s), error ±%u ppm (±%u Hz)", unit, start_ns, how, ppm, 
+           (unsigned int)((uint64_t)freq * ppm / 1000000ULL));
+  if (units[unit].been_triggered)
+    q_printf(", up to %u pulse(s) missed", (unsigned int)((uint64_t)freq * start_ns / 1000000000ULL));
+  if (units[unit].control)
+    q_printf(", gated by GPIO%u", units[unit].ctrl_pin);
+  q_print(CRLF);
+}
+
 // Display counters (stopped or running. information is retained on stopped counters)
 // as a fancy table.
 //
 // This one is called from cmd_show(...)
 //
-static int cmd_show_counters(UNUSED int argc, UNUSED char **argv) {
+static int cmd_show_counters(int argc, char **argv) {
 
   int i;
   unsigned int cnt, freq;
   uint64_t interval;
+  bool hdr = false;
+
+  // "show counters history [N]"
+  if (argc > 2) {
+    if (q_strcmp(argv[2], "history"))
+      return 2;
+    return count_show_history(argc > 3 ? q_atol(argv[3], 20) : 20);
+  }
 
   // Fancy header
   q_print("<r>"
           "%PCNT|Pin|  Status |   TaskID   | Pulse count | Time, msec |Frequency |Filter,ns</>\r\n"
           "%----+---+---------+------------+-------------+------------+----------+---------\r\n");
 
-  mutex_lock(PCNT_mux);
   for (i = 0; i < PCNT_UNIT_MAX; i++) {
     cnt = count_read_counter(i,&freq,&interval);
     
 // wish we can have #pragma in #define ..
 
-    q_printf("%%  %d |%3u| %s | 0x%08x | <g>%11u</> | %10llu | %8u | ", 
+    q_printf("%%  %d |%3u| %s | 0x%08x | <g>%11u</> | %10llu | ", 
                   i, 
                   units[i].pin,
                   count_state_name(i),
                   (uintptr_t)units[i].taskid,
                   cnt,
-                  interval / 1000ULL,
-                  freq); 
+                  interval / 1000ULL);
+    // reciprocal counting results have fractional part
+    if (!units[i].in_use && units[i].method == COUNT_RECIP)
+      q_printf("%8.3f | ", units[i].rfreq);
+    else
+      q_printf("%8u | ", freq);
     if (units[i].filter_enabled)
       q_printf(" <i>%u</>\r\n", units[i].filter_value);
     else
@@ -579,13 +1224,22 @@ static int cmd_show_counters(UNUSED int argc, UNUSED char **argv) {
 
   }
 
-  if (pcnt_counters) {
-    q_printf("%% %u counter%s %s currently in use\r\n",PPA(pcnt_counters), pcnt_counters == 1 ? "is" : "are");
+  // Error estimates for stopped counters
+  for (i = 0; i < PCNT_UNIT_MAX; i++)
+    if (units[i].been_used && !units[i].in_use && units[i].interval) {
+      if (!hdr) {
+        q_print("%\r\n% Error budget (estimated) for stopped counters:\r\n");
+        hdr = true;
+      }
+      count_error_budget(i);
+    }
+
+  if ((i = atomic_load(&pcnt_counters)) > 0) {
+    q_printf("%% %u counter%s %s currently in use\r\n",PPA(i), i == 1 ? "is" : "are");
     HELP(q_print("% Use the command \"<i>kill TASK_ID</>\" to stop a running counter\r\n"));
   }
   else
     q_print("% All counters are stopped\r\n");
-  mutex_unlock(PCNT_mux);
   return 0;
 }
 
@@ -50,6 +50,16 @@ static uint8_t camera_mode = PIXFORMAT_JPEG;
 static uint8_t camera_size = FRAMESIZE_QVGA;
 static uint8_t camera_buffers = 1;
 
+// LEDC resources used by the camera to generate XCLK (used by PWM module to avoid conflicts)
+// Returns /true/ and fills /chan/ and /timer/ if camera is up
+//
+static bool espcam_ledc(unsigned int *chan, unsigned int *timer) {
+  if (!cam_good)
+    return false;
+  *chan = config.ledc_channel;
+  *timer = config.ledc_timer;
+  return true;
+}
 
 // Known camera/board models: pins database
 // This one must be kept in sync with ESP-IDF camera driver
@@ -64,6 +64,7 @@
 #include <ctype.h>
 #include <errno.h>
 #include <time.h>
+#include <math.h>
 #include <assert.h>
 #include <stdatomic.h>
 
@@ -83,6 +84,7 @@
 #include <soc/pcnt_struct.h>
 #include <soc/efuse_reg.h>
 #include <hal/gpio_ll.h>
+#include <hal/pcnt_ll.h>
 #include <driver/gpio.h>
 #include <driver/pcnt.h>
 #include <driver/uart.h>
@@ -90,6 +92,7 @@
 #include <esp_timer.h>
 #include <esp_chip_info.h>
 #include <esp_task_wdt.h>
+#include <driver/rmt_tx.h>
 
 // Low-level Xtensa and RISCV API
 #ifdef __XTENSA__
@@ -247,7 +250,16 @@ static bool pin_exist(unsigned char pin);
 static bool pin_exist_silent(unsigned char pin);
 static bool pin_is_reserved(unsigned char pin);
 static bool pin_can_wakeup(uint8_t pin);
+static inline __attribute__((always_inline)) uint32_t cpu_ticks();
+#if WITH_ESPCAM
+static bool espcam_ledc(unsigned int *chan, unsigned int *timer);
+#endif
 
+#if WITH_ALIAS
+struct ifcond;
+static void ifc_account_latency(struct ifcond *ifc, uint64_t tsta);
+static bool ifc_pin_has_isr(unsigned int pin);
+#endif
 static bool nv_save_config(); // saves sensitive espshell information: hostid and timezone
 static const struct keywords_t *change_command_directory(uintptr_t,const struct keywords_t *,const char *,const char *text);
 
@@ -411,6 +423,7 @@ static argcargv_t *AA = NULL;   // only valid for foreground commands;
                                 // used to access raw user input, mainly by alias code
                                 // NOTE: not thread-safe
 static int espshell_command(char *p, argcargv_t *aa);
+static void espshell_display_error(int ret, int argc, char **argv);
 
 
 // 5. ESPShell core
@@ -445,16 +458,20 @@ static int espshell_command(char *p, argcargv_t *aa);
 #include "nvs0.h"               // NVS editor/viewer
 #include "memory.h"             // memory component
 #include "espcam.h"             // camera support
+#include "watch.h"              // "var watch": sampling sketch variables, change log
 
 #if WITH_ALIAS
 #  include "alias.h"            // Aliases
 #  include "ifcond.h"           // commands "if" and "every"
+#  include "snapshot.h"         // binary snapshots of aliases, conditions and sequences
 #endif
 
 #if WITH_WIFI
 #  include "wifi0.h"             // WiFi access point and WiFi client (station)
 #endif
 
+#include "export.h"             // "var export": binary telemetry frames of sketch variables
+
 
 // 6. These two must be included last as they are supposed to call functions from every other module
 #include "show.h"               // "show KEYWORD [ARG1 ARG2 ... ARGn]" command
@@ -861,7 +878,7 @@ static  void espshell_initonce() {
     convar_add(bypass_va);         // disable address checks, qlib.h
     convar_add(tbl_min_len);       // buffers whose length is > printhex_tbl (def: 16) are printed as fancy tables
     convar_add(ledc_res);          // Override PWM duty cycle resolution bitwidth: Duty range is from 0 to (2**ledc_res-1)
-    convar_add(pwm_ch_inc);        // 1 or 2: hop over odd or even channel numbers.
+    convar_add(pwm_ch_inc);        // 2: PWM outputs prefer timers of their own, 1: prefer sharing timers (same frequency only)
 #if WITH_ESPCAM
     convar_add(cam_ledc_chan);  // Avoiding interference: LEDC channels used by ESPCAM for generating XCLK
     convar_add(cam_ledc_timer);    // Avoiding interference: ESP32 TIMER used by ESPCAM
@@ -213,15 +213,18 @@ void pinForceMode(unsigned int pin, unsigned int flags);
 //
 //    Variable types supported: 
 //
-//      1. Simple types: unsigned/signed char, short, int and long; float; bool;
+//      1. Simple types: unsigned/signed char, short, int, long and long long; float, double; bool;
 //      2. Pointers: pointers to Simple Types, a pointer to a pointer
 //      3. Arrays: arrays of Simple Types, arrays of Pointers
+//      4. Fields of structures: convar_add(my_struct.field) for a single structure,
+//         convar_addfa(my_array, field) for a field of every element of an array of structures
 //
 //    To register a non-pointer type variable (i.e. "int", "unsigned char" and so on) use "convar_add()"
 //    To register a pointer to a simple scalar type use convar_addp()
 //    To register a pointer to a pointer use convar_addpp()
 //    Arrays of scalar types are registered with convar_adda()
 //    Arrays of pointers are registered with convar_addap()
+//    Fields of an array of structures are registered with convar_addfa()
 // 
 //    Example: register sketch variables in ESPShell
 //    ...
@@ -238,6 +241,7 @@ void pinForceMode(unsigned int pin, unsigned int flags);
 //    convar_add(another_variable);  // add a simple type variable
 //    convar_addpp(bb);              // add pointer to a pointer
 //    convar_addap(arr2);            // add an array of pointers
+//    convar_addfa(points, x);       // add "points.x": points[0].x, points[1].x, ... ("struct point points[10]")
 //
 //
 
@@ -247,6 +251,7 @@ extern float dummy_float;
 void espshell_varadd (const char *, void *, int, bool, bool, bool);
 void espshell_varaddp(const char *, void *, int, bool, bool, bool);
 void espshell_varadda(const char *, void *, int, int,  bool, bool, bool);
+void espshell_varadds(const char *, void *, int, int, int, bool, bool);
 
 // a) Register a non-pointer variable of a simple (builtin) type (e.g. float, 
 //    unsigned int, signed char, bool and so on)
@@ -280,6 +285,15 @@ void espshell_varadda(const char *, void *, int, int,  bool, bool, bool);
           espshell_varadda( #VAR, &VAR, sizeof(VAR[0]), sizeof(VAR) / sizeof(VAR[0]), 0, 1, 1); \
 } while ( 0 )
 
+// Register a field of an array of structures (e.g. field "x" of "struct point points[10]"). The variable is
+// named "points.x", its elements are points[0].x ... points[9].x
+#  define convar_addfa( VAR, FIELD ) do { \
+          __typeof__(VAR[0].FIELD) __x = ( __typeof__(VAR[0].FIELD) )(-1); \
+          bool is_signed = (__x < 0);   /* HELLO! If you see this warning during compilation - just ignore it :) */ \
+          espshell_varadds( #VAR "." #FIELD, &VAR[0].FIELD, sizeof(VAR[0].FIELD), sizeof(VAR[0]), sizeof(VAR) / sizeof(VAR[0]), \
+                            (__builtin_classify_type(VAR[0].FIELD) == __builtin_classify_type(dummy_float)), !is_signed); \
+} while ( 0 )
+
 #else
 // convar_addX API disabled
 #  define convar_add( ... )  do {} while( 0 )
@@ -287,6 +301,7 @@ void espshell_varadda(const char *, void *, int, int,  bool, bool, bool);
 #  define convar_adda( ... ) do {} while( 0 )
 #  define convar_addpp( ... ) do {} while( 0 )
 #  define convar_addap( ... ) do {} while( 0 )
+#  define convar_addfa( ... ) do {} while( 0 )
 #endif
 
 #ifdef __cplusplus
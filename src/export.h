@@ -0,0 +1,429 @@
+/*
+ * This file is a part of the ESPShell Arduino library (Espressif's ESP32-family CPUs)
+ *
+ * Latest source code can be found at Github: https://github.com/vvb333007/espshell/
+ * Stable releases: https://github.com/vvb333007/espshell/tags
+ *
+ * Feel free to use this code as you wish: it is absolutely free for commercial and
+ * non-commercial, education purposes.  Credits, however, would be greatly appreciated.
+ *
+ * Author: Viacheslav Logunov <vvb333007@gmail.com>
+ */
+
+// -- Variables exporter (telemetry) --
+//
+// "var export NAME [NAME ...] [every MS] uart NUM|file PATH|udp HOST PORT"
+// "var export stop"
+// "var export"       - display exporter status
+//
+// Periodically sends values of selected sketch variables in binary frames, so they can be collected by
+// a program without parsing "var" output. Variables are resolved to handles once, when the exporter is
+// started: building a frame is a memcpy() of every variable to its fixed offset in the frame.
+//
+// Frame: struct export_hdr followed by a payload of /len/ bytes. All values are little-endian.
+//
+//   EXPORT_SCHEMA frame describes the layout of data frames. Payload is a list of /nvars/ descriptors:
+//                 type (1 byte: CONVAR_COND_SIGNED, _UNSIGNED or _FLOAT), size (1 byte), offset in the
+//                 data payload (2 bytes), name length (1 byte), name (no terminating zero)
+//   EXPORT_DATA   frame: variable values, each at its offset. No padding between values
+//
+// Schema is sent when exporter starts and then every EXPORT_SCHEMA_EVERY data frames, so a receiver which
+// was started later can decode the stream. Sequence numbers (/seq/) let the receiver detect lost frames
+//
+// Only one exporter can be active at a time.
+//
+
+#if COMPILING_ESPSHELL
+
+#define EXPORT_MAGIC        0x5845 // "EX"
+#define EXPORT_SCHEMA       1
+#define EXPORT_DATA         2
+#define EXPORT_SCHEMA_EVERY 64     // resend the schema every 64 data frames
+#define EXPORT_MAX_VARS     32     // max number of variables in a frame
+#define EXPORT_INTERVAL_DEF 1000   // default interval, ms
+
+// Destinations
+#define EXPORT_TO_UART 0
+#define EXPORT_TO_FILE 1
+#define EXPORT_TO_UDP  2
+
+struct export_hdr {
+  uint16_t magic;   // EXPORT_MAGIC
+  uint8_t  type;    // EXPORT_SCHEMA or EXPORT_DATA
+  uint8_t  nvars;   // number of variables
+  uint16_t seq;     // data frame number. Schema frames have the number of the next data frame
+  uint16_t len;     // payload length
+  uint32_t ts;      // q_millis() when the frame was built
+} __attribute__((packed));
+
+struct export_var {
+  void    *ptr;     // variable address
+  uint16_t offset;  // offset in the data payload
+  uint8_t  size;    // variable size
+};
+
+struct exporter {
+  struct export_var vars[EXPORT_MAX_VARS];
+  uint8_t   nvars;
+  uint8_t   dest;         // EXPORT_TO_UART ...
+  uint8_t   uart;         // UART number for EXPORT_TO_UART
+  uint32_t  interval;     // ms
+  uint32_t  frames;       // data frames sent
+  uint32_t  errors;       // frames which were not sent
+  FILE     *fp;           // EXPORT_TO_FILE
+#if WITH_WIFI
+  int       sock;         // EXPORT_TO_UDP
+  struct sockaddr_in addr;
+#endif
+  uint8_t  *schema;       // schema frame, built once
+  uint16_t  schema_len;
+  uint8_t  *data;         // data frame buffer
+  uint16_t  data_len;
+};
+
+static struct exporter *Exporter = NULL;       // active exporter, NULL if there is none
+static task_t           Export_task = NULL;
+static mutex_t          Export_mux = MUTEX_INIT;
+
+// Send a frame to the destination. Returns /true/ on success
+//
+static bool export_send(struct exporter *e, const uint8_t *frame, unsigned int len) {
+
+  switch (e->dest) {
+    case EXPORT_TO_UART: return uart_write_bytes(e->uart, frame, len) == len;
+    case EXPORT_TO_FILE: return fwrite(frame, 1, len, e->fp) == len;
+#if WITH_WIFI
+    case EXPORT_TO_UDP:  return sendto(e->sock, frame, len, 0, (struct sockaddr *)&e->addr, sizeof(e->addr)) == len;
+#endif
+    default: break;
+  }
+  return false;
+}
+
+// Release resources
+//
+static void export_free(struct exporter *e) {
+
+  if (e) {
+#if WITH_FS
+    if (e->fp)
+      files_fclose(e->fp);
+#endif
+#if WITH_WIFI
+    if (e->sock >= 0)
+      close(e->sock);
+#endif
+    if (e->schema)
+      q_free(e->schema);
+    if (e->data)
+      q_free(e->data);
+    q_free(e);
+  }
+}
+
+// Exporter task: sends a data frame every e->interval milliseconds until it receives a signal
+//
+static void export_task(void *arg) {
+
+  struct exporter *e = (struct exporter *)arg;
+  struct export_hdr *hdr = (struct export_hdr *)e->data;
+  uint8_t *payload = e->data + sizeof(struct export_hdr);
+  uint32_t next = q_millis(), now, i;
+  uint16_t seq = 0;
+
+  while (true) {
+
+    // Schema goes first and then every EXPORT_SCHEMA_EVERY frames
+    if (!(seq % EXPORT_SCHEMA_EVERY)) {
+      ((struct export_hdr *)e->schema)->seq = seq;
+      ((struct export_hdr *)e->schema)->ts = q_millis();
+      if (!export_send(e, e->schema, e->schema_len))
+        e->errors++;
+    }
+
+    // Data frame: no formatting, just copy values
+    hdr->seq = seq++;
+    hdr->ts = q_millis();
+    for (i = 0; i < e->nvars; i++)
+      memcpy(payload + e->vars[i].offset, e->vars[i].ptr, e->vars[i].size);
+
+    if (export_send(e, e->data, e->data_len))
+      e->frames++;
+    else
+      e->errors++;
+
+    if (e->dest == EXPORT_TO_FILE)
+      fflush(e->fp);
+
+    // Keep the rate regardless of the time spent on sending
+    next += e->interval;
+    now = q_millis();
+    if ((int32_t)(next - now) <= 0)
+      next = now;
+
+    // Any signal stops the exporter
+    if (task_wait_for_signal(NULL, next - now))
+      break;
+  }
+
+  mutex_lock(Export_mux);
+  if (Exporter == e) {
+    Exporter = NULL;
+    Export_task = NULL;
+  }
+  mutex_unlock(Export_mux);
+
+  export_free(e);
+  task_finished();
+}
+
+// Build schema and data frame buffers. Variables must be already resolved (vars[] and nvars are set)
+// /h/ - resolved handles, /names/ - names as they were typed
+//
+static bool export_build(struct exporter *e, const struct convar_handle *h, char **names) {
+
+  struct export_hdr *hdr;
+  unsigned int i, len = 0, slen = 0;
+  uint8_t *p;
+
+  // Calculate offsets and the schema size
+  for (i = 0; i < e->nvars; i++) {
+    e->vars[i].offset = len;
+    len += e->vars[i].size;
+    slen += 5 + strlen(names[i]);
+  }
+
+  e->data_len = sizeof(struct export_hdr) + len;
+  e->schema_len = sizeof(struct export_hdr) + slen;
+
+  if ((e->data = (uint8_t *)q_malloc(e->data_len, MEM_TMP)) == NULL ||
+      (e->schema = (uint8_t *)q_malloc(e->schema_len, MEM_TMP)) == NULL)
+    return false;
+
+  hdr = (struct export_hdr *)e->data;
+  hdr->magic = EXPORT_MAGIC;
+  hdr->type = EXPORT_DATA;
+  hdr->nvars = e->nvars;
+  hdr->len = len;
+
+  hdr = (struct export_hdr *)e->schema;
+  hdr->magic = EXPORT_MAGIC;
+  hdr->type = EXPORT_SCHEMA;
+  hdr->nvars = e->nvars;
+  hdr->len = slen;
+
+  for (p = e->schema + sizeof(struct export_hdr), i = 0; i < e->nvars; i++) {
+    uint8_t nlen = strlen(names[i]);
+    *p++ = h[i].isf ? CONVAR_COND_FLOAT : (h[i].isu || h[i].isp ? CONVAR_COND_UNSIGNED : CONVAR_COND_SIGNED);
+    *p++ = e->vars[i].size;
+    *p++ = e->vars[i].offset & 0xff;
+    *p++ = e->vars[i].offset >> 8;
+    *p++ = nlen;
+    memcpy(p, names[i], nlen);
+    p += nlen;
+  }
+  return true;
+}
+
+// Open the destination: "uart NUM", "file PATH" or "udp HOST PORT", starting at argv[i]
+// Returns 0 on success or the index of the bad argument
+//
+static int export_open(struct exporter *e, int argc, char **argv, int i) {
+
+  if (!strcmp(argv[i], "uart")) {
+    if (i + 1 >= argc)
+      return CMD_MISSING_ARG;
+    e->dest = EXPORT_TO_UART;
+    e->uart = q_atol(argv[i + 1], NUM_UARTS);
+    if (!uart_isup(e->uart)) {
+      q_printf(Error_UART_Down, e->uart);
+      return i + 1;
+    }
+    return 0;
+  }
+
+  if (!strcmp(argv[i], "file")) {
+    if (i + 1 >= argc)
+      return CMD_MISSING_ARG;
+#if WITH_FS
+    e->dest = EXPORT_TO_FILE;
+    if ((e->fp = files_fopen(argv[i + 1], "wb")) == NULL)
+      return i + 1;
+    return 0;
+#else
+    HELP(q_print("% <e>File output requires filesystem support (WITH_FS)</>\r\n"));
+    return i;
+#endif
+  }
+
+#if WITH_WIFI
+  if (!strcmp(argv[i], "udp")) {
+
+    struct addrinfo hints = { 0 }, *res = NULL;
+    unsigned int port;
+
+    if (i + 2 >= argc)
+      return CMD_MISSING_ARG;
+
+    if ((port = q_atol(argv[i + 2], 0)) == 0 || port > 65535)
+      return i + 2;
+
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(argv[i + 1], NULL, &hints, &res) != 0 || !res) {
+      q_printf("%% <e>Can not resolve \"%s\"</>\r\n", argv[i + 1]);
+      return i + 1;
+    }
+    memcpy(&e->addr, res->ai_addr, sizeof(e->addr));
+    e->addr.sin_port = htons(port);
+    freeaddrinfo(res);
+
+    if ((e->sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0) {
+      q_print("% <e>Failed to create a socket</>\r\n");
+      return CMD_FAILED;
+    }
+    e->dest = EXPORT_TO_UDP;
+    return 0;
+  }
+#endif
+
+  return i;
+}
+
+// "var export" : status
+//
+static int export_show() {
+
+  mutex_lock(Export_mux);
+  if (!Exporter)
+    q_print("% Exporter is not running\r\n");
+  else
+    q_printf("%% Exporting %u variable%s every %lu ms, %u bytes per frame: %lu frames sent, %lu errors\r\n",
+             PPA(Exporter->nvars), Exporter->interval, Exporter->data_len, Exporter->frames, Exporter->errors);
+  mutex_unlock(Export_mux);
+  return 0;
+}
+
+// "var export stop"
+//
+static int export_stop() {
+
+  mutex_lock(Export_mux);
+  if (Export_task)
+    task_signal(Export_task, SIGNAL_TERM);
+  mutex_unlock(Export_mux);
+  return 0;
+}
+
+// "var export NAME [NAME ...] [every MS] uart NUM|file PATH|udp HOST PORT"
+// "var export stop"
+// "var export"
+//
+static int cmd_var_export(int argc, char **argv) {
+
+  struct convar_handle h[EXPORT_MAX_VARS];
+  char *names[EXPORT_MAX_VARS];
+  struct exporter *e;
+  int i, err;
+  bool dest = false;
+
+  if (argc < 3)
+    return export_show();
+
+  if (!strcmp(argv[2], "stop"))
+    return export_stop();
+
+  // Check before the destination is opened: opening a file truncates it. Checked once more when
+  // the exporter is started
+  mutex_lock(Export_mux);
+  err = Exporter != NULL;
+  mutex_unlock(Export_mux);
+  if (err) {
+    q_print("% <e>Exporter is already running, use \"var export stop\" first</>\r\n");
+    return CMD_FAILED;
+  }
+
+  if ((e = (struct exporter *)q_malloc(sizeof(struct exporter), MEM_TMP)) == NULL)
+    return CMD_FAILED;
+
+  memset(e, 0, sizeof(*e));
+  e->interval = EXPORT_INTERVAL_DEF;
+#if WITH_WIFI
+  e->sock = -1;
+#endif
+
+  for (i = 2; i < argc; i++) {
+
+    if (!strcmp(argv[i], "every")) {
+      if (i + 1 >= argc) {
+        err = CMD_MISSING_ARG;
+        goto fail;
+      }
+      if ((e->interval = q_atol(argv[++i], 0)) == 0) {
+        err = i;
+        goto fail;
+      }
+    } else if (!strcmp(argv[i], "uart") || !strcmp(argv[i], "file") || !strcmp(argv[i], "udp")) {
+      if (dest) {
+        err = i;
+        goto fail;
+      }
+      if ((err = export_open(e, argc, argv, i)) != 0)
+        goto fail;
+      dest = true;
+      i += e->dest == EXPORT_TO_UDP ? 2 : 1;
+    } else {
+      // Variable name. Names which are the same as keywords above must start with "$"
+      if (e->nvars >= EXPORT_MAX_VARS) {
+        q_printf("%% <e>Too many variables (max is %u)</>\r\n", EXPORT_MAX_VARS);
+        err = i;
+        goto fail;
+      }
+      names[e->nvars] = argv[i][0] == '$' ? argv[i] + 1 : argv[i];
+      if (!convar_resolve(names[e->nvars], &h[e->nvars], true)) {
+        err = i;
+        goto fail;
+      }
+      e->vars[e->nvars].ptr = h[e->nvars].ptr;
+      e->vars[e->nvars].size = h[e->nvars].size;
+      e->nvars++;
+    }
+  }
+
+  if (!e->nvars || !dest) {
+    HELP(q_print("% <e>Variable names and a destination (uart, file or udp) are expected</>\r\n"));
+    err = CMD_MISSING_ARG;
+    goto fail;
+  }
+
+  if (!export_build(e, h, names)) {
+    err = CMD_FAILED;
+    goto fail;
+  }
+
+  mutex_lock(Export_mux);
+  if (Exporter) {
+    mutex_unlock(Export_mux);
+    q_print("% <e>Exporter is already running, use \"var export stop\" first</>\r\n");
+    err = CMD_FAILED;
+    goto fail;
+  }
+  Exporter = e;
+  if ((Export_task = task_new(export_task, e, "export", shell_core)) == NULL) {
+    Exporter = NULL;
+    mutex_unlock(Export_mux);
+    q_print("% <e>Failed to start the exporter task</>\r\n");
+    err = CMD_FAILED;
+    goto fail;
+  }
+  mutex_unlock(Export_mux);
+
+  HELP(q_printf("%% Exporting %u variable%s every %lu ms, %u bytes per frame\r\n", PPA(e->nvars), e->interval, e->data_len));
+  return 0;
+
+fail:
+  export_free(e);
+  return err;
+}
+
+#endif // #if COMPILING_ESPSHELL
@@ -27,7 +27,9 @@
 //
 // When a GPIO interrupt occurs, all ifconds bound to that GPIO are checked,
 // and their associated aliases are executed. Timed events are managed
-// by esp_timer.
+// by the timer wheel, which is driven by a single esp_timer.
+// Conditions on registered variables ("if $NAME ...") are checked by a single
+// change detector, which compares variables against their shadow copies.
 //
 // Thread safety:
 // The ifcond list is protected by a global rwlock (ifc_rw) *and* by disabling
@@ -42,12 +44,10 @@
 // struct alias are *persistent pointers*, meaning they always point to
 // valid memory.
 //
-// TODO: Variables: if ($var_name eq|lt|gt|le|ge|ne imm)*
 // TODO: One-shots: absence of rising/falling/poll keywords indicates a one-shot
 //       condition, which is discarded after use
 // TODO: Refactor to use userinput_read_timespec
 // TODO: WiFi and IP event catcher (if got|lost ip, if sta|ap connected)
-// TODO: "break" keyword to interrupt alias execution
 
 #ifdef COMPILING_ESPSHELL
 #if WITH_ALIAS
@@ -70,6 +70,27 @@
 // "every ..." commands.
 // This is a variant of polled ifconds.
 //
+// There is a list of "variable" ifconds: ifconds[VAR_IDX], used by
+// "if $NAME eq|ne|lt|gt|le|ge VALUE ..." and "if $NAME changed ..." commands
+// without the "poll" keyword. These are activated by the variable change detector
+// (see ifc_vars_scan()). Variable conditions with the "poll" keyword are stored in
+// the ifconds[NO_TRIGGER] list, as any other polled ifcond.
+//
+
+// Number of recent events remembered by each ifcond (see "show if NUM")
+#define IFC_RECENT 4
+
+// Event snapshot: taken by the ISR (or by a timer callback) at the moment of the event:
+// the timestamp and the state of all GPIOs.
+//
+struct ifc_snapshot {
+  uint64_t tsta;            // q_micros() at the moment of the event
+  uint32_t ccount;          // CPU cycle counter at the moment of the event (per-core, see cpu_ticks())
+  uint32_t in;              // GPIO 0..31 input values
+  uint32_t in1;             // GPIO 32..63 input values
+};
+
+
 struct ifcond {
 
   struct ifcond *next;      // ifconds with the same pin
@@ -80,7 +101,8 @@ struct ifcond {
 
   uint8_t trigger_pin;      // GPIO where a RISING or FALLING edge is expected, or
                             // NO_TRIGGER for a pure conditional ifcond, or
-                            // EVERY_IDX for ifconds created by the "every" command
+                            // EVERY_IDX for ifconds created by the "every" command, or
+                            // VAR_IDX for change-driven variable conditions
 
   uint8_t trigger_rising:1; // 1 == rising, 0 == falling
   uint8_t has_high:1;       // has "high" statements?
@@ -91,12 +113,17 @@ struct ifcond {
   uint8_t alive:1;          // is this entry active, or is it on the ifc_unused list?
                             // set/reset by ifc_get() and ifc_put()
   uint8_t disabled:1;       // disabled entries skip alias execution
+  uint8_t has_var:1;        // has a variable condition ("if $NAME ...")?
+  uint8_t is_inline:1;      // has "inline" keyword? (execute alias from ifc_task(), without creating a task)
 
   uint16_t id;              // unique ID for delete/clear commands
   uint16_t rlimit;          // once per X milliseconds (max ~1 time per minute,
                             // 65535 ms)
   uint32_t poll_interval;   // poll interval, in seconds, for non-trigger ifconds
-  timer_t  timer;           // timer handle for periodic events
+  struct ifcond  *wnext;    // timer wheel: next entry in the same wheel slot
+  struct ifcond **wpprev;   // timer wheel: address of the pointer to this entry (previous entry's /wnext/
+                            // or the slot head); NULL if the entry is not on the wheel
+  uint64_t wexpires;        // timer wheel: tick number when the entry expires
   uint32_t limit;           // max number of hits
                             // if (ifc->hits > ifc->limit) { ignore } else { process }
   uint32_t delay_ms;        // initial delay; used for "every" ifconds
@@ -110,8 +137,24 @@ struct ifcond {
   uint32_t drops;           // number of times alias execution was skipped
                             // (rate-limited or max-exec-limited)
   uint64_t tsta;            // timestamp, microseconds: time when the condition matched
+                            // (captured by the ISR or by the timer callback, not by the ifc_task())
   uint64_t tsta0;           // previous timestamp: time when the alias was last executed
                             // updated from tsta on each alias execution
+
+  uint32_t lat_min;         // Event-to-alias-start latency, microseconds: minimum,
+  uint32_t lat_max;         // maximum,
+  uint32_t lat_cnt;         // number of samples and
+  uint64_t lat_sum;         // their sum (to calculate an average)
+
+  uint32_t inl_fallbacks;   // "inline" entries: number of times alias was not inlineable and was executed
+                            // in a background task instead
+
+  uint8_t  recent_idx;      // where to write next entry in recent[]
+  struct ifc_snapshot recent[IFC_RECENT]; // most recent events which passed through ifc_task()
+
+  struct convar_cond var;   // variable condition, valid if has_var is set
+  uint8_t  var_was;         // previous result of the variable condition, for edge detection
+  uint16_t var_widx;        // index in the ifc_watches[] table, or IFC_NO_WATCH
 };
 
 
@@ -121,15 +164,57 @@ struct ifcond {
 // index where "every" command stores its rules
 #define EVERY_IDX (NO_TRIGGER + 1)
 
+// index where change-driven variable conditions are stored
+#define VAR_IDX (EVERY_IDX + 1)
+
+// size of the ifconds array: GPIOs + Polling + Every + Variables
+#define IFC_LISTS (VAR_IDX + 1)
+
 // special trigger_pin value to create temporary ifcond; only to be used as first arg of ifc_create() and only there.
-// it is not an index as NO_TRIGGER or EVERY_IDX are
+// it is not an index as NO_TRIGGER, EVERY_IDX or VAR_IDX are
 #define ONESHOT_IF 0xff
 
+// ifcond.var_widx value for entries which are not in the ifc_watches[] table
+#define IFC_NO_WATCH 0xffff
+
 // Ifconds array. Each element of the array is a list of ifconds.
 // For example, ifconds[5] contains all "if rising|falling 5" statements.
 // "No trigger" statements (i.e. those without rising or falling keywords)
 // are stored in ifconds[NO_TRIGGER].
-static struct ifcond *ifconds[NUM_PINS + 2] = { 0 };   // +1 for the NO_TRIGGER entry and +1 for "every" entries
+static struct ifcond *ifconds[IFC_LISTS] = { 0 };   // +1 for the NO_TRIGGER entry, +1 for "every" and +1 for variable entries
+
+// Compiled decision table: a read-only, ISR-friendly copy of the ifconds[pin] list.
+//
+// Walking a linked list of ifconds from the ISR means a pointer chase and 4-5 branches per rule.
+// Instead, the list is compiled into contiguous arrays (struct-of-arrays) where every rule is
+// reduced to a pair of (mask, value) words for each GPIO bank: "high" and "low" conditions are
+// merged, so the match test becomes ((IN ^ value) & mask) == 0, computed for both banks at once.
+//
+// Rules are sorted by edge type: "rising" entries come first, then "falling" ones, so
+// the ISR only scans the half which corresponds to the detected edge.
+//
+// Tables are rebuilt by ifc_compile_pin() whenever the ifconds[pin] list is modified, i.e. under
+// the writer lock and with the pin interrupt disabled. The ISR never sees a half-built table:
+// a new table is built aside and then published by a single pointer store.
+//
+struct ifc_ctable {
+  uint16_t  nrising;        // entries [0 .. nrising-1] are "rising", the rest are "falling"
+  uint16_t  count;          // total number of entries
+  uint32_t *mask;           // GPIO 0..31: bit X set => GPIO X is tested ("high" or "low" condition)
+  uint32_t *mask1;          // GPIO 32..63: ...
+  uint32_t *val;            // GPIO 0..31: expected pin values (only bits which are set in mask are meaningful)
+  uint32_t *val1;           // GPIO 32..63: ...
+  struct ifcond **ifc;      // ifcond which corresponds to the entry
+  uint32_t data[0];         // storage for all of the above
+};
+
+// Compiled tables, one per GPIO. NULL if there are no "if rising|falling" conditions for the pin
+static struct ifc_ctable *ifc_ctables[NUM_PINS] = { 0 };
+
+// Number of ifc_anyedge_interrupt() instances currently running for the pin (0 or 1).
+// Disabling the pin interrupt does not stop an ISR which is already running on the other core, so
+// a replaced table is freed only after this counter drops to zero (see ifc_compile_pin())
+static _Atomic unsigned int ifc_isr_active[NUM_PINS] = { 0 };
 
 // RWLock protecting the ifcond lists. The lists are modified only by the
 // "if/every" and "if/every delete" commands (the "writers").
@@ -156,6 +241,30 @@ static void ifc_task(void *arg);
 static mpipe_t ifc_mp = MPIPE_INIT;
 static unsigned int ifc_mp_drops = 0;
 
+// Events in flight.
+// Message pipe carries pointer-sized messages, while an event is an ifcond pointer *and* a snapshot.
+// So the event itself is placed in the ring below and only its sequence number is sent through the pipe.
+// ifc_task() uses the sequence number to find the event and to check that it was not overwritten
+// (this happens when events are generated faster than ifc_task() can process them; such events are
+// counted as ifc_mp_drops)
+//
+// Must be a power of 2, and larger than MPIPE_CAPACITY
+#define IFC_EVENTS_NUM (MPIPE_CAPACITY * 4)
+
+struct ifc_event {
+  _Atomic uint32_t    seq;  // sequence number or 0 while entry is being written
+  struct ifcond      *ifc;  // ifcond to execute
+  struct ifc_snapshot snap; // event timestamp and GPIO values
+};
+
+static struct ifc_event ifc_events[IFC_EVENTS_NUM] = { 0 };
+static _Atomic uint32_t ifc_events_seq = 1; // 0 is reserved: it marks entries which are being written
+
+// Event-to-alias-start latency distribution, for all ifconds. Bucket N counts latencies in the
+// range [2^N .. 2^(N+1)) microseconds, the last bucket also counts everything above
+#define IFC_LAT_BUCKETS 16
+static uint32_t ifc_lat_hist[IFC_LAT_BUCKETS] = { 0 };
+
 
 #define IFCOND_PRIORITY 22  // Run at esp_timer priority so that both esp_timer-driven
                            // events and interrupt-driven events run at the same
@@ -226,6 +335,147 @@ static uint64_t isr_enabled = 0;
 #define ifc_clear_isr_registered(_Gpio) \
   (isr_enabled &= ~(1ULL << (_Gpio)))
 
+// Same as ifc_isr_is_registered() but callable from modules included before this file
+// (e.g. count.h, which must not replace our ISR with its own)
+//
+static bool ifc_pin_has_isr(unsigned int pin) {
+  return pin < NUM_PINS && ifc_isr_is_registered(pin);
+}
+
+
+// Place an event into the ifc_events[] ring.
+// Returns a message to be sent to the ifc_task() via the ifc_mp message pipe.
+// Safe to call from an ISR (it is always inlined)
+//
+static INLINE void *ifc_event_prepare(struct ifcond *ifc, const struct ifc_snapshot *snap) {
+
+  uint32_t seq = atomic_fetch_add_explicit(&ifc_events_seq, 1, memory_order_relaxed);
+  struct ifc_event *e;
+
+  // Skip reserved sequence number (wraps once in a lifetime, but still)
+  if (unlikely(seq == 0))
+    seq = atomic_fetch_add_explicit(&ifc_events_seq, 1, memory_order_relaxed);
+
+  e = &ifc_events[seq & (IFC_EVENTS_NUM - 1)];
+
+  // Mark entry as "being written", write, publish
+  atomic_store_explicit(&e->seq, 0, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  e->ifc = ifc;
+  e->snap = *snap;
+  atomic_store_explicit(&e->seq, seq, memory_order_release);
+
+  return (void *)(uintptr_t)seq;
+}
+
+// Fetch an event by its sequence number (i.e. the message received from the ifc_mp pipe).
+// Returns a pointer to the ifcond and fills /snap/, or returns NULL if the event was overwritten
+//
+static struct ifcond *ifc_event_fetch(uint32_t seq, struct ifc_snapshot *snap) {
+
+  struct ifc_event *e = &ifc_events[seq & (IFC_EVENTS_NUM - 1)];
+  struct ifcond *ifc;
+
+  if (seq && atomic_load_explicit(&e->seq, memory_order_acquire) == seq) {
+    ifc = e->ifc;
+    *snap = e->snap;
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&e->seq, memory_order_relaxed) == seq)
+      return ifc;
+  }
+  return NULL;
+}
+
+// Called from alias_helper_task() when an alias which was triggered by an ifcond starts its execution.
+// Updates latency statistics: per-ifcond and the global histogram.
+// /tsta/ is the event timestamp
+//
+static void ifc_account_latency(struct ifcond *ifc, uint64_t tsta) {
+
+  uint64_t now = q_micros();
+  uint32_t lat, b;
+
+  if (unlikely(ifc == NULL || now < tsta))
+    return;
+
+  lat = (now - tsta > 0xffffffffULL) ? 0xffffffff : (uint32_t)(now - tsta);
+
+  if (!ifc->lat_cnt || lat < ifc->lat_min)
+    ifc->lat_min = lat;
+  if (lat > ifc->lat_max)
+    ifc->lat_max = lat;
+  ifc->lat_sum += lat;
+  ifc->lat_cnt++;
+
+  b = lat ? 31 - __builtin_clz(lat) : 0;
+  ifc_lat_hist[b < IFC_LAT_BUCKETS ? b : IFC_LAT_BUCKETS - 1]++;
+}
+
+// Replace the decision table of the /pin/ with /t/ (can be NULL). The pin interrupt is disabled, so no new
+// ISR instance can pick up the old table; wait for the one which may be running on the other core, then
+// free the old table. Must be called with the writer lock held
+//
+static void ifc_publish_table(uint8_t pin, struct ifc_ctable *t) {
+
+  struct ifc_ctable *old = ifc_ctables[pin];
+
+  ifc_ctables[pin] = t;
+  atomic_thread_fence(memory_order_seq_cst);
+
+  while (atomic_load(&ifc_isr_active[pin]))
+    q_yield();
+
+  if (old)
+    q_free(old);
+}
+
+// (Re)compile the ifconds[pin] list into a decision table (see struct ifc_ctable above).
+// Must be called with the writer lock held and with the /pin/ interrupt disabled.
+// Returns /false/ if out of memory: the old table is left in place
+//
+static bool ifc_compile_pin(uint8_t pin) {
+
+  struct ifcond *ifc;
+  struct ifc_ctable *t = NULL;
+  unsigned int count = 0, i, j;
+
+  MUST_NOT_HAPPEN(pin >= NUM_PINS);
+
+  for (ifc = ifconds[pin]; ifc; ifc = ifc->next)
+    count++;
+
+  if (count) {
+    // One allocation: header + 4 arrays of uint32_t + array of pointers
+    if ((t = (struct ifc_ctable *)q_malloc(sizeof(struct ifc_ctable) + count * (4 * sizeof(uint32_t) + sizeof(struct ifcond *)), MEM_IFCOND)) == NULL) {
+      VERBOSE(q_printf("%% ifc_compile_pin() : GPIO#%u, out of memory\r\n", pin));
+      return false;
+    }
+
+    t->count = count;
+    t->mask  = &t->data[0];
+    t->mask1 = &t->data[count];
+    t->val   = &t->data[count * 2];
+    t->val1  = &t->data[count * 3];
+    t->ifc   = (struct ifcond **)&t->data[count * 4];
+
+    // Two passes: "rising" entries first, then "falling". List order is preserved within each group
+    for (i = j = 0; j < 2; j++) {
+      for (ifc = ifconds[pin]; ifc; ifc = ifc->next)
+        if (ifc->trigger_rising == !j) {
+          t->mask[i]  = (ifc->has_high ? ifc->high : 0)  | (ifc->has_low ? ifc->low : 0);
+          t->mask1[i] = (ifc->has_high ? ifc->high1 : 0) | (ifc->has_low ? ifc->low1 : 0);
+          t->val[i]   = ifc->has_high ? ifc->high : 0;
+          t->val1[i]  = ifc->has_high ? ifc->high1 : 0;
+          t->ifc[i++] = ifc;
+        }
+      if (!j)
+        t->nrising = i;
+    }
+  }
+
+  ifc_publish_table(pin, t);
+  return true;
+}
 
 // GPIO interrupt routine, implemented using the GPIO ISR Service API.
 // ESP-IDF provides a global GPIO handler that calls user-defined routines.
@@ -242,11 +492,16 @@ static uint64_t isr_enabled = 0;
 //
 static void IRAM_ATTR ifc_anyedge_interrupt(void *arg) {
 
-  bool rising;
-  unsigned int pin = (unsigned int )arg;
+  unsigned int i, end, pin = (unsigned int )arg;
+  bool force_yield = false;
+  struct ifc_snapshot snap;
+  struct ifc_ctable *t;
 
-  // ifc points to the head of ifcond list associated with given pin
-  struct ifcond *ifc = ifconds[pin];
+  // Compiled rules for this pin (see ifc_compile_pin()). Read the pointer once: the table
+  // it points to is never modified, it can only be replaced by a new one. ifc_isr_active[] is
+  // raised before the read, so the writer does not free the table while we are using it
+  atomic_fetch_add(&ifc_isr_active[pin], 1);
+  t = ifc_ctables[pin];
 
 // Read pin values (all at once, via a direct register read).
 // We need them:
@@ -256,57 +511,50 @@ static void IRAM_ATTR ifc_anyedge_interrupt(void *arg) {
 //
   uint32_t in = REG_READ(GPIO_IN_REG);   // GPIO 0..31
   uint32_t in1 = REG_READ(GPIO_IN1_REG); // GPIO 32..63
-  
-  // Edge detect: if pin is HIGH, then it was "rising" event
-  rising = pin < 32 ? (in & (1UL << pin))
-                    : (in1 & (1UL << (pin - 32)));
 
+  if (unlikely(t == NULL))
+    goto done;
+
+  // Event snapshot: GPIO values and timestamps are sent to ifc_task() along with the ifcond pointer.
+  // Timestamping in the ISR excludes the queueing and scheduling latency from rate-limit calculations
+  snap.ccount = cpu_ticks();
+  snap.tsta = q_micros();
+  snap.in = in;
+  snap.in1 = in1;
+
+  // Edge detect: if pin is HIGH, then it was "rising" event.
+  // Select the part of the table which holds entries for this edge type
+  if (pin < 32 ? (in & (1UL << pin)) : (in1 & (1UL << (pin - 32)))) {
+    i = 0;
+    end = t->nrising;
+  } else {
+    i = t->nrising;
+    end = t->count;
+  }
 
-// Traverse the "if" clauses (all associated with this pin).
-// No locking is used here (although ideally an RWLock would be).
-// The ifcond list is modified only by the "if" shell command,
-// either when adding a new ifcond or deleting one (via "if delete").
-//
-// Instead of locking, GPIO interrupts are temporarily disabled
-// while the "if" command runs, preventing ifc_anyedge_interrupt()
-// from traversing a list that is being modified.
-//
-// The list is traversed from an ISR, so keep it short.
+// Evaluate the rules. No locking is used here: the table is replaced (never modified) by
+// the "if" command while GPIO interrupts are disabled for this pin.
+// Both GPIO banks are tested at once, with a single branch per rule. Expiration is
+// checked only for matched entries: it can not be compiled in because the "hits" counter
+// changes at runtime
 //
-// Gotos were added in an attempt to reduce execution time.
+  for (; i < end; i++)
+    if (unlikely((((in ^ t->val[i]) & t->mask[i]) | ((in1 ^ t->val1[i]) & t->mask1[i])) == 0)) {
 
-  bool force_yield = false;
+      struct ifcond *ifc = t->ifc[i];
 
-  while (ifc) {
-    // Do quick reject in the ISR, do not offload it to the ifc_task()
-    // Number of "if"s with the same trigger pin is what can slow things down
-    // 1. edge match?
-    if (ifc->trigger_rising == rising) {
-    // 2. entry is not expired?
+      // Full match: send the ifc pointer to ifc_task() and continue processing
+      // (there may be more matched ifconds). ifc_task() will drain the queue,
+      // fetching pointers and executing the associated aliases.
       if (ifc_not_expired(ifc)) {
-    // 3. "high" condition match?
-        if (ifc->has_high)
-          if ((ifc->high & in) != ifc->high  ||   // MASK & READ_VALUES == MASK?
-              (ifc->high1 &  in1) != ifc->high1)
-            goto next_ifc;
-            
-    // 4. "low" condition match?
-        if (ifc->has_low)
-          if ((ifc->low & ~in) != ifc->low  ||
-              (ifc->low1 &  ~in1) != ifc->low1)
-            goto next_ifc;
-
-    // 5. Full match: send the ifc pointer to ifc_task() and continue processing
-    //    (there may be more matched ifconds). ifc_task() will drain the queue,
-    //    fetching pointers and executing the associated aliases.
-    
-        force_yield |= mpipe_send_from_isr(ifc_mp, ifc);
-      } else // if expired
+        void *msg = ifc_event_prepare(ifc, &snap);
+        force_yield |= mpipe_send_from_isr(ifc_mp, msg);
+      } else
         ifc->drops++;
-    } // edge match?
-next_ifc:
-    ifc = ifc->next;
-  }
+    }
+
+done:
+  atomic_fetch_sub(&ifc_isr_active[pin], 1);
 
   // mpipe_send() has unblocked a higher priority task: request rescheduling.
   if (force_yield)
@@ -320,12 +568,8 @@ next_ifc:
 static void ifc_disable_periodic_timers() {}
 static void ifc_enable_periodic_timers() {}
 
-// Allocate timer for polled events (if ... poll and every ...poll)
-//
-static void ifc_claim_timer(struct ifcond *ifc, bool delayed_already);
-
-// Timer callback for polled entries (e.g. "if low 5 poll ..." or "every ...").
-// Called periodically by the esp_timer system task.
+// Callback for polled entries (e.g. "if low 5 poll ..." or "every ...").
+// Called periodically by the timer wheel (see ifc_wheel_tick()), from the esp_timer system task.
 // This is analogous to the ifc_anyedge_interrupt() handler, but used for polling.
 //
 // Reminder: this code relies on pointer persistence. This means that deleting
@@ -333,15 +577,16 @@ static void ifc_claim_timer(struct ifcond *ifc, bool delayed_already);
 // to it remains valid. Access to its ->exec (a pointer to an alias) is also safe,
 // since alias pointers are persistent as well.
 //
-// However, by the time this callback runs, the user may have already deleted
-// the ifcond. Deleting an ifcond also removes its timer, but if the timer still
-// manages to fire, it will execute that "deleted" condition. This is undesirable,
-// but still preferable to a memory access violation.
+// Deleting an ifcond removes it from the timer wheel under the wheel mutex, so the
+// wheel never calls this function for a deleted entry. The only other caller is the
+// "one-shot" if, which calls it directly.
 //
 static void ifc_callback(void *arg) {
 
   uint32_t in, in1;
   struct ifcond *ifc;
+  struct ifc_snapshot snap;
+  void *msg;
   
   MUST_NOT_HAPPEN(arg == NULL);
 
@@ -356,6 +601,10 @@ static void ifc_callback(void *arg) {
 
   // 1. entry is not expired/disabled? 
   if (ifc_not_expired(ifc)) {
+  // 1a. variable condition match?
+    if (ifc->has_var && !convar_cond_test(&ifc->var))
+      return ;
+
   // 2. "high" condition match?
     if (ifc->has_high)
       if ((ifc->high & in) != ifc->high  ||   // MASK & READ_VALUES == MASK?
@@ -369,99 +618,432 @@ static void ifc_callback(void *arg) {
         return ;
 
   // 4. Send to the ifc_task() for execution
-    if (mpipe_send(ifc_mp, ifc))
+    snap.ccount = cpu_ticks();
+    snap.tsta = q_micros();
+    snap.in = in;
+    snap.in1 = in1;
+    msg = ifc_event_prepare(ifc, &snap);
+    if (mpipe_send(ifc_mp, msg))
       return ;
   }
 
   ifc->drops++;
 }
 
-// When an entry has the "delay" keyword, its first execution is postponed - hence the name.
-//
-static void ifc_callback_delayed(void *arg) {
-  struct ifcond *ifc = (struct ifcond *)arg;
-  if (ifc) {
+// -- Timer wheel --
+//
+// All periodic ifconds ("every ..." and "if ... poll ...") are driven by a single one-shot esp_timer
+// instead of having one esp_timer per ifcond: with many periodic rules the latter loads the esp_timer
+// task and its sorted timer list. Wheel resolution is IFC_WHEEL_TICK_MS milliseconds.
+//
+// This is a hierarchical timing wheel (as in classic BSD/Linux kernels): IFC_WHEEL_LEVELS levels
+// of IFC_WHEEL_SIZE slots each. Level 0 slots are 1 tick apart, level 1 slots are IFC_WHEEL_SIZE ticks
+// apart and so on. Entries which expire far in the future are placed on upper levels and are moved
+// ("cascaded") to lower levels as the time goes. Insertion and removal are O(1); each slot is a
+// doubly-linked list built into struct ifcond itself.
+//
+// The timer is not periodic: it is re-armed to the next tick which has work to do (see ifc_wheel_next()),
+// so a wheel with "every 10 seconds" rules wakes the CPU once in 10 seconds, not every tick. It is stopped
+// when the wheel becomes empty. Tick numbers are derived from q_micros(), so missed ticks (esp_timer task
+// was busy) are caught up.
+//
+// Delayed ("delay" keyword) entries need no special handling: their first expiration time is
+// "now + delay" instead of "now".
+//
+#define IFC_WHEEL_TICK_MS 1                          // Wheel resolution, milliseconds
+#define IFC_WHEEL_BITS    6
+#define IFC_WHEEL_SIZE    (1 << IFC_WHEEL_BITS)      // Slots per level
+#define IFC_WHEEL_MASK    (IFC_WHEEL_SIZE - 1)
+#define IFC_WHEEL_LEVELS  6                          // 64^6 ticks: ~795 days at 1ms tick, enough for 49 days poll_interval
+#define IFC_WHEEL_MAX_SLEEP (3600 * 1000ULL / IFC_WHEEL_TICK_MS) // Longest timer delay, ticks (1 hour)
+
+static struct ifcond *ifc_wheel[IFC_WHEEL_LEVELS][IFC_WHEEL_SIZE] = { 0 };
+static uint64_t       ifc_wheel_now = 0;             // Next tick to be processed
+static uint64_t       ifc_wheel_t0 = 0;              // q_micros() value which corresponds to tick #0
+static unsigned int   ifc_wheel_count = 0;           // Number of entries on the wheel
+static mutex_t        ifc_wheel_mux = MUTEX_INIT;    // Protects everything above
+static timer_t        ifc_wheel_timer = TIMER_INIT;  // The tick source
+
+// Dispatch jitter statistics: how late (microseconds) were entries dispatched relative to their schedule
+static struct {
+  uint32_t min, max, cnt;
+  uint64_t sum;
+} ifc_wheel_jitter = { 0 };
+
+// Current tick number
+#define ifc_wheel_current() \
+  ((uint64_t)(q_micros() - ifc_wheel_t0) / (IFC_WHEEL_TICK_MS * 1000ULL))
+
+// Milliseconds to ticks, rounded up, at least 1 tick
+#define ifc_wheel_ms2ticks(_Ms) \
+  ((_Ms) > IFC_WHEEL_TICK_MS ? ((uint64_t)(_Ms) + IFC_WHEEL_TICK_MS - 1) / IFC_WHEEL_TICK_MS : 1)
+
+// Link an entry into the wheel slot according to its ->wexpires. Wheel mutex must be held
+//
+static void ifc_wheel_link(struct ifcond *ifc) {
+
+  uint64_t expires = ifc->wexpires;
+  uint64_t delta = expires - ifc_wheel_now;
+  struct ifcond **slot;
+  unsigned int level;
+
+  if ((int64_t)delta < 0)
+    // Already expired: process on the next tick
+    slot = &ifc_wheel[0][ifc_wheel_now & IFC_WHEEL_MASK];
+  else {
+    // Find the level: level N holds entries which expire in less than IFC_WHEEL_SIZE^(N+1) ticks.
+    for (level = 0; level < IFC_WHEEL_LEVELS - 1; level++)
+      if (delta < (1ULL << (IFC_WHEEL_BITS * (level + 1))))
+        break;
+    // Too far in the future even for the last level: clamp
+    if (delta >= (1ULL << (IFC_WHEEL_BITS * IFC_WHEEL_LEVELS)))
+      expires = ifc_wheel_now + (1ULL << (IFC_WHEEL_BITS * IFC_WHEEL_LEVELS)) - 1;
 
-    if (!ifc->alive) // TODO: not gonna work on multicore CPU
-      return ;
+    slot = &ifc_wheel[level][(expires >> (IFC_WHEEL_BITS * level)) & IFC_WHEEL_MASK];
+  }
 
-    // delay time has passed: execute alias and schedule periodic timer. remove old timer
-    if (!ifc->disabled)
-      ifc_callback(arg);
-    else
-      ifc->drops++;
+  // Insert at the head of the slot list
+  if ((ifc->wnext = *slot) != NULL)
+    ifc->wnext->wpprev = &ifc->wnext;
+  ifc->wpprev = slot;
+  *slot = ifc;
+}
+
+// Remove an entry from its slot. Wheel mutex must be held
+//
+static void ifc_wheel_unlink(struct ifcond *ifc) {
+  if (ifc->wpprev) {
+    if ((*ifc->wpprev = ifc->wnext) != NULL)
+      ifc->wnext->wpprev = ifc->wpprev;
+    ifc->wnext = NULL;
+    ifc->wpprev = NULL;
+  }
+}
+
+// Move all entries from the slot /idx/ of level /level/ to lower levels.
+// Returns /idx/, so the caller knows if the next level must be cascaded too
+//
+static unsigned int ifc_wheel_cascade(unsigned int level, unsigned int idx) {
 
-    // Stop one-shot timer and schedule new, periodic timer
-    esp_timer_stop(ifc->timer);
-    esp_timer_delete(ifc->timer);
-    ifc->timer = TIMER_INIT;
+  struct ifcond *ifc = ifc_wheel[level][idx], *next;
 
-    // Claim the timer again, with the 'true' flag indicating that the delay
-    // has already been applied.
-    ifc_claim_timer(ifc, true);
+  ifc_wheel[level][idx] = NULL;
+  while (ifc) {
+    next = ifc->wnext;
+    ifc->wpprev = NULL;
+    ifc_wheel_link(ifc);
+    ifc = next;
   }
+  return idx;
+}
+
+// Account dispatch jitter: /ifc/ was scheduled to run at tick ifc->wexpires
+//
+static void ifc_wheel_account_jitter(struct ifcond *ifc) {
+
+  int64_t late = (int64_t)(q_micros() - ifc_wheel_t0) - (int64_t)(ifc->wexpires * IFC_WHEEL_TICK_MS * 1000ULL);
+  uint32_t j = late < 0 ? 0 : (late > 0xffffffffLL ? 0xffffffff : (uint32_t)late);
+
+  if (!ifc_wheel_jitter.cnt || j < ifc_wheel_jitter.min)
+    ifc_wheel_jitter.min = j;
+  if (j > ifc_wheel_jitter.max)
+    ifc_wheel_jitter.max = j;
+  ifc_wheel_jitter.sum += j;
+  ifc_wheel_jitter.cnt++;
 }
 
-// Allocate a timer for polled events, either periodic or one-shot.
-// The mode depends on ifc.has_delay:
-// if the ifcond specifies the "delay" option, the timer is set up in two steps:
+// Tick number of the next wheel event at or after ifc_wheel_now: either a non-empty level 0 slot, or
+// a cascade of a non-empty upper level slot. Level N slots are cascaded on ticks which are multiples of
+// IFC_WHEEL_SIZE^N, so for every level only its next IFC_WHEEL_SIZE cascade points are checked.
+// Returns UINT64_MAX if the wheel is empty. Wheel mutex must be held
 //
-//   1. Start a one-shot timer with a duration of ifc.delay_ms.
-//   2. When it expires, schedule a periodic timer.
+static uint64_t ifc_wheel_next() {
+
+  uint64_t next = UINT64_MAX, t;
+  unsigned int level, shift, j;
+
+  for (level = 0; level < IFC_WHEEL_LEVELS; level++) {
+    shift = IFC_WHEEL_BITS * level;
+    t = ((ifc_wheel_now + (1ULL << shift) - 1) >> shift) << shift;
+    for (j = 0; j < IFC_WHEEL_SIZE && t < next; j++, t += 1ULL << shift)
+      if (ifc_wheel[level][(t >> shift) & IFC_WHEEL_MASK]) {
+        next = t;
+        break;
+      }
+  }
+  return next;
+}
+
+// Arm the timer to fire on the next wheel event. Wheel mutex must be held, wheel must not be empty
 //
-// This function may also be called from the one-shot timer itself to set up
-// the periodic events. That is the purpose of the second argument:
-//   - Normally, it should be set to 'false'.
-//   - It is set to 'true' only when invoked from the one-shot timer callback.
+static void ifc_wheel_arm() {
+
+  uint64_t next = ifc_wheel_next(), at, now;
+
+  if (next - ifc_wheel_now > IFC_WHEEL_MAX_SLEEP)
+    next = ifc_wheel_now + IFC_WHEEL_MAX_SLEEP;
+
+  at = ifc_wheel_t0 + next * IFC_WHEEL_TICK_MS * 1000ULL;
+  now = q_micros();
+
+  esp_timer_stop(ifc_wheel_timer);
+  esp_timer_start_once(ifc_wheel_timer, at > now ? at - now : 1);
+}
+
+// Wheel tick: esp_timer callback. Processes all ticks up to the current one and re-arms the timer
 //
-static void ifc_claim_timer(struct ifcond *ifc, bool delayed_already) {
+static void ifc_wheel_tick(UNUSED void *arg) {
 
-  timer_t handle = TIMER_INIT;
+  uint64_t now, next;
+  unsigned int idx, level;
+
+  mutex_lock(ifc_wheel_mux);
+
+  now = ifc_wheel_current();
+
+  // Ticks between ifc_wheel_now and the next event have nothing to do: skip them
+  if ((next = ifc_wheel_next()) > ifc_wheel_now)
+    ifc_wheel_now = next < now ? next : now + 1;
+
+  while (ifc_wheel_now <= now && ifc_wheel_count) {
+
+    idx = ifc_wheel_now & IFC_WHEEL_MASK;
+
+    // Level 0 has completed a full turn: bring entries from upper levels
+    if (!idx)
+      for (level = 1; level < IFC_WHEEL_LEVELS; level++)
+        if (ifc_wheel_cascade(level, (ifc_wheel_now >> (IFC_WHEEL_BITS * level)) & IFC_WHEEL_MASK))
+          break;
+
+    // Detach the slot list: entries are relinked below, possibly into the same slot
+    struct ifcond *ifc = ifc_wheel[0][idx], *next;
+    ifc_wheel[0][idx] = NULL;
+    ifc_wheel_now++;
+
+    while (ifc) {
+      next = ifc->wnext;
+      ifc->wpprev = NULL;
+
+      ifc_wheel_account_jitter(ifc);
+      ifc_callback(ifc);
+
+      // Schedule next run. If we are late for more than one period (esp_timer task was busy),
+      // skip missed periods instead of executing them in a burst
+      ifc->wexpires += ifc_wheel_ms2ticks(ifc->poll_interval);
+      if (ifc->wexpires < ifc_wheel_now)
+        ifc->wexpires = ifc_wheel_now;
+      ifc_wheel_link(ifc);
+
+      ifc = next;
+    }
+  }
+
+  // Empty wheel: nothing to do, the timer is not re-armed. Restarted by ifc_claim_timer()
+  if (ifc_wheel_count)
+    ifc_wheel_arm();
+  else
+    ifc_wheel_now = now + 1;
+
+  mutex_unlock(ifc_wheel_mux);
+}
+
+// Put a periodic ifcond on the timer wheel.
+// The first execution is either immediate or, if the ifcond has the "delay" keyword, after ifc.delay_ms.
+//
+static void ifc_claim_timer(struct ifcond *ifc) {
 
   MUST_NOT_HAPPEN(ifc == NULL);
   MUST_NOT_HAPPEN(ifc->exec == NULL);
 
-  // Default timer callback is ifc_callback
-  esp_timer_create_args_t timer_args = {
-      .callback = &ifc_callback,
+  mutex_lock(ifc_wheel_mux);
+
+  // Create the tick source on first use
+  if (ifc_wheel_timer == TIMER_INIT) {
+    esp_timer_create_args_t timer_args = {
+      .callback = &ifc_wheel_tick,
       .dispatch_method = ESP_TIMER_TASK,
-      .arg = ifc,
-      .name = ifc->exec->name,
-  };
-
-  // 2 stage-setup for delayed events:
-  // First callback to be called is ifc_callback_delayed(), which reclaims timer again, and sets up periodic timer
-  if (ifc->has_delay && !delayed_already)
-    timer_args.callback = &ifc_callback_delayed;
-#ifdef ESP_TIMER_ISR  
-    // Experimental: no delay / or delayed already: we can use "interrupt" dispatch method here because all we do in our
-    // callback is sending an ifcond to the execution task.
-  else
-    timer_args.dispatch_method = ESP_TIMER_ISR;
-#endif
-
-  if (ESP_OK == esp_timer_create(&timer_args, &handle)) {
-    ifc->timer = handle;
-    if (ifc->has_delay && !delayed_already)
-      esp_timer_start_once(handle, 1000ULL * ifc->delay_ms);
-    else {
-      // First executions is right now, subsequent - after a delay
-      if (!delayed_already)
-        ifc_callback(ifc);
-      esp_timer_start_periodic(handle, 1000ULL * ifc->poll_interval);
+      .arg = NULL,
+      .name = "ifc_wheel",
+    };
+    if (ESP_OK != esp_timer_create(&timer_args, &ifc_wheel_timer)) {
+      ifc_wheel_timer = TIMER_INIT;
+      mutex_unlock(ifc_wheel_mux);
+      VERBOSE(q_print("% Failed to create timer\r\n"));
+      return;
     }
-  } else {
-    VERBOSE(q_print("% Failed to create timer\r\n"));
+    ifc_wheel_t0 = q_micros();
+    ifc_wheel_now = 0;
+  }
+
+  // Wheel was idle: fast-forward to the current tick
+  if (!ifc_wheel_count)
+    ifc_wheel_now = ifc_wheel_current();
+
+  if (ifc->has_delay)
+    ifc->wexpires = ifc_wheel_now + ifc_wheel_ms2ticks(ifc->delay_ms);
+  else {
+    // First execution is right now, subsequent - after the poll interval
+    ifc_callback(ifc);
+    ifc->wexpires = ifc_wheel_now + ifc_wheel_ms2ticks(ifc->poll_interval);
   }
+  ifc_wheel_link(ifc);
+  ifc_wheel_count++;
+
+  // New entry may be due earlier than the event the timer is armed for
+  ifc_wheel_arm();
+
+  mutex_unlock(ifc_wheel_mux);
 }
 
-// Release timer, delete callbacks
+// Remove an ifcond from the timer wheel
 //
 static void ifc_release_timer(struct ifcond *ifc) {
-  if (likely(ifc != NULL && ifc->timer != NULL)) {
-    esp_timer_stop(ifc->timer);
-    esp_timer_delete(ifc->timer);
-    ifc->timer = TIMER_INIT;
+  if (likely(ifc != NULL && ifc->wpprev != NULL)) {
+    mutex_lock(ifc_wheel_mux);
+    if (ifc->wpprev) {
+      ifc_wheel_unlink(ifc);
+      if (--ifc_wheel_count == 0)
+        esp_timer_stop(ifc_wheel_timer);
+    }
+    mutex_unlock(ifc_wheel_mux);
+  }
+}
+
+// -- Variable change detector --
+//
+// Change-driven variable conditions (ifconds[VAR_IDX]) do not use a timer per rule. Instead, all
+// variables referenced by these conditions are collected into the ifc_watches[] table (one entry per
+// variable, no matter how many conditions use it), and a single esp_timer compares them against their
+// shadow copies every IFC_VARS_SCAN_MS milliseconds. Only conditions bound to variables which have
+// changed are evaluated, so the cost of an idle scan is one compare per watched variable.
+//
+// "changed" conditions fire on every change; comparisons ("eq", "gt", ...) fire when the comparison
+// becomes true (i.e. on a false -> true transition), not while it stays true.
+//
+// The table is rebuilt by ifc_vars_compile() under the writer lock whenever the ifconds[VAR_IDX]
+// list is modified; the scanner holds the reader lock.
+//
+#define IFC_VARS_SCAN_MS 10
+
+struct ifc_watch {
+  void       *ptr;          // variable address
+  uint8_t     size;         // variable size
+  uint8_t     changed;      // set by the scanner if the variable has changed since the previous scan
+  composite_t shadow;       // last seen value
+};
+
+static struct ifc_watch *ifc_watches = NULL;       // Watched variables
+static unsigned int      ifc_watches_num = 0;      // Number of entries in ifc_watches[]
+static timer_t           ifc_vars_timer = TIMER_INIT;
+static bool              ifc_vars_running = false; // Is ifc_vars_timer running?
+
+// Scanner: esp_timer callback. Batch diff of all watched variables, then evaluation of
+// conditions on changed variables only
+//
+static void ifc_vars_scan(UNUSED void *arg) {
+
+  struct ifcond *ifc;
+  struct ifc_watch *w;
+  composite_t now;
+  bool any = false, res;
+  unsigned int i;
+
+  rw_lockr(&ifc_rw);
+
+  for (i = 0; i < ifc_watches_num; i++) {
+    w = &ifc_watches[i];
+    now.ullval = 0;
+    memcpy(&now, w->ptr, w->size);
+    if ((w->changed = (now.ullval != w->shadow.ullval)) != 0) {
+      w->shadow = now;
+      any = true;
+    }
+  }
+
+  if (any)
+    for (ifc = ifconds[VAR_IDX]; ifc; ifc = ifc->next)
+      if (ifc->var_widx < ifc_watches_num && ifc_watches[ifc->var_widx].changed) {
+        res = convar_cond_test(&ifc->var);
+        if (res && (ifc->var.op == CONVAR_OP_CHANGED || !ifc->var_was))
+          ifc_callback(ifc);
+        ifc->var_was = res;
+      }
+
+  rw_unlockr(&ifc_rw);
+}
+
+// (Re)build the ifc_watches[] table from the ifconds[VAR_IDX] list. Starts the scanner when the
+// first change-driven condition is added and stops it when the last one is removed.
+// Must be called with the writer lock held
+//
+static void ifc_vars_compile() {
+
+  struct ifcond *ifc;
+  struct ifc_watch *w = NULL;
+  unsigned int count = 0, i, j, k;
+
+  for (ifc = ifconds[VAR_IDX]; ifc; ifc = ifc->next)
+    count++;
+
+  if (count && (w = (struct ifc_watch *)q_malloc(count * sizeof(struct ifc_watch), MEM_IFCOND)) == NULL) {
+    // Keep using the old table: conditions which are not in it are not evaluated
+    VERBOSE(q_print("% ifc_vars_compile() : out of memory\r\n"));
+    return;
+  }
+
+  for (i = 0, ifc = ifconds[VAR_IDX]; ifc; ifc = ifc->next) {
+
+    // Already watched by another condition?
+    for (j = 0; j < i; j++)
+      if (w[j].ptr == ifc->var.ptr && w[j].size == ifc->var.size)
+        break;
+
+    if (j == i) {
+      w[i].ptr = ifc->var.ptr;
+      w[i].size = ifc->var.size;
+      w[i].changed = 0;
+      w[i].shadow.uval = 0;
+
+      // Variables which were watched before keep their shadow copies: otherwise a change
+      // which happened right before the rebuild would be lost
+      for (k = 0; k < ifc_watches_num; k++)
+        if (ifc_watches[k].ptr == w[i].ptr && ifc_watches[k].size == w[i].size) {
+          w[i].shadow = ifc_watches[k].shadow;
+          break;
+        }
+      if (k == ifc_watches_num)
+        memcpy(&w[i].shadow, w[i].ptr, w[i].size);
+      i++;
+    }
+    ifc->var_widx = j;
+  }
+
+  if (ifc_watches)
+    q_free(ifc_watches);
+  ifc_watches = w;
+  ifc_watches_num = i;
+
+  // Create the scanner timer on first use
+  if (count && ifc_vars_timer == TIMER_INIT) {
+    esp_timer_create_args_t timer_args = {
+      .callback = &ifc_vars_scan,
+      .dispatch_method = ESP_TIMER_TASK,
+      .arg = NULL,
+      .name = "ifc_vars",
+    };
+    if (ESP_OK != esp_timer_create(&timer_args, &ifc_vars_timer)) {
+      ifc_vars_timer = TIMER_INIT;
+      VERBOSE(q_print("% Failed to create timer\r\n"));
+      return;
+    }
+  }
+
+  if (count && !ifc_vars_running) {
+    esp_timer_start_periodic(ifc_vars_timer, IFC_VARS_SCAN_MS * 1000ULL);
+    ifc_vars_running = true;
+  } else if (!count && ifc_vars_running) {
+    esp_timer_stop(ifc_vars_timer);
+    ifc_vars_running = false;
   }
 }
 
@@ -536,11 +1118,16 @@ static void ifc_show(struct ifcond *ifc) {
 
     if (ifc->trigger_pin == EVERY_IDX)
       q_print("every ");
-    else if (ifc->trigger_pin != NO_TRIGGER)
+    else if (ifc->trigger_pin < NO_TRIGGER)
       q_printf("if %s %u ", ifc->trigger_rising ? "rising" : "fall", ifc->trigger_pin);
     else
       q_print("if ");
 
+    if (ifc->has_var) {
+      char buf[CONVAR_NAMELEN_MAX + 32];
+      q_printf("%s ", convar_cond_sprint(&ifc->var, buf, sizeof(buf)));
+    }
+
     if (ifc->has_high)
       for (i = 0; i <32; i++) {
         if (ifc->high & (1UL << i))  q_printf("hi %u ",i);
@@ -582,6 +1169,9 @@ static void ifc_show(struct ifcond *ifc) {
     if (ifc->has_rlimit)
       q_printf("rate %u ",ifc->rlimit);
 
+    if (ifc->is_inline)
+      q_print("inline ");
+
     // Use quotes: aliases could have spaces in their names and we want to generate
     // "executable" output, which can be simply copy/pasted to the espshell prompt again
     if (ifc->exec)
@@ -602,7 +1192,7 @@ static void ifc_show_single(unsigned int num) {
   int i,j;
 
   rw_lockr(&ifc_rw);
-  for (i = j = 0; i < NUM_PINS + 2; i++) { // NUM_PINS+2 is the size of ifconds array: GPIOs+Polling+Every events
+  for (i = j = 0; i < IFC_LISTS; i++) { // IFC_LISTS is the size of ifconds array: GPIOs+Polling+Every+Variable events
     struct ifcond *ifc = ifconds[i];
     while (ifc) {
       if (ifc->id == num) {
@@ -641,6 +1231,36 @@ static void ifc_show_single(unsigned int num) {
         if (ifc->has_delay)
           q_printf("%% Initial (first exec) delay: %lu milliseconds\r\n", ifc->delay_ms);
 
+        if (ifc->has_var) {
+          char buf[CONVAR_NAMELEN_MAX + 32];
+          q_printf("%% Variable condition: <i>%s</> (%s)\r\n", convar_cond_sprint(&ifc->var, buf, sizeof(buf)),
+                   ifc->trigger_pin == VAR_IDX ? "checked on change" : "polled");
+        }
+
+        if (ifc->lat_cnt)
+          q_printf("%% Event-to-alias latency: min <i>%lu</> us, avg <i>%lu</> us, max <i>%lu</> us (%lu samples)\r\n",
+                   ifc->lat_min, (uint32_t)(ifc->lat_sum / ifc->lat_cnt), ifc->lat_max, ifc->lat_cnt);
+
+        // Recent events, newest first. Cycle counts are deltas between subsequent events and are only
+        // meaningful for "if rising|falling": GPIO interrupts for a pin are always handled by the same CPU core
+        if (ifc->recent[(ifc->recent_idx + IFC_RECENT - 1) % IFC_RECENT].tsta) {
+          uint64_t now = q_micros();
+          q_print("% Recent events (newest first):\r\n"
+                  "%<r> # |  Time ago, us  | Cycles since prev | GPIO 0..31 | GPIO 32..63 </>\r\n");
+          for (j = 1; j <= IFC_RECENT; j++) {
+            struct ifc_snapshot *e = &ifc->recent[(ifc->recent_idx + IFC_RECENT - j) % IFC_RECENT];
+            struct ifc_snapshot *p = &ifc->recent[(ifc->recent_idx + IFC_RECENT - j - 1) % IFC_RECENT];
+            if (!e->tsta)
+              break;
+            q_printf("%%%2u | %14llu | ", j, now - e->tsta);
+            if (j < IFC_RECENT && p->tsta)
+              q_printf("%17lu | ", e->ccount - p->ccount);
+            else
+              q_print("                - | ");
+            q_printf(" 0x%08lx |  0x%08lx\r\n", e->in, e->in1);
+          }
+        }
+
         // ifconds are created with non-null alias pointer even alias was not existing: ifc_create() creates
         // alias if it does not exist. Alias pointers are persistent (always valid, even for a deleted alias)
         MUST_NOT_HAPPEN(ifc->exec == NULL);
@@ -649,7 +1269,10 @@ static void ifc_show_single(unsigned int num) {
         if (ifc->exec->lines == NULL)
           q_printf("%% Note that alias <i>\"%s\" is empty!</> (\"alias %s\" to edit)\r\n", ifc->exec->name, ifc->exec->name);
         else
-          q_printf("%% Action: <i>Execute alias \"%s\"</>\r\n", ifc->exec->name);
+          q_printf("%% Action: <i>Execute alias \"%s\"</>%s\r\n", ifc->exec->name, ifc->is_inline ? ", inline" : "");
+
+        if (ifc->inl_fallbacks)
+          q_printf("%% Alias was not inlineable and was executed in a background task: <i>%lu</> times\r\n", ifc->inl_fallbacks);
         rw_unlockr(&ifc_rw);
         return ;
       }
@@ -715,7 +1338,7 @@ static void ifc_show_all() {
            "%%---+-------+------+------+----------------------------------------------------\r\n");
 
   rw_lockr(&ifc_rw);
-  for (i = j = 0; i < NUM_PINS + 2; i++) {
+  for (i = j = 0; i < IFC_LISTS; i++) {
     struct ifcond *ifc = ifconds[i];
     while (ifc) {
       j++;
@@ -760,6 +1383,16 @@ static void ifc_show_all() {
 
 #define MULTIPLE_IFCONDS ((num <= 0) || all) // have to process multiple ifconds or just one?
 
+// Reset latency statistics and recent events
+#define ifc_clear_stats(_Ifc) \
+  { \
+    _Ifc->lat_min = _Ifc->lat_max = _Ifc->lat_cnt = 0; \
+    _Ifc->lat_sum = 0; \
+    _Ifc->inl_fallbacks = 0; \
+    _Ifc->recent_idx = 0; \
+    memset(_Ifc->recent, 0, sizeof(_Ifc->recent)); \
+  }
+
 
 static struct mb_pool ifc_pool = MB_POOL(sizeof(struct ifcond),0);
 
@@ -776,9 +1409,12 @@ static struct ifcond *ifc_get() {
 
   if (NULL != (ret = mb_get(&ifc_pool))) {
     ret->exec = NULL;
-    ret->timer = TIMER_INIT;
+    ret->wnext = NULL;
+    ret->wpprev = NULL;
     ret->alive = 1;
     ret->disabled = 0;
+    ret->has_var = 0;
+    ret->var.name = NULL;
     ret->id = atomic_fetch_add_explicit(&id, 1, memory_order_relaxed); // wrap is allowed
   }
   return ret;
@@ -789,8 +1425,8 @@ static struct ifcond *ifc_get() {
 static void ifc_put(struct ifcond *ifc) {
   if (likely(ifc)) {
 
-    if (unlikely(ifc->timer != NULL))
-      VERBOSE(q_printf("ifc_put() : ifcond.id=%u has an active timer still counting\r\n",ifc->id));
+    if (unlikely(ifc->wpprev != NULL))
+      VERBOSE(q_printf("ifc_put() : ifcond.id=%u is still on the timer wheel\r\n",ifc->id));
 
     if (unlikely(ifc->alive == 0))
       VERBOSE(q_printf("ifc_put() : ifcond.id=%u is dead\r\n",ifc->id));
@@ -800,6 +1436,11 @@ static void ifc_put(struct ifcond *ifc) {
     ifc->alive = 0;
     ifc->disabled = 1;
 
+    if (ifc->var.name) {
+      q_free(ifc->var.name);
+      ifc->var.name = NULL;
+    }
+
     mb_put(&ifc_pool, ifc);
   }
 }
@@ -814,9 +1455,9 @@ static void ifc_put(struct ifcond *ifc) {
 //
 static void ifc_delete0(int num, bool all) {
 
-  int i, max_entry = EVERY_IDX; // by default we run through /if/ and /every/ entries
+  int i, max_entry = VAR_IDX; // by default we run through /if/, /every/ and variable entries
 
-  MUST_NOT_HAPPEN(!all && num <= -(NUM_PINS + 2));
+  MUST_NOT_HAPPEN(!all && num <= -IFC_LISTS);
 
   // If we are about to modify one of the ifconds[] lists, acquire writers lock
   rw_lockw(&ifc_rw);
@@ -830,13 +1471,14 @@ static void ifc_delete0(int num, bool all) {
   // If /all/ is /true/, then value of /num/ is ignored, all entries are 
   // removed, except /every/ entries
   //
-  if (all) {
+  if (all)
     num = 0;
-    max_entry = NO_TRIGGER;
-  }
 
   for (i = num < 0 ? -num : 0; i <= max_entry; i++) {
 
+    if (all && i == EVERY_IDX)
+      continue;
+
     // if there are ifconds associated with the pin, we disable GPIO interrupts on this particular GPIO
     // to prevent ifc_anyedge_interrupt() from traversing ifconds lists
     if (ifconds[i]) {
@@ -844,53 +1486,36 @@ static void ifc_delete0(int num, bool all) {
       // 0..NUM_PINS-1 => GPIOs ("if rising|falling" conditions) 
       // NUM_PINS == NO_TRIGGER => "if poll" conditions
       // NUM_PINS+1 == EVERY_IDX => "every" conditions
+      // NUM_PINS+2 == VAR_IDX => change-driven variable conditions
       if (i < NO_TRIGGER)
         gpio_intr_disable(i);
       else
         ifc_disable_periodic_timers();
       
 
-      struct ifcond *ifc = ifconds[i], *prev = NULL;
+      struct ifcond *ifc = ifconds[i], *prev = NULL, *dead = NULL;
+      bool done = false;
 
       while (ifc) {
         // Found an item user wishes to delete
         // If num < 0, then we got a match, because we are traversing list which belongs to the pin -num
         // If num == ID, then we got a match for this particular ID. Once it processed - job is done
         if (MULTIPLE_IFCONDS || ifc->id == num) {
-            // Unlink /ifc/ from the list and q_free() it
-           
+            // Unlink /ifc/ from the list and move it to the /dead/ list. Unlinked entries are not
+            // recycled until the decision table is rebuilt: the ISR may still be using them
             struct ifcond *tmp = ifc;
             if (!prev)
               ifc = ifconds[i] = ifc->next;
             else
               ifc = prev->next = ifc->next;
 
-            // Interrupt must be released AFTER ifc is unlinked from the list:
-            // ifc_release_interrupt() checks if list is empty and if it is - uninstalls the ISR
-            // Real GPIO: attempt to elease interrupt
-            // Timed events: release the rimer
-            if (tmp->trigger_pin < NO_TRIGGER)
-              ifc_release_interrupt(tmp->trigger_pin);
-            else
-              ifc_release_timer(tmp);
-            
-
-            // return ifcond memory to the pool
-            ifc_put(tmp);
+            tmp->next = dead;
+            dead = tmp;
 
           // We had processed 1 element. Should we continue or return?
           if (!MULTIPLE_IFCONDS) {
-
-            rw_unlockw(&ifc_rw);
-
-            // Enable interrupts (for real GPIOs only,and only if there is an ISR handler registered)
-            // For periodic events and polling conditions - enable timer service
-            if (i < NO_TRIGGER && ifc_isr_is_registered(i))
-              gpio_intr_enable(i); 
-            if (i >= NO_TRIGGER)
-              ifc_enable_periodic_timers();
-
-            return;
+            done = true;
+            break;
           }
         } else {
           // Proceed to the next ifcond
@@ -900,6 +1525,37 @@ static void ifc_delete0(int num, bool all) {
         }
       } // while(ifc)
 
+      if (dead) {
+
+        // Rebuild the decision table once, so the ISR stops referencing deleted entries
+        // (or the watch table, so the change detector stops watching their variables).
+        // ifc_compile_pin() returns when the old table is not in use anymore. If the table can not be rebuilt,
+        // the old one must not stay: it references entries which are about to be recycled
+        if (i < NO_TRIGGER) {
+          if (!ifc_compile_pin(i)) {
+            ifc_publish_table(i, NULL);
+            q_printf("%% <e>Out of memory: conditions on GPIO%u are suspended until the next \"if\" on this GPIO</>\r\n", i);
+          }
+        } else if (i == VAR_IDX)
+          ifc_vars_compile();
+
+        // Interrupt must be released AFTER ifc is unlinked from the list:
+        // ifc_release_interrupt() checks if list is empty and if it is - uninstalls the ISR
+        if (i < NO_TRIGGER)
+          ifc_release_interrupt(i);
+
+        while (dead) {
+          struct ifcond *tmp = dead;
+          dead = dead->next;
+
+          // Timed events: release the timer
+          if (tmp->trigger_pin >= NO_TRIGGER)
+            ifc_release_timer(tmp);
+
+          // return ifcond memory to the pool
+          ifc_put(tmp);
+        }
+      }
 
       // Enable interrupts (for real GPIOs only,and only if there is an ISR handler registered)
       // For periodic events and polling conditions - enable timer service
@@ -908,8 +1564,8 @@ static void ifc_delete0(int num, bool all) {
       if (i >= NO_TRIGGER)
         ifc_enable_periodic_timers();
 
-      // If we were processing an ifcond chain that belongs to a GPIO - we are done.
-      if (!all && (num <= 0))
+      // Single ID was deleted, or we were processing an ifcond chain that belongs to a GPIO - we are done.
+      if (done || (!all && (num <= 0)))
         break;
 
     }
@@ -928,7 +1584,7 @@ static void ifc_clear0(int num, bool all) {
 
   int i;
 
-  MUST_NOT_HAPPEN(!all && num <= -(NUM_PINS + 2));
+  MUST_NOT_HAPPEN(!all && num <= -IFC_LISTS);
 
   // Clearing counters does not modify list itself, so treat clearing as a reader's operation
   rw_lockr(&ifc_rw);
@@ -937,11 +1593,13 @@ static void ifc_clear0(int num, bool all) {
   // Non-triggered entries belong to non-existing pins NO_TRIGGER and EVERY_IDX
   
   if (all) {
-    ifc_mp_drops = 0; // "all" also clears global mpipe drops counter
+    ifc_mp_drops = 0; // "all" also clears global mpipe drops counter and the latency histogram
+    memset(ifc_lat_hist, 0, sizeof(ifc_lat_hist));
+    memset(&ifc_wheel_jitter, 0, sizeof(ifc_wheel_jitter));
     num = 0;          // start with pin#0
   }
 
-  for (i = num < 0 ? -num : 0; i <= EVERY_IDX; i++) {
+  for (i = num < 0 ? -num : 0; i < IFC_LISTS; i++) {
 
     if (ifconds[i]) {
       struct ifcond *ifc = ifconds[i];
@@ -953,6 +1611,7 @@ static void ifc_clear0(int num, bool all) {
             ifc->tsta0 = 0;
             ifc->drops = 0;
             ifc->tsta = q_micros();
+            ifc_clear_stats(ifc);
 
             // Clear by icond ID? return then. 
             // NOTE: ifc->id is always > 0, so "if clear 0" is about the GPIO#0, not ifcond.id == 0
@@ -980,6 +1639,7 @@ static void ifc_clear0(int num, bool all) {
 // high        : GPIO mask for pins expected to be HIGH, or 0 if "dont care"
 // low         : GPIO mask for pins expected to be LOW, or 0 if "dont care"
 // limit       : if >0, then sets the limit for number of executions. Counter can be reset via "clear if counters"
+// var         : variable condition or NULL
 // exec        : alias name to execute on successfull match
 //
 static struct ifcond *ifc_create( uint8_t     trigger_pin, 
@@ -987,6 +1647,7 @@ static struct ifcond *ifc_create( uint8_t     trigger_pin,
                                   uint64_t    high, 
                                   uint64_t    low,
                                   uint32_t    limit,
+                                  const struct convar_cond *var,
                                   const char *exec) {
 
   
@@ -1006,11 +1667,13 @@ static struct ifcond *ifc_create( uint8_t     trigger_pin,
     n->disabled = 0;
     n->exec = al;
     n->has_delay = 0;
+    n->is_inline = 0;
     n->delay_ms = 0;
     n->has_rlimit = 0;
     n->rlimit = 0;
     n->poll_interval = 0;
-    n->timer = TIMER_INIT;
+    n->wnext = NULL;
+    n->wpprev = NULL;
     n->has_limit = limit > 0;
     n->limit = limit;
 
@@ -1028,6 +1691,16 @@ static struct ifcond *ifc_create( uint8_t     trigger_pin,
     n->drops = 0;
     n->tsta = q_micros();
     n->tsta0 = 0;
+    ifc_clear_stats(n);
+
+    if ((n->has_var = (var != NULL)) != 0) {
+      n->var = *var;
+      n->var.name = q_strdup(var->name, MEM_IFCOND);
+      n->var_widx = IFC_NO_WATCH;
+      // Comparisons which are already true at the moment of creation do not fire until they
+      // become false and then true again
+      n->var_was = convar_cond_test(&n->var);
+    }
 
     // Insert ifc into list
     if (trigger_pin != ONESHOT_IF) {
@@ -1042,6 +1715,10 @@ static struct ifcond *ifc_create( uint8_t     trigger_pin,
       rw_lockw(&ifc_rw);
       n->next = ifconds[trigger_pin];
       ifconds[trigger_pin] = n;
+      if (trigger_pin < NO_TRIGGER)
+        ifc_compile_pin(trigger_pin);
+      else if (trigger_pin == VAR_IDX)
+        ifc_vars_compile();
       rw_unlockw(&ifc_rw);
 
       // if trigger_pin is a real GPIO and ISR (must be) enabled - reenable it. 
@@ -1061,21 +1738,34 @@ static struct ifcond *ifc_create( uint8_t     trigger_pin,
 static void ifc_task(void *arg) {
 
   while( true ) {
-    struct ifcond *ifc = (struct ifcond *)mpipe_recv(ifc_mp);
+    struct ifc_snapshot snap;
+    struct ifcond *ifc = ifc_event_fetch((uint32_t)(uintptr_t)mpipe_recv(ifc_mp), &snap);
     if (ifc) {
       
-      // Store the timestamp.
+      // Store the timestamp (it was taken by the ISR or by the timer callback).
       // It is required for ifc_too_fast()
-      ifc->tsta = q_micros();
+      ifc->tsta = snap.tsta;
+
+      // Remember the event
+      ifc->recent[ifc->recent_idx] = snap;
+      ifc->recent_idx = (ifc->recent_idx + 1) % IFC_RECENT;
+
       if (!ifc_too_fast(ifc)) {
         ifc->tsta0 = ifc->tsta;
-        // Exec in a background as separate task because we can not block here: multiple
+        // Short, non-blocking aliases can be executed right here ("inline" keyword). Others
+        // are executed in a background as separate task because we can not block here: multiple
         // events can fire shortly one after another
-        alias_exec_in_background(ifc->exec);
+        if (!ifc->is_inline || !alias_exec_inline(ifc->exec, ifc, snap.tsta)) {
+          if (ifc->is_inline)
+            ifc->inl_fallbacks++;
+          alias_exec_in_background_ifc(ifc->exec, ifc, snap.tsta);
+        }
         ifc->hits++;
       } else
         ifc->drops++;
-    }
+    } else
+      // Event was overwritten in the ifc_events[] before we had a chance to process it
+      ifc_mp_drops++;
   }
   /* UNREACHED */
   task_finished();
@@ -1092,11 +1782,16 @@ static void ifc_show_fp(FILE *fp, struct ifcond *ifc) {
 
     if (ifc->trigger_pin == EVERY_IDX)
       fprintf(fp, "every ");
-    else if (ifc->trigger_pin != NO_TRIGGER)
+    else if (ifc->trigger_pin < NO_TRIGGER)
       fprintf(fp, "if %s %u ", ifc->trigger_rising ? "rising" : "falling", ifc->trigger_pin);
     else
       fprintf(fp, "if ");
 
+    if (ifc->has_var) {
+      char buf[CONVAR_NAMELEN_MAX + 32];
+      fprintf(fp, "%s ", convar_cond_sprint(&ifc->var, buf, sizeof(buf)));
+    }
+
     if (ifc->has_high)
       for (i = 0; i <32; i++) {
         if (ifc->high & (1UL << i))  fprintf(fp, "high %u ",i);
@@ -1139,6 +1834,9 @@ static void ifc_show_fp(FILE *fp, struct ifcond *ifc) {
     if (ifc->has_rlimit)
       fprintf(fp, "rate-limit %u ",ifc->rlimit);
 
+    if (ifc->is_inline)
+      fprintf(fp, "inline ");
+
     // Use quotes: aliases could have spaces in their names and we want to generate
     // "executable" output, which can be simply copy/pasted to the espshell prompt again
     if (ifc->exec)
@@ -1173,7 +1871,13 @@ static int cmd_if_disable_enable(int argc, char **argv) {
 
   struct ifcond *ifc;
 
-  for (i = start; i <= stop; i++)
+  // "if" covers GPIO, polled and variable entries, but not "every" entries
+  if (start != EVERY_IDX)
+    stop = VAR_IDX;
+
+  for (i = start; i <= stop; i++) {
+    if (i == EVERY_IDX && start != EVERY_IDX)
+      continue;
     if ((ifc = ifconds[i]) != NULL)
       while(ifc) {
         if (ifc->id == num || num == 0) {
@@ -1183,6 +1887,7 @@ static int cmd_if_disable_enable(int argc, char **argv) {
         }
         ifc = ifc->next;
       }
+  }
 
   return 0;
 }
@@ -1265,7 +1970,7 @@ static int cmd_if_save(int argc, char **argv) {
   fprintf(fp,"\r\n// \"if\" and \"every\" statements:\r\n//\r\n");
 
   rw_lockr(&ifc_rw);
-  for (int i=0; i < NUM_PINS+2; i++) {
+  for (int i=0; i < IFC_LISTS; i++) {
     ifc = ifconds[i];
     while (ifc) {
       if (id < 0 || ifc->id == id)
@@ -1286,6 +1991,7 @@ static int cmd_if_save(int argc, char **argv) {
 //
 // if rising|falling NUM [low|high NUM]* [max-exec NUM] [rate-limit MSEC] exec ALIAS_NAME
 // if low|high NUM [low|high NUM]* [poll TIMESPEC] [max-exec NUM] [rate-limit MSEC] exec ALIAS_NAME
+// if $NAME eq|ne|lt|gt|le|ge VALUE|changed [low|high NUM]* [poll TIMESPEC] [max-exec NUM] [rate-limit MSEC] exec ALIAS_NAME
 // every ...
 //
 // TODO: this functions is huge. must be split in smaller routines
@@ -1295,8 +2001,9 @@ static int cmd_if(int argc, char **argv) {
   unsigned int cond_idx = 1, max_exec = 0, rate_limit = 0, poll = 0, delay_ms = 0;
   const char *exec = NULL; // alias name
   unsigned char trigger_pin = NO_TRIGGER;
-  bool rising = false;
+  bool rising = false, has_var = false, is_inline = false;
   uint64_t low = 0, high = 0;
+  struct convar_cond var;
 
   // min command is "if clear 6" which is 3 keywords long
   if (argc < 3)
@@ -1340,10 +2047,15 @@ static int cmd_if(int argc, char **argv) {
   } else {
   // Handle generic "if" statement:
 
-  // 1. Read trigger condition, if any
+  // 1. Read trigger condition, if any: either a variable condition or rising/falling edge
     rising = (argv[1][0] == 'r');
 
-    if (rising || argv[1][0] == 'f') {
+    if (argv[1][0] == '$') {
+      int err;
+      if ((err = convar_cond_parse(argc, argv, &cond_idx, &var, true)) != 0)
+        return err;
+      has_var = true;
+    } else if (rising || argv[1][0] == 'f') {
       if ((trigger_pin = q_atoi(argv[2], NO_TRIGGER)) == NO_TRIGGER)
         return 2;
       if (!pin_exist(trigger_pin) || pin_isvirtual(trigger_pin))
@@ -1377,13 +2089,19 @@ static int cmd_if(int argc, char **argv) {
       else
         high |= 1ULL << pin;
 
+      // "low 5 high 5" can never match
+      if (low & high) {
+        HELP(q_printf("%% <e>GPIO%u can not be both \"low\" and \"high\"</>\r\n", pin));
+        return cond_idx + 1;
+      }
+
       // Next 2 keywords
       cond_idx += 2;
     }
 
-    // no "low/high/rising/falling" conditions, i.e. reduced "if":     if [poll X] exec
+    // no "low/high/rising/falling" or variable conditions, i.e. reduced "if":     if [poll X] exec
     // forward those to "every" pool
-    if (!low && !high && (trigger_pin == NO_TRIGGER))
+    if (!low && !high && !has_var && (trigger_pin == NO_TRIGGER))
       trigger_pin = EVERY_IDX;
   }
 
@@ -1422,13 +2140,18 @@ static int cmd_if(int argc, char **argv) {
         return cond_idx;
       }
 
+    } else if ( !q_strcmp(argv[cond_idx],"inline")) {
+
+      // single keyword, no arguments
+      is_inline = true;
+
     } else if ( !q_strcmp(argv[cond_idx],"exec")) {
 
       exec = argv[++cond_idx];
 
     } else {
 
-      HELP(q_print("% <e>Expected \"max-exec\", \"poll\", \"rate-limit\", \"delay\" or \"exec\" keyword</>\r\n"));
+      HELP(q_print("% <e>Expected \"max-exec\", \"poll\", \"rate-limit\", \"delay\", \"inline\" or \"exec\" keyword</>\r\n"));
       return cond_idx;
 
     }
@@ -1452,7 +2175,23 @@ static int cmd_if(int argc, char **argv) {
     q_printf("%% <i>Warning</>: alias \"%s\" exists but it is empty\r\n", exec);
 
 
-  // 2. No-Trigger entries:
+  // 2. Variable conditions: change-driven, unless the "poll" keyword is given.
+  //    "changed" conditions are always change-driven.
+  if (has_var) {
+    if (poll && var.op == CONVAR_OP_CHANGED) {
+      HELP(q_print("% \"poll\" keyword is ignored for \"changed\" conditions\r\n"));
+      poll = 0;
+    }
+    if (!poll) {
+      if (delay_ms) {
+        HELP(q_print("% \"delay\" keyword is ignored for change-driven conditions\r\n"));
+        delay_ms = 0;
+      }
+      trigger_pin = VAR_IDX;
+    }
+  }
+
+  // 3. No-Trigger entries:
   if (trigger_pin == NO_TRIGGER || trigger_pin == EVERY_IDX) {
     if (!poll)
       trigger_pin = ONESHOT_IF;
@@ -1462,8 +2201,8 @@ static int cmd_if(int argc, char **argv) {
               "% rate is a constant which is defined by \"<i>poll</>\" keyword\r\n"));
       rate_limit = 0;
     }
-  } else { 
-  // 3. Rising/Falling conditions:
+  } else if (trigger_pin != VAR_IDX) { 
+  // 4. Rising/Falling conditions:
     if (poll || delay_ms) {
       HELP(q_print("% \"poll\" and \"delay\" keywords are ignored for rising/falling conditions\r\n"));
       poll = 0;
@@ -1476,6 +2215,7 @@ static int cmd_if(int argc, char **argv) {
                                   high, 
                                   low,
                                   max_exec,
+                                  has_var ? &var : NULL,
                                   exec);
   if (!ifc) {
     q_print("% Failed. Out of memory?\r\n");
@@ -1483,7 +2223,7 @@ static int cmd_if(int argc, char **argv) {
   }
 
 
- // 4. The rate limit can range from 0 to 65 535 milliseconds.
+ // 5. The rate limit can range from 0 to 65 535 milliseconds.
  // A 16-bit field is chosen to save memory.
  // This limiter's only purpose is to prevent interrupt flooding, so values above 1 second are questionable.
 
@@ -1498,6 +2238,15 @@ static int cmd_if(int argc, char **argv) {
 
   ifc->poll_interval = poll;
 
+  // 6. Inline execution: the alias is checked on every execution, but warn the user now
+  if (is_inline) {
+    ifc->is_inline = 1;
+    if (!alias_is_inlineable(ifc->exec))
+      q_printf("%% <i>Warning</>: alias \"%s\" can not be executed inline, will be executed in a background task\r\n"
+               "%% Inline aliases: up to %u lines of \"pin\", \"pwm\", \"var\" or \"echo\", no \"delay\", \"loop\" or \"&\"\r\n",
+               exec, ALIAS_INLINE_MAX_LINES);
+  }
+
   if (delay_ms) {
     ifc->has_delay = 1;
     ifc->delay_ms = delay_ms;
@@ -1511,10 +2260,11 @@ static int cmd_if(int argc, char **argv) {
   // allocate an interrupt (allocated or reused - decides ifc_claim_interrupt())
   // /ifc/ pointer is in the list but not yet attached to an interrupt or to a timer so it is 
   // guaranteed to still be on the list
+  // Change-driven variable conditions need neither: they are already watched by the change detector
   if (trigger_pin < NO_TRIGGER)
     ifc_claim_interrupt(trigger_pin);
-  else
-    ifc_claim_timer(ifc, false);
+  else if (trigger_pin != VAR_IDX)
+    ifc_claim_timer(ifc);
   // WARNING:
   // Here /ifc/ pointer already may be invalid (returned to the ifc_unused) so we must not write to its
   // fields here
@@ -1542,6 +2292,33 @@ static int cmd_show_ifs(int argc, char **argv) {
     q_printf("%% <e>Dropped events (more than %u conds at once): %u</>\r\n", MPIPE_CAPACITY, ifc_mp_drops);
     q_print("% <e>Use \"rate-limit\" or increase MPIPE_CAPACITY</>\r\n");
   }
+
+  // Timer wheel statistics: number of periodic entries and how late they were dispatched
+  if (argc < 3 && ifc_wheel_jitter.cnt)
+    q_printf("%% Timer wheel: %u periodic entries, %u ms tick, dispatch delay: min <i>%lu</> us, avg <i>%lu</> us, max <i>%lu</> us\r\n",
+             ifc_wheel_count, IFC_WHEEL_TICK_MS,
+             ifc_wheel_jitter.min, (uint32_t)(ifc_wheel_jitter.sum / ifc_wheel_jitter.cnt), ifc_wheel_jitter.max);
+
+  // Variable change detector: number of distinct variables being watched
+  if (argc < 3 && ifc_watches_num)
+    q_printf("%% Change detector: %u variable(s) watched, checked every %u ms\r\n", ifc_watches_num, IFC_VARS_SCAN_MS);
+
+  // Event-to-alias-start latency distribution (all conditions), only non-empty ranges are displayed
+  if (argc < 3) {
+    int i, total = 0;
+    for (i = 0; i < IFC_LAT_BUCKETS; i++)
+      total += ifc_lat_hist[i];
+    if (total) {
+      q_print("% Event-to-alias latency distribution (all conditions):\r\n");
+      for (i = 0; i < IFC_LAT_BUCKETS; i++)
+        if (ifc_lat_hist[i]) {
+          if (i < IFC_LAT_BUCKETS - 1)
+            q_printf("%% %6u .. %6u us : <i>%lu</> (%u%%)\r\n", i ? 1 << i : 0, (2 << i) - 1, ifc_lat_hist[i], (unsigned int)(100ULL * ifc_lat_hist[i] / total));
+          else
+            q_printf("%% %6u .. and up  : <i>%lu</> (%u%%)\r\n", 1 << i, ifc_lat_hist[i], (unsigned int)(100ULL * ifc_lat_hist[i] / total));
+        }
+    }
+  }
   return 0;
 }
 
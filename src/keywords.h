@@ -119,6 +119,7 @@ has_handler( cmd_nap_alarm );
 has_handler( cmd_pwm );
 has_handler( cmd_count );
 has_handler( cmd_pin );
+has_handler( cmd_pins );
 
 // RMT sequences
 has_handler( cmd_seq_if );
@@ -137,10 +138,13 @@ has_handler( cmd_seq_save );
 has_handler( cmd_seq_decode );
 has_handler( cmd_seq_capture );
 has_handler( cmd_seq_profile );
+has_handler( cmd_seq_frame );
 
 // sketch variables
 has_handler( cmd_var );
 has_handler( cmd_var_show );
+has_handler( cmd_var_watch );
+has_handler( cmd_var_export );
 
 // alias/file execution
 has_handler( cmd_exec );
@@ -207,10 +211,14 @@ has_handler( cmd_hostid );
 // Alias commands
 #if WITH_ALIAS
 has_handler( cmd_alias_if );
+has_handler( cmd_alias_trace );
 has_handler( cmd_alias_quit );
 has_handler( cmd_alias_list );
 has_handler( cmd_alias_delete );
 has_handler( cmd_alias_asterisk );
+#if WITH_FS
+has_handler( cmd_snapshot );
+#endif
 #endif
 
 // Command "time" and NTP support
@@ -774,39 +782,67 @@ KEYWORDS_DECL(sequence) {
           ), 
     HELPK("Save sequence to a file") },
 #endif // WITH_FS    
-#if NOT_YET
-  { "decode", cmd_seq_decode, 1,
-    HELPK("% \"<b>decode [TOLERANCE]</>\"\r\n"
+  { "decode", cmd_seq_decode, MANY_ARGS,
+    HELPK("% \"<b>decode [TOLERANCE] [FILE]</>\"\r\n"
           "%\r\n"
           "% Attempt to decode \"levels\" to a bit string according to pulse descriptions\r\n"
           "% in \"one\" and \"zero\" alphabet, allowing for timing characteristics to be\r\n"
           "% around desired values +/- TOLERANCE percents (Default value is 20%%)\r\n"
+          "% Decoded bits replace current \"bits\" of the sequence, levels are kept.\r\n"
           "%\r\n"
           "% Sequence must be initialized: either manually, by \"capture\" command,\r\n"
           "% or loaded from the file by global \"exec\" command.\r\n"
+          "% With FILE argument, a symbol dump recorded by \"capture PIN continuous\"\r\n"
+          "% is decoded and printed frame by frame\r\n"
+          "%\r\n"
           "% <u>Example:</>\r\n"
-          "%   <i>profile nec</> : load NEC protocol preset\r\n"
-          "%   <i>decode 10</>   : decode as NEC protocol, (+- 10% for timing characteristics is ok)\r\n"
+          "%   <i>decode 10</>           : decode levels, (+- 10% for timing characteristics is ok)\r\n"
+          "%   <i>decode /ffat/ir.bin</> : decode frames recorded to a file\r\n"
           "% If the pulse we are expecting is 100uS long, then any pulse from 90 to 110 uS\r\n"
-          "% will match"), HELPK("Sequence decode") },
+          "% will match with TOLERANCE of 10"), HELPK("Sequence decode") },
 
-  { "decode", cmd_seq_decode, 0, HIDDEN_KEYWORD },
+  { "decode", cmd_seq_decode, NO_ARGS, HIDDEN_KEYWORD },
 
   { "profile", cmd_seq_profile, 1,
-    HELPK("% \"<b>profile <i>nec|lg|lg32|samsung|1wire|neopixel|none</>\"\r\n"
+    HELPK("% \"<b>profile <i>nec|samsung|lg|rc5|none</>\"\r\n"
           "%\r\n"
           "% Load presets for different IR protocols:\r\n"
           "% Loads header and trailer, modulation parameters, \"one\" \r\n"
-          "% and \"zero\" definitions, tick rate"
+          "% and \"zero\" definitions, tick rate.\r\n"
+          "% Frames are then set with \"frame\" command, and decoded frames\r\n"
+          "% are displayed as address and command (see \"decode\", \"capture\")\r\n"
+          "%\r\n"
+          "% \"none\" detaches the profile, current settings are kept"
           ),
     HELPK("Timing profiles") },
-#endif
+
+  { "frame", cmd_seq_frame, 2,
+    HELPK("% \"<b>frame ADDRESS COMMAND</>\"\r\n"
+          "%\r\n"
+          "% Set bits of the sequence to a frame of the protocol profile\r\n"
+          "% (see \"profile\"): address and command are encoded as required\r\n"
+          "% by the protocol (inverted copies, checksums, bit order)\r\n"
+          "%\r\n"
+          "% <u>Example:</>\r\n"
+          "%   <i>profile nec</>\r\n"
+          "%   <i>frame 0x04 0x08</> : NEC frame for address 4, command 8"
+          ),
+    HELPK("Set protocol frame") },
   { "capture", cmd_seq_capture, MANY_ARGS,
     HELPK("% \"<b>capture PIN [NUM_SYMBOLS | all] [TIMEOUT_MS]</>\"\r\n"
+          "% \"<b>capture PIN continuous [decode] [FILE]</>\"\r\n"
           "%\r\n"
           "% Capture sequence of pulses on GPIO# PIN, to <u><b>this</> sequence\r\n"
           "% Once \"one\" and \"zero\" alphabet is set, an attempt to decode\r\n"
-          "% the bit string could be made (see \"decode\" command)"),
+          "% the bit string could be made (see \"decode\" command)\r\n"
+          "%\r\n"
+          "% Continuous capture receives frames until a key is pressed (or \"kill\")\r\n"
+          "% Last frames are kept in a ring buffer; whole frames (joined together)\r\n"
+          "% become levels of the sequence.\r\n"
+          "% \"decode\" decodes and prints every frame, FILE records raw frames\r\n"
+          "%\r\n"
+          "% <u>Example:</>\r\n"
+          "%   <i>capture 4 continuous decode /ffat/ir.bin</>"),
     HELPK("Sequence capture") },
   
 
@@ -1127,6 +1163,43 @@ KEYWORDS_DECL(alias) {
 
   // Special entry. Matches any command just as MANY_ARGS matches any number of arguments
   // The first "*" is what actually matches while "TEXT*" is just a hint for the user
+  { "goto", HELP_ONLY,
+    HELPK("% \"<b>goto</> [+|-]<i>NUM</>|<i>end</> [<o>if COND</>]\"\r\n"
+          "%\r\n"
+          "% Jump to line NUM, NUM lines forward (\"+\") or backward (\"-\"), or to the end of the alias\r\n"
+          "% COND is \"low PIN\", \"high PIN\" or \"$NAME eq|ne|lt|gt|le|ge VALUE\"\r\n"
+          "% Alias execution can be interrupted by a keypress (or \"kill\") on a backward jump\r\n"
+          "% <u>Examples:</>\r\n"
+          "%   <i>goto 1</>            - start over\r\n"
+          "%   <i>goto -2 if low 5</>  - jump 2 lines back while GPIO5 is low\r\n"
+          "%   <i>goto end if $x gt 10</> - stop if variable \"x\" is greater than 10"),
+    HELPK("Jump to line (alias only)") },
+
+  { "loop", HELP_ONLY,
+    HELPK("% \"<b>loop</> [-]<i>NUM</> <i>COUNT</>\"\r\n"
+          "%\r\n"
+          "% Repeat lines starting from line NUM (or NUM lines back) COUNT times\r\n"
+          "% <u>Example:</>\r\n"
+          "%   <i>pin 2 toggle</>\r\n"
+          "%   <i>loop -1 10</>        - toggle GPIO2 10 times"),
+    HELPK("Repeat lines (alias only)") },
+
+  { "skip", HELP_ONLY,
+    HELPK("% \"<b>skip</> [<o>NUM</>] <i>if</> COND\"\r\n"
+          "%\r\n"
+          "% Skip next NUM lines (default is 1) if COND is true. See \"goto\" for COND syntax\r\n"
+          "% <u>Example:</>\r\n"
+          "%   <i>skip if high 4</>    - skip the next line if GPIO4 is high"),
+    HELPK("Skip lines (alias only)") },
+
+  { "break", HELP_ONLY,
+    HELPK("% \"<b>break</> [<o>if COND</>]\"\r\n"
+          "%\r\n"
+          "% Stop alias execution. See \"goto\" for COND syntax\r\n"
+          "% <u>Example:</>\r\n"
+          "%   <i>break if $mode eq 0</>"),
+    HELPK("Stop alias execution (alias only)") },
+
   { "*TEXT*", cmd_alias_asterisk, MANY_ARGS,
     HELPK("% \"<b>COMMAND ARG1 ARG2 ... ARGn</>\"\r\n" 
           "%\r\n"
@@ -1731,6 +1804,30 @@ KEYWORDS_DECL(main) {
           "%   <i>alias Motor_On</> - Create alias \"Motor_On\""), 
     HELPK("Command aliases") 
   },
+
+  { "alias", cmd_alias_trace, 3,
+    HELPK("% \"<b>alias</> <i>NAME</> <i>trace</> <i>on|off|clear</>\"\r\n"
+          "%\r\n"
+          "% Enable or disable alias execution tracing, or reset collected statistics\r\n"
+          "% While tracing is on, execution time of every alias line is measured in CPU cycles\r\n"
+          "% Results are displayed by \"show alias NAME stats\"\r\n"
+          "% <u>Examples:</>\r\n"
+          "%   <i>alias Motor_On trace on</> - Start collecting statistics for \"Motor_On\""), 
+    NULL },
+
+#if WITH_FS
+  { "snapshot", cmd_snapshot, 2,
+    HELPK("% \"<b>snapshot</> <i>save|load</> <i>/FILENAME</>\"\r\n"
+          "%\r\n"
+          "% Save or restore aliases, \"if\" and \"every\" conditions and sequences\r\n"
+          "% using a compact binary file. Loading a snapshot is much faster than executing\r\n"
+          "% a text configuration file, because nothing has to be parsed again\r\n"
+          "% Aliases and sequences are replaced, conditions are added\r\n"
+          "% <u>Examples:</>\r\n"
+          "%   <i>snapshot save /ffat/config.bin</> - Save current configuration\r\n"
+          "%   <i>snapshot load /ffat/config.bin</> - Restore it"), 
+    HELPK("Binary configuration snapshots") },
+#endif
 #endif
 
 
@@ -1756,13 +1853,20 @@ KEYWORDS_DECL(main) {
     HELPK("UART commands") },
     
 
-  { "sequence", cmd_seq_if, 1,
+  { "sequence", cmd_seq_if, MANY_ARGS,
     HELPK("% \"<b>sequence</> <i>NUM</>\"\r\n"
+          "% \"<b>sequence send</> <i>PIN1 SEQ1 PIN2 SEQ2</> [<i>PIN3 SEQ3 ...</>]\"\r\n"
           "%\r\n"
           "% Create or configure a pulse sequence that can later be replayed on any GPIO.\r\n"
           "% NUM is the sequence number, in the range [0.." xstr(SEQUENCES_NUM) "].\r\n"
+          "%\r\n"
+          "% \"send\" form: send several sequences on several GPIOs, all started at once\r\n"
+          "% (one RMT channel per GPIO). Where hardware supports it, channels start on the\r\n"
+          "% same clock; otherwise the measured start skew is displayed.\r\n"
+          "% Sequences are sent once, loop settings are ignored\r\n"
           "% <u>Examples:</>\r\n"
-          "%   <i>sequence 5</>     - Enter sequence editing mode (Seq#5)"
+          "%   <i>sequence 5</>     - Enter sequence editing mode (Seq#5)\r\n"
+          "%   <i>sequence send 4 0 5 1</> - Send Seq#0 on GPIO4 and Seq#1 on GPIO5, simultaneously"
           ),
     HELPK("Pulse sequence configuration") },
     
@@ -1909,6 +2013,30 @@ KEYWORDS_DECL(main) {
           "%  <i>pin 1 matrix</>             - Reset pin's GPIO Matrix connections"
           ),  NULL },
 
+  { "pins", cmd_pins, MANY_ARGS,
+    HELPK("% \"<b>pins</> <i>MASK</> [<o>MASK | ARG1 | ARG2 | ... | ARGn]*</>\"\r\n"
+          "%\r\n"
+          "% Manipulate a group of pins at once. MASK is a 64-bit GPIO bitmask (\"0x34\",\r\n"
+          "% \"0b110100\") or a list of GPIO numbers and ranges (\"2,4,5\", \"12-15\").\r\n"
+          "% Keywords apply to all pins of the last MASK:\r\n"
+          "%\r\n"
+          "% \"<i>high</>\", \"<i>low</>\", \"<i>toggle</>\"    - set levels of all pins simultaneously\r\n"
+          "% \"<i>up</>\", \"<i>down</>\"             - enable PULL_UP or PULL_DOWN\r\n"
+          "% \"<i>out</>\", \"<i>in</>\", \"<i>open</>\"      - set OUTPUT, INPUT, or OPEN_DRAIN mode\r\n"
+          "% \"<i>read</>\"                   - read digital values\r\n"
+          "% \"<i>delay</>\"                  - delay the next keyword\r\n"
+          "% \"<i>loop</>\"                   - execute the entire command multiple times\r\n"
+          "%\r\n"
+          "% Levels are written directly to GPIO set/clear registers: much faster than \"pin\"\r\n"
+          "%\r\n"
+          "% <u>Examples:</>\r\n"
+          "%  <i>pins 2,4 high 5 low</>      - GPIO2 and GPIO4 to \"1\" and GPIO5 to \"0\", at once\r\n"
+          "%  <i>pins 0x34 toggle</>         - invert levels of GPIO2, GPIO4 and GPIO5\r\n"
+          "%  <i>pins 12-15 low high loop inf</> - squarewave on 4 pins at max speed\r\n"
+          "%  <i>pins 2,4 out read</>        - configure as outputs, read levels"
+          ),
+    HELPK("Multiple GPIO commands") },
+
   // PWM generation
   { "pwm", cmd_pwm, 4,
     HELPK("% \"<b>pwm <i>PIN</> [<o>FREQ</> [<o>DUTY</> [<o>CHANNEL</>] ] ]\"\r\n"
@@ -1922,7 +2050,9 @@ KEYWORDS_DECL(main) {
           "% Duty resolution is auto-selected but can be overridden with \"var ledc_res BITS\".\r\n"
           "%\r\n"
           "% CHANNEL is an optional parameter that selects the PWM channel to use (0..15 on ESP32,\r\n"
-          "% or 0..7 on ESP32-S3).\r\n"
+          "% or 0..7 on ESP32-S3). By default a channel is selected automatically; channels used\r\n"
+          "% by the sketch or the camera, or sharing a timer with a different frequency, are\r\n"
+          "% never used. See \"<i>show pwm</>\" for the LEDC channels map.\r\n"
           "% <u>Examples:</>\r\n"
           "%   <i>pwm 2 1000</>      - enable PWM of 1kHz, 50% duty cycle on pin 2\r\n"
           "%   <i>pwm 2 100 0.15</>  - enable PWM of 100 Hz, 15% duty cycle on pin 2\r\n"
@@ -1932,18 +2062,40 @@ KEYWORDS_DECL(main) {
           "%   <i>pwm 2 off</>       - same as above"),  
     HELPK("PWM output") },
 
+  { "pwm", HELP_ONLY,
+    HELPK("% \"<b>pwm <i>PIN1,PIN2,...,PINn</> <o>FREQ</> [<o>DUTY</> | <o>DUTY1,DUTY2,...,DUTYn</>]\"\r\n"
+          "%\r\n"
+          "% Batched PWM: set frequency and duty on several pins at once (no spaces in lists).\r\n"
+          "% On pins which already run at FREQ, new duty values take effect simultaneously,\r\n"
+          "% without restarting outputs.\r\n"
+          "% <u>Examples:</>\r\n"
+          "%   <i>pwm 2,4,5 20000 0.3</>         - 20 kHz, 30% duty on pins 2, 4 and 5\r\n"
+          "%   <i>pwm 2,4,5 20000 0.1,0.5,0.9</> - same pins, different duty cycles\r\n"
+          "%   <i>pwm 2,4,5 0</>                 - disable PWM on pins 2, 4 and 5"),
+    NULL },
+
   { "pwm", cmd_pwm, 3, HIDDEN_KEYWORD }, // pwm PIN FREQ DUTY
   { "pwm", cmd_pwm, 2, HIDDEN_KEYWORD }, // pwm PIN FREQ, pwm PIN off, pwm PIN 0
   { "pwm", cmd_pwm, 1, HIDDEN_KEYWORD }, // pwm PIN
 
   // Pulse counting/frequency meter
   { "count", cmd_count, MANY_ARGS,
-    HELPK("% \"<b>count <i>PIN</> [<o>NUMBER</>| <o>infinite</> | <o>trigger</> | <o>filter LENGTH</>]*\"\r\n"
+    HELPK("% \"<b>count <i>PIN</> [<o>NUMBER</>| <o>infinite</> | <o>trigger</> | <o>filter LENGTH</> | <o>control PIN2</> |\r\n"
+          "%              <o>gate</> | <o>reciprocal</> | <o>log INTERVAL</> [<o>file PATH</>]]*\"\r\n"
           "%\r\n"
           "% Count pulses on PIN for NUMBER milliseconds (default is 1 second). Use the\r\n"
           "% keyword <i>infinite</> to make the measurement time very large.\r\n"
           "% The optional \"trigger\" keyword suspends counting until the first pulse.\r\n"
           "% The optional \"filter LEN\" keyword ignores pulses <u>shorter than</> LEN nanoseconds.\r\n"
+          "% The optional \"control PIN2\" keyword makes hardware count pulses only while\r\n"
+          "% PIN2 is HIGH; frequency is calculated over the time PIN2 was HIGH.\r\n"
+          "% Pulses are counted over the measurement time (\"gate\", default). For low\r\n"
+          "% frequencies use \"reciprocal\": signal periods are averaged instead (uses the\r\n"
+          "% PIN interrupt; refused if the interrupt is already used by the sketch or \"if\")\r\n"
+          "% Estimated measurement errors are shown by \"<i>show counters</>\"\r\n"
+          "% The optional \"log INTERVAL\" keyword records pulse count every INTERVAL ms\r\n"
+          "% (see \"<i>show counters history</>\"), optionally to a file: CSV, or binary if\r\n"
+          "% the file name ends with \".bin\"\r\n"
           "%\r\n"
           "% <u>Examples:</>\r\n"
           "%   <i>count 4</>             - count pulses & measure frequency on GPIO4 for 1000 ms\r\n"
@@ -1951,6 +2103,9 @@ KEYWORDS_DECL(main) {
           "%   <i>count 4 filter 100</>  - count pulses, ignoring those <u>shorter than</> 100 ns\r\n"
           "%   <i>count 4 infinite &</>  - count pulses in the <u>background</> continuously\r\n"
           "%   <i>count 4 trigger</>     - wait for the first pulse, then start counting\r\n"
+          "%   <i>count 4 control 5</>   - count pulses on GPIO4 while GPIO5 is HIGH\r\n"
+          "%   <i>count 4 10000 recip</> - measure a slow signal: 0.5 Hz is shown as 0.500 Hz\r\n"
+          "%   <i>count 4 inf log 1000 file /ffat/fan.csv &</> - fan tachometer log, every second\r\n"
           "%   <i>count 4 trigger 2000 filter 300 &</> - wait for the first pulse, then count\r\n"
           "%     pulses for 2 seconds in the background, ignoring pulses shorter than 300 ns\r\n"
           "%   <i>count 4 2000 filter 300 trig &</>"), 
@@ -1965,6 +2120,18 @@ KEYWORDS_DECL(main) {
           "%   <i>count 4 clear</> - clear all counters associated with GPIO4\r\n"
           ),
     NULL },
+
+  { "count", HELP_ONLY,
+    HELPK("% \"<b>count <i>PIN1,PIN2,...,PINn</> [<o>NUMBER</>| <o>infinite</> | <o>filter LENGTH</>]*\"\r\n"
+          "%\r\n"
+          "% Count pulses on several pins simultaneously. Every pin uses its own PCNT unit;\r\n"
+          "% all counters are started and stopped at the same moment and share the same\r\n"
+          "% measurement interval. Pins are separated by commas, no spaces.\r\n"
+          "% <u>Examples:</>\r\n"
+          "%   <i>count 4,5,18</>        - measure frequency on GPIO4, 5 and 18 for 1000 ms\r\n"
+          "%   <i>count 4,5 5000 &</>    - same for GPIO4 and 5, 5 seconds, in the background\r\n"
+          ),
+    NULL },
     
 #if WITH_ESPCAM
   { "camera", cmd_camera_if, MANY_ARGS, 
@@ -2004,9 +2171,11 @@ KEYWORDS_DECL(main) {
           "% <u>Examples:</>\r\n"
           "%   <i>var button1</>     - display the current value of the \"button1\" sketch variable\r\n"
           "%   <i>var angle -12.3</> - set the sketch variable \"angle\" to -12.3\r\n"
+          "%   <i>var buffer hex</>  - display array \"buffer\" in hex (also \"dec\" and \"float\")\r\n"
           "%\r\n"
           "% Note #1: Partial (shortened) variable names may be used\r\n"
           "% Note #2: Use the prefixes \"0x\" for hex, \"0\" for octal, and \"0b\" for binary numbers\r\n"
+          "% Note #3: Long arrays can be interrupted by pressing <Enter>\r\n"
     ),
       NULL },
 
@@ -2026,6 +2195,61 @@ KEYWORDS_DECL(main) {
           ),
     NULL },
 
+  { "var", HELP_ONLY,
+    HELPK("% \"<b>var watch</> [<i>VARIABLE_NAME</> [<o>INTERVAL</>]]\"\r\n"
+          "% \"<b>var unwatch</> <i>VARIABLE_NAME|all</>\"\r\n"
+          "%\r\n"
+          "% Watch a sketch variable: sample it every INTERVAL milliseconds (default is\r\n"
+          "% " xstr(WATCH_INTERVAL_DEF) " ms) and log its changes with timestamps. Up to " xstr(WATCH_MAX) " variables\r\n"
+          "% can be watched, each with its own interval. Without arguments displays\r\n"
+          "% the list of watched variables\r\n"
+          "%\r\n"
+          "% <u>Examples:</>\r\n"
+          "%   <i>var watch angle</>      - watch variable \"angle\", " xstr(WATCH_INTERVAL_DEF) " ms interval\r\n"
+          "%   <i>var watch buf[3] 1</>   - watch array element, sample it every millisecond\r\n"
+          "%   <i>var unwatch all</>      - stop watching\r\n"
+          "%\r\n"
+          "% Note: variables named \"log\" must be entered as \"$log\"\r\n"
+          ),
+    NULL },
+
+  { "var", HELP_ONLY,
+    HELPK("% \"<b>var watch log</> [<o>csv|bin</>] [<o>FILE</>] [<o>follow</>]\"\r\n"
+          "%\r\n"
+          "% Display or save changes of watched variables. Displayed changes are\r\n"
+          "% removed from the log (" xstr(WATCH_RING_SIZE) " records max; oldest records are dropped)\r\n"
+          "%\r\n"
+          "% <o>csv</>    - output \"timestamp_us,name,value\" lines\r\n"
+          "% <o>bin</>    - compact binary format, FILE is required\r\n"
+          "% <o>FILE</>   - append (text) or write (binary) to the FILE instead of the console\r\n"
+          "% <o>follow</> - keep streaming until a key is pressed (or \"kill\" for background tasks)\r\n"
+          "%\r\n"
+          "% <u>Examples:</>\r\n"
+          "%   <i>var watch log</>                      - display changes logged so far\r\n"
+          "%   <i>var watch log csv /ffat/log.csv follow &</> - stream changes to a file\r\n"
+          ),
+    NULL },
+
+  { "var", HELP_ONLY,
+    HELPK("% \"<b>var export</> <i>NAME</> [<i>NAME</> ...] [<o>every MS</>] <i>uart NUM|file PATH|udp HOST PORT</>\"\r\n"
+          "% \"<b>var export</> [<o>stop</>]\"\r\n"
+          "%\r\n"
+          "% Periodically send values of sketch variables in binary frames (every\r\n"
+          "% " xstr(EXPORT_INTERVAL_DEF) " ms by default) to a UART, a file or a UDP socket. A schema frame\r\n"
+          "% describing names, types and offsets is sent first and then every\r\n"
+          "% " xstr(EXPORT_SCHEMA_EVERY) " data frames. See \"export.h\" for the frame format\r\n"
+          "%\r\n"
+          "% <u>Examples:</>\r\n"
+          "%   <i>var export rpm temp every 100 uart 1</>      - 10 frames per second to UART1\r\n"
+          "%   <i>var export rpm udp 192.168.4.2 5000</>      - send to a UDP port\r\n"
+          "%   <i>var export stop</>                          - stop exporting\r\n"
+          "%   <i>var export</>                               - exporter status\r\n"
+          "%\r\n"
+          "% Note: variables named \"every\", \"uart\", \"file\", \"udp\" or \"stop\" must be\r\n"
+          "%       entered with \"$\" prefix: \"$file\"\r\n"
+          ),
+    NULL },
+
 
   { "var", cmd_var_show, NO_ARGS,
     HELPK("% \"<b>var</>\"\r\n"
@@ -2041,13 +2265,16 @@ KEYWORDS_DECL(main) {
 #if WITH_ALIAS
 
   { "if", cmd_if, MANY_ARGS,
-    HELPK("% \"<b>if <i>rising|falling</> PIN [<o>low|high PIN</>]* [<o>max-exec NUM</>] [<o>rate-limit NUM</>] <i>exec</> ALIAS</>\"\r\n"
+    HELPK("% \"<b>if <i>rising|falling</> PIN [<o>low|high PIN</>]* [<o>max-exec NUM</>] [<o>rate-limit NUM</>] [<o>inline</>] <i>exec</> ALIAS</>\"\r\n"
           "%\r\n"
           "% Catch GPIO rising or falling interrupts and execute scripts\r\n"
           "% Additional <u>level conditions</> may be provided (see examples)\r\n"
           "%\r\n"
           "%   <i>max-exec</> NUM   : execute this condition no more than NUM times\r\n"
           "%   <i>rate-limit</> NUM : minimum time (ms) between two consecutive executions\r\n"
+          "%   <i>inline</>         : execute short alias without creating a task (faster)\r\n"
+          "%                    up to 4 lines of \"pin\", \"pwm\", \"var\" or \"echo\",\r\n"
+          "%                    no \"delay\", \"loop\" or \"&\"\r\n"
           "%   <i>exec</> ALIAS     : alias for \"exec\"\r\n"
           "%\r\n"
           "% <u>Examples</>\r\n"
@@ -2061,6 +2288,10 @@ KEYWORDS_DECL(main) {
           "%\r\n"
           "%   <i>if rising 5 low 6 high 10 max-exec 5 rate-limit 1000 exec Comm</>\r\n"
           "%\r\n"
+          "% Toggle GPIO #2 on every rising edge of GPIO #5, with minimal latency:\r\n"
+          "%\r\n"
+          "%   <i>if rising 5 inline exec Toggle</>\r\n"
+          "%\r\n"
           "% NOTE: If the alias does not exist, it will be created automatically (empty)\r\n"
           ), 
     HELPK("Conditional GPIO events") },
@@ -2082,6 +2313,24 @@ KEYWORDS_DECL(main) {
           ), 
     NULL },
 
+  { "if", HELP_ONLY,
+    HELPK("% \"<b>if <i>$NAME</> eq|ne|lt|gt|le|ge VALUE [<o>low|high PIN</>]* [<o>poll TIMESPEC</>] <i>exec</> ALIAS</>\"\r\n"
+          "% \"<b>if <i>$NAME</> changed [<o>low|high PIN</>]* [<o>max-exec NUM</>] [<o>rate-limit NUM</>] <i>exec</> ALIAS</>\"\r\n"
+          "%\r\n"
+          "% Create a condition on a registered variable (see \"var\")\r\n"
+          "% Without \"poll\" the condition is checked only when the variable changes,\r\n"
+          "% and fires when the comparison <u>becomes</> true. With \"poll\" it is checked\r\n"
+          "% periodically and fires every time the comparison is true\r\n"
+          "%   <i>$NAME</>   : variable name or an array element, e.g. \"$counter\" or \"$buf[3]\"\r\n"
+          "%   <i>changed</> : fire on every change of the variable value\r\n"
+          "%\r\n"
+          "% <u>Examples:</>\r\n"
+          "%   <i>if $temp gt 30 exec Fan</>          : when \"temp\" becomes greater than 30\r\n"
+          "%   <i>if $mode changed exec Mode</>       : whenever \"mode\" changes\r\n"
+          "%   <i>if $temp gt 30 poll 1000 exec Fan</> : every second, while \"temp\" is above 30\r\n"
+          ), 
+    NULL },
+
   { "if", HELP_ONLY,
     HELPK("% \"<b>if delete NUM | all | poll | gpio NUM\"\r\n"
           "% \"<b>every delete NUM | all\"\r\n"
@@ -2145,13 +2394,14 @@ KEYWORDS_DECL(main) {
           "%   <b>every save <i>1 /ffat/test2</> : Save \"every\" entry #1"), NULL },
 // TODO: must use read_timespec()
   { "every", cmd_if, MANY_ARGS,
-    HELPK("% \"<b>every <i>TIME</> [<o>delay MILLIS</>] [<o>max-exec NUM</>] exec <i>ALIAS</>\"\r\n"
+    HELPK("% \"<b>every <i>TIME</> [<o>delay MILLIS</>] [<o>max-exec NUM</>] [<o>inline</>] exec <i>ALIAS</>\"\r\n"
           "%\r\n"
           "% Periodic events.\r\n"
           "% TIME is specified as NUMBER followed by \"milliseconds|seconds|minutes|hours|days\"\r\n"
           "%\r\n"
           "%   <i>max-exec</> NUM    : execute this condition no more than NUM times\r\n"
           "%   <i>delay</> MILLIS   : postpone the first execution for the specified amount of time\r\n"
+          "%   <i>inline</>         : execute short alias without creating a task (see \"? if\")\r\n"
           "%   <i>exec</> ALIAS     : alias to exec\r\n"
           "%\r\n"
           "% <u>Examples</>\r\n"
@@ -2514,10 +2764,11 @@ KEYWORDS_DECL(show) {
           "% at once"),"Show GPIO"},
 
   { "counters",  cmd_show_counters, MANY_ARGS,
-    HELPK("% \"<b>show <i>counters</>\"\r\n"
+    HELPK("% \"<b>show <i>counters</> [<o>history</> [<o>NUM</>]]\"\r\n"
           "%\r\n"
           "% Pulse counters / frequency meters states and values\r\n"
-          "% Depending on a SoC used it may be up to 8 hardware counters"),"Show pulse counters/frequency meters"},
+          "% Depending on a SoC used it may be up to 8 hardware counters\r\n"
+          "% \"history\" displays last NUM (default is 20) samples recorded by \"count ... log\""),"Show pulse counters/frequency meters"},
 
   { "sequence", cmd_show_sequence, MANY_ARGS,
     HELPK("% \"<b>show <i>sequence</> NUMBER\"\r\n"
@@ -2584,7 +2835,8 @@ KEYWORDS_DECL(show) {
     HELPK("% \"<b>show</> <i>alias</> [<o>ALIAS_NAME</>]\"\r\n"
           "%\r\n"
           "% \"show alias\"     - Display list of configured aliases\r\n"
-          "% \"show alias NAME\"- Display alias NAME listing "), "Show aliases"},
+          "% \"show alias NAME\"- Display alias NAME listing\r\n"
+          "% \"show alias NAME stats\" - Display execution statistics (see \"alias NAME trace on\")"), "Show aliases"},
 
   { "if", cmd_show_ifs, MANY_ARGS,
     HELPK("% \"<b>show <i>if</> [<o>NUM</>]\"\r\n"
@@ -1131,6 +1131,183 @@ static int cmd_pin_matrix(int argc, char **argv,unsigned int pin, unsigned int *
   return 0;
 }
 
+// -- Looped "pin" commands --
+//
+// The first pass of a "pin" command is interpreted: keywords are decoded, executed and recorded as a
+// compact array of ops. When the command is looped, remaining passes replay recorded ops instead of
+// decoding argv[] again.
+//
+// "high", "low" and "toggle" on pins which are not reconfigured anywhere in the command (no "in", "out",
+// "pwm", "matrix" etc) are replayed as direct writes to GPIO_OUT_W1TS / GPIO_OUT_W1TC registers: pin
+// output was enabled on the first pass by digitalForceWrite()
+//
+#define PIN_OP_HIGH     0   // digitalForceWrite()
+#define PIN_OP_LOW      1
+#define PIN_OP_TOGGLE   2
+#define PIN_OP_MODE     3   // pinForceMode() : /arg/ is a flag to add (INPUT, PULLUP etc)
+#define PIN_OP_DELAY    4   // delay_interruptible() : /arg/ is milliseconds
+#define PIN_OP_READ     5   // digitalForceRead()
+#define PIN_OP_AREAD    6   // analogRead()
+#define PIN_OP_HOLD     7
+#define PIN_OP_RELEASE  8
+#define PIN_OP_RESET    9
+#define PIN_OP_SAVE     10
+#define PIN_OP_LOAD     11
+#define PIN_OP_IOMUX    12  // /arg/ is IO_MUX function
+#define PIN_OP_MATRIX   13  // keywords with arguments: cmd_pin_...() is called with /argi/ as a start index
+#define PIN_OP_PWM      14
+#define PIN_OP_SEQ      15
+#define PIN_OP_FHIGH    16  // register writes: /reg/ is W1TS or W1TC register, /arg/ is a pin bitmask
+#define PIN_OP_FLOW     17
+#define PIN_OP_FTOGGLE  18
+
+// How often looped "pin" commands without "delay" check for a keypress or for the "kill" command, passes
+#define PIN_KILLPOINT   64
+
+struct pin_op {
+  uint8_t  code;   // PIN_OP_HIGH ...
+  uint8_t  pin;    // GPIO number
+  uint16_t argi;   // index in argv[], for PIN_OP_MATRIX, _PWM and _SEQ
+  uint32_t arg;    // flags, milliseconds, IO_MUX function or a pin bitmask
+  uint32_t reg;    // register address for PIN_OP_FHIGH and PIN_OP_FLOW
+};
+
+// Write GPIO_OUT_W1TS / GPIO_OUT_W1TC registers. GPIO32 and above are in the second register bank
+//
+static INLINE void pins_write(uint64_t set, uint64_t clr) {
+
+  if ((uint32_t)set) REG_WRITE(GPIO_OUT_W1TS_REG, (uint32_t)set);
+  if ((uint32_t)clr) REG_WRITE(GPIO_OUT_W1TC_REG, (uint32_t)clr);
+#if SOC_GPIO_PIN_COUNT > 32
+  if (set >> 32)     REG_WRITE(GPIO_OUT1_W1TS_REG, (uint32_t)(set >> 32));
+  if (clr >> 32)     REG_WRITE(GPIO_OUT1_W1TC_REG, (uint32_t)(clr >> 32));
+#endif
+}
+
+// Current output levels (GPIO_OUT registers) and input levels (GPIO_IN registers) of all pins
+//
+static INLINE uint64_t pins_out() {
+#if SOC_GPIO_PIN_COUNT > 32
+  return REG_READ(GPIO_OUT_REG) | ((uint64_t)REG_READ(GPIO_OUT1_REG) << 32);
+#else
+  return REG_READ(GPIO_OUT_REG);
+#endif
+}
+
+static INLINE uint64_t pins_in() {
+#if SOC_GPIO_PIN_COUNT > 32
+  return REG_READ(GPIO_IN_REG) | ((uint64_t)REG_READ(GPIO_IN1_REG) << 32);
+#else
+  return REG_READ(GPIO_IN_REG);
+#endif
+}
+
+// Replace "high", "low" and "toggle" ops with register writes, where possible.
+// Called once, after the first pass of a looped "pin" command
+//
+static void pin_ops_optimize(struct pin_op *ops, int n) {
+
+  uint64_t slow = 0;
+  int i;
+
+  // Pins which are reconfigured by the command must go through digitalForceWrite()
+  for (i = 0; i < n; i++)
+    if (ops[i].code > PIN_OP_TOGGLE && ops[i].code != PIN_OP_DELAY && ops[i].code != PIN_OP_READ)
+      slow |= 1ULL << ops[i].pin;
+
+  for (i = 0; i < n; i++) {
+
+    struct pin_op *op = &ops[i];
+
+    if (op->code > PIN_OP_TOGGLE || (slow & (1ULL << op->pin)) || !pin_isreal(op->pin))
+      continue;
+#if SOC_GPIO_PIN_COUNT > 32
+    if (op->pin > 31) {
+      op->arg = 1UL << (op->pin - 32);
+      op->reg = op->code == PIN_OP_HIGH ? GPIO_OUT1_W1TS_REG : GPIO_OUT1_W1TC_REG;
+    } else
+#endif
+    {
+      op->arg = 1UL << op->pin;
+      op->reg = op->code == PIN_OP_HIGH ? GPIO_OUT_W1TS_REG : GPIO_OUT_W1TC_REG;
+    }
+    op->code += PIN_OP_FHIGH;
+  }
+}
+
+// Replay recorded ops. /flags/ are accumulated the same way the first pass does.
+// Returns 0 on success, -1 if interrupted by a keypress or the "kill" command, or a cmd_pin_...() error code
+//
+static int pin_ops_run(const struct pin_op *ops, int n, int argc, char **argv, unsigned int *flags) {
+
+  const struct pin_op *op;
+  unsigned int j;
+  uint64_t t;
+  int ret;
+
+  for (op = ops; op < ops + n; op++) {
+    switch (op->code) {
+      case PIN_OP_FHIGH:
+      case PIN_OP_FLOW:    REG_WRITE(op->reg, op->arg);
+                           *flags |= OUTPUT_ONLY;
+                           continue;
+      case PIN_OP_FTOGGLE: t = pins_out() & (1ULL << op->pin);
+                           pins_write((1ULL << op->pin) & ~t, t);
+                           *flags |= OUTPUT_ONLY;
+                           continue;
+      case PIN_OP_HIGH:
+      case PIN_OP_LOW:     *flags |= OUTPUT_ONLY;
+                           digitalForceWrite(op->pin, op->code == PIN_OP_HIGH);
+                           continue;
+      case PIN_OP_TOGGLE:  *flags |= OUTPUT_ONLY;
+                           digitalForceWrite(op->pin, digitalForceRead(op->pin) ^ 1);
+                           continue;
+      case PIN_OP_MODE:    pinForceMode(op->pin, (*flags |= op->arg));
+                           continue;
+      case PIN_OP_DELAY:   if (delay_interruptible(op->arg) != op->arg)
+                             return -1;
+                           continue;
+      case PIN_OP_READ:    q_printf("%% GPIO%d : digital %d\r\n", op->pin, digitalForceRead(op->pin));
+                           continue;
+      case PIN_OP_AREAD:   q_printf("%% GPIO%d : analog %d\r\n", op->pin, analogRead(op->pin));
+                           continue;
+      case PIN_OP_HOLD:    gpio_hold_en((gpio_num_t)op->pin);
+#if SOC_GPIO_SUPPORT_HOLD_IO_IN_DSLP && !SOC_GPIO_SUPPORT_HOLD_SINGLE_IO_IN_DSLP
+                           gpio_deep_sleep_hold_en();
+#endif
+                           continue;
+      case PIN_OP_RELEASE:
+#if SOC_GPIO_SUPPORT_HOLD_IO_IN_DSLP && !SOC_GPIO_SUPPORT_HOLD_SINGLE_IO_IN_DSLP
+                           gpio_deep_sleep_hold_dis();
+#endif
+                           gpio_hold_dis((gpio_num_t)op->pin);
+                           continue;
+      case PIN_OP_RESET:   pin_reset(op->pin);
+                           continue;
+      case PIN_OP_SAVE:    pin_save(op->pin);
+                           continue;
+      case PIN_OP_LOAD:    pin_load(op->pin);
+                           continue;
+      case PIN_OP_IOMUX:   pin_set_iomux_function(op->pin, op->arg);
+                           continue;
+      case PIN_OP_MATRIX:  j = op->argi;
+                           ret = cmd_pin_matrix(argc, argv, op->pin, &j);
+                           break;
+      case PIN_OP_PWM:     j = op->argi;
+                           ret = cmd_pin_pwm(argc, argv, op->pin, &j);
+                           break;
+      case PIN_OP_SEQ:     j = op->argi;
+                           ret = cmd_pin_sequence(argc, argv, op->pin, &j);
+                           break;
+      default:             MUST_NOT_HAPPEN(true);
+                           continue;
+    }
+    if (ret != 0)
+      return ret;
+  }
+  return 0;
+}
+
 // handles "pin X ... loop COUNT"
 // Since pin is multiple-argument command we also pass the /start/ index into argv[] array
 // TODO: make COUNT arg to "loop" optional. Omitted count means "loop forever"
@@ -1171,8 +1348,8 @@ static int cmd_pin_loop(int argc, char **argv,unsigned int pin, unsigned int *st
 // "pin NUM arg1 arg2 .. argn"
 //
 // Big fat "pin" command. Processes multiple arguments
-// TODO: Caching of arguments for looped commands: should we use some sort of microcode
-// TODO: process "pin 1 2 3 low 4 5 6 high" correctly via pin bitmap
+// Looped commands are decoded only once: see pin_ops_run()
+// NOTE: Simultaneous updates of multiple pins ("pin 1 2 3 low 4 5 6 high") are done by cmd_pins() ("pins" command)
 //
 static int cmd_pin(int argc, char **argv) {
 
@@ -1190,6 +1367,12 @@ static int cmd_pin(int argc, char **argv) {
 
   unsigned int count = 1; // Command loop count: default value is "run once"
 
+  struct pin_op ops[argc], *op; // Keywords executed on the first pass, at most one op per keyword
+  int nops = 0;                 // Number of ops recorded
+
+// Record a keyword to be replayed by looped commands
+#define OP(_Code) (op = &ops[nops++], op->code = (_Code), op->pin = pin, op)
+
   // "pin" without arguments shows a valid GPIO range
   if (argc < 2) {
     pin_not_exist_notice(99);
@@ -1203,205 +1386,496 @@ static int cmd_pin(int argc, char **argv) {
   
   bool seen_delay = false; // seen "delay" keyword?
 
-  // Repeat whole "pin" command /count/ times; /count/ can be set by the "loop" keyword.
-  while ( true ) {
-
-    // Run through "pin NUM arg1, arg2 ... argN" arguments, looking for keywords to execute.
-    // Abort if there were errors during next keywords processing. TODO: make "abort"/"gnore" be selectable
-    while (i < argc) {
-
-      int ret;
-      bool has3;  // do we have 3 letters of the keyword?
-      unsigned char level;  // used by "low", "high"
-
-      // has3 == true if memory at argv[i][2] is readable (possibly containing '\0')
-      has3 = (X(1) && X(2));
+  // First pass: run through "pin NUM arg1, arg2 ... argN" arguments, looking for keywords to execute and record them
+  // Abort if there were errors during next keywords processing. TODO: make "abort"/"gnore" be selectable
+  while (i < argc) {
 
-      // Decode next keyword by looking at certain characters
-      switch (X(0)) {
-        // A pin number
-        case '0' ... '9': 
-                  if (!pin_exist_silent((pin = /*q_atol(argv[i], DEF_BAD)*/atoi2(argv[i]))))
+    int ret;
+    bool has3;  // do we have 3 letters of the keyword?
+    unsigned char level;  // used by "low", "high"
+
+    // has3 == true if memory at argv[i][2] is readable (possibly containing '\0')
+    has3 = (X(1) && X(2));
+
+    // Decode next keyword by looking at certain characters
+    switch (X(0)) {
+      // A pin number
+      case '0' ... '9': 
+                if (!pin_exist_silent((pin = /*q_atol(argv[i], DEF_BAD)*/atoi2(argv[i]))))
+                  return i;
+                break;
+      // aread
+      case 'a' : 
+                q_printf("%% GPIO%d : analog %d\r\n", pin, analogRead(pin));
+                OP(PIN_OP_AREAD);
+                break;
+      // down 
+      case 'd' : 
+                if (X(1) == 'o') {
+                  pinForceMode(pin, (flags |= PULLDOWN));
+                  OP(PIN_OP_MODE)->arg = PULLDOWN;
+                } else {
+      // delay TIME_MS (Creates *interruptible* delay for X milliseconds.)
+
+                  int duration;
+
+                  if ((i + 1) >= argc) {
+                    HELP(q_print("% <e>Delay value expected after keyword \"delay\"</>\r\n"));
                     return i;
-                  break;
-        // aread
-        case 'a' : 
-                  q_printf("%% GPIO%d : analog %d\r\n", pin, analogRead(pin));
-                  break;
-        // down 
-        case 'd' : 
-                  if (X(1) == 'o') {
-                    pinForceMode(pin, (flags |= PULLDOWN));
-                  } else {
-        // delay TIME_MS (Creates *interruptible* delay for X milliseconds.)
-
-                    int duration;
-
-                    if ((i + 1) >= argc) {
-                      HELP(q_print("% <e>Delay value expected after keyword \"delay\"</>\r\n"));
-                      return i;
-                    }
-                    i++;
-
-                    duration = atoi(argv[i]);
-                    // Display a hint for the first time when delay is longer than 5 seconds.
-                    // Any key works instead of <Enter> but Enter works in Arduino Serial Monitor
-                    if (!informed && is_fore && (duration > TOO_LONG)) {
-                      informed = true;
-                      HELP(q_print("% <g>Hint: Press [Enter] to interrupt the command</>\r\n"));
-                    }
-                    seen_delay = true;
-                    // Was interrupted by a keypress or by the "kill" command? Abort whole command then.
-                    // For interrupted duration of 0 (i.e. when duration is <1) the returned value is 0xffffffff
-                    if (delay_interruptible(duration) != duration) {
+                  }
+                  i++;
+
+                  duration = atoi(argv[i]);
+                  // Display a hint for the first time when delay is longer than 5 seconds.
+                  // Any key works instead of <Enter> but Enter works in Arduino Serial Monitor
+                  if (!informed && is_fore && (duration > TOO_LONG)) {
+                    informed = true;
+                    HELP(q_print("% <g>Hint: Press [Enter] to interrupt the command</>\r\n"));
+                  }
+                  seen_delay = true;
+                  OP(PIN_OP_DELAY)->arg = duration;
+                  // Was interrupted by a keypress or by the "kill" command? Abort whole command then.
+                  // For interrupted duration of 0 (i.e. when duration is <1) the returned value is 0xffffffff
+                  if (delay_interruptible(duration) != duration) {
 has_been_interrupted:                      
-                      HELP(q_printf("%% Command \"%s\" has been interrupted\r\n", argv[0]));
-                      // TODO: return CMD_FAILED ?
-                      return 0;
-                    }
+                    HELP(q_printf("%% Command \"%s\" has been interrupted\r\n", argv[0]));
+                    // TODO: return CMD_FAILED ?
+                    return 0;
                   }
-                  break;
-        // hold
-        case 'h' : 
-                  if (unlikely(X(1) == 'o')) {
-                    gpio_hold_en((gpio_num_t)pin);
+                }
+                break;
+      // hold
+      case 'h' : 
+                if (unlikely(X(1) == 'o')) {
+                  gpio_hold_en((gpio_num_t)pin);
+                  OP(PIN_OP_HOLD);
 #if SOC_GPIO_SUPPORT_HOLD_IO_IN_DSLP && !SOC_GPIO_SUPPORT_HOLD_SINGLE_IO_IN_DSLP                    
-                    gpio_deep_sleep_hold_en();
+                  gpio_deep_sleep_hold_en();
 #endif                    
-                  } else {
-        // high
-                    level = 1;
+                } else {
+      // high
+                  level = 1;
 pin_set_level:
-                    if (pin_is_input_only_pin(pin)) {
-                      q_printf("%% <e>Pin %u is **INPUT-ONLY**, can not be set \"%s\"</>\r\n", pin, argv[i]);
-                      return i;
-                    }
-                    // use pinForceMode/digitalForceWrite to not let the pin to be reconfigured (bypass PeriMan)
-                    // pinForceMode is not needed because ForceWrite does it
-                    flags |= OUTPUT_ONLY;
-                    digitalForceWrite(pin, level);
-                  }
-                  break;
-        // in 
-        case 'i' :
-                  if (likely(X(1) != 'o')) {
-                    pinForceMode(pin, (flags |= INPUT));
-                  } else {
-        // iomux [FUNCTION | gpio]
-                    unsigned char function = 0; 
-
-                    // if we have extra arguments, then treat number as IO_MUX function, treat text as special case. 
-                    if ((i+1) < argc)
-                      function = q_atol(argv[++i],PIN_FUNC_PAD_SELECT_GPIO); 
-                    pin_set_iomux_function(pin, function);
-                  }
-                  break;
-        // loop
-        case 'l' : //TODO: rearrange "loop" and "low", "low" must be first, as more frequent 
-                  if (has3 && X(2) == 'o') {
-                    if ((ret = cmd_pin_loop(argc,argv,pin,&i,&count)) != 0)
-                      return ret;
-                    argc -= 2; // Strip "loop COUNT" arguments. We read them only once and 
-                               // do not want to read same number on the next pass
-                  } else if (has3 && X(2) == 'a') {
-        // load
-                    pin_load(pin);
-                  } else {
-        // low
-                    level = 0;
-                    goto pin_set_level;
+                  if (pin_is_input_only_pin(pin)) {
+                    q_printf("%% <e>Pin %u is **INPUT-ONLY**, can not be set \"%s\"</>\r\n", pin, argv[i]);
+                    return i;
                   }
-                  break;
-        // matrix [in|out NUMBER] | gpio                  
-        case 'm' : 
-                  if ((ret = cmd_pin_matrix(argc,argv,pin,&i)) != 0)
-                    return ret;
-                  break;
-        // out
-        case 'o' : 
-                  if (likely(X(1) != 'p'))
-                    flags |= OUTPUT_ONLY;
-                  else
-        // open
-                    flags |= OPEN_DRAIN;
-                  pinForceMode(pin, flags);
-                  break;
-
-        // pwm FREQ DUTY                  
-        case 'p' : 
-                  if ((ret = cmd_pin_pwm(argc,argv,pin,&i)) != 0)
+                  // use pinForceMode/digitalForceWrite to not let the pin to be reconfigured (bypass PeriMan)
+                  // pinForceMode is not needed because ForceWrite does it
+                  flags |= OUTPUT_ONLY;
+                  digitalForceWrite(pin, level);
+                  OP(X(0) == 't' ? PIN_OP_TOGGLE : (level ? PIN_OP_HIGH : PIN_OP_LOW));
+                }
+                break;
+      // in 
+      case 'i' :
+                if (likely(X(1) != 'o')) {
+                  pinForceMode(pin, (flags |= INPUT));
+                  OP(PIN_OP_MODE)->arg = INPUT;
+                } else {
+      // iomux [FUNCTION | gpio]
+                  unsigned char function = 0; 
+
+                  // if we have extra arguments, then treat number as IO_MUX function, treat text as special case. 
+                  if ((i+1) < argc)
+                    function = q_atol(argv[++i],PIN_FUNC_PAD_SELECT_GPIO); 
+                  pin_set_iomux_function(pin, function);
+                  OP(PIN_OP_IOMUX)->arg = function;
+                }
+                break;
+      // loop
+      case 'l' : //TODO: rearrange "loop" and "low", "low" must be first, as more frequent 
+                if (has3 && X(2) == 'o') {
+                  if ((ret = cmd_pin_loop(argc,argv,pin,&i,&count)) != 0)
                     return ret;
-                  break;
-        // release
-        case 'r' : 
-                  if (has3 && X(2) == 'l') {
+                  argc -= 2; // Strip "loop COUNT" arguments. We read them only once and 
+                             // do not want to read same number on the next pass
+                } else if (has3 && X(2) == 'a') {
+      // load
+                  pin_load(pin);
+                  OP(PIN_OP_LOAD);
+                } else {
+      // low
+                  level = 0;
+                  goto pin_set_level;
+                }
+                break;
+      // matrix [in|out NUMBER] | gpio                  
+      case 'm' : 
+                OP(PIN_OP_MATRIX)->argi = i;
+                if ((ret = cmd_pin_matrix(argc,argv,pin,&i)) != 0)
+                  return ret;
+                break;
+      // out or open
+      case 'o' : 
+                OP(PIN_OP_MODE)->arg = likely(X(1) != 'p') ? OUTPUT_ONLY : OPEN_DRAIN;
+                pinForceMode(pin, (flags |= op->arg));
+                break;
+
+      // pwm FREQ DUTY                  
+      case 'p' : 
+                OP(PIN_OP_PWM)->argi = i;
+                if ((ret = cmd_pin_pwm(argc,argv,pin,&i)) != 0)
+                  return ret;
+                break;
+      // release
+      case 'r' : 
+                if (has3 && X(2) == 'l') {
 #if SOC_GPIO_SUPPORT_HOLD_IO_IN_DSLP && !SOC_GPIO_SUPPORT_HOLD_SINGLE_IO_IN_DSLP                    
-                    gpio_deep_sleep_hold_dis();
+                  gpio_deep_sleep_hold_dis();
 #endif                    
-                    gpio_hold_dis((gpio_num_t)pin);
-                  } else if (has3 && X(2) == 's')
-        // reset
-                    pin_reset(pin);
-                  else
-        // read
-                    q_printf("%% GPIO%d : digital %d\r\n", pin, digitalForceRead(pin));
-                  break;
-
-        // seq NUMBER
-        case 's' :
-                  if (X(1) == 'e') {
-                    if ((ret = cmd_pin_sequence(argc,argv,pin,&i)) != 0)
-                      return ret;
-                  } else
-        // save
-                  pin_save(pin);
-                  break;
-        // toggle
-        case 't' :
-                  level = digitalForceRead(pin) ^ 1;
-                  goto pin_set_level;
-        // up
-        case 'u' : 
-                  pinForceMode(pin, (flags |= PULLUP));
-                  break;
-                  
-        // all other stuff which we don't understand
-        default: return i;
-      };
-      i++;  // next keyword
-    }       // big fat "while (i < argc)"
-
-    // Only decrement and check count value if it is not zero.
-    // Value of zero means "infinity" so while() loop must be infinite as well
-    if (count)
-      if (--count == 0)
-        break;
+                  gpio_hold_dis((gpio_num_t)pin);
+                  OP(PIN_OP_RELEASE);
+                } else if (has3 && X(2) == 's')
+      // reset
+                  pin_reset(pin), OP(PIN_OP_RESET);
+                else
+      // read
+                  q_printf("%% GPIO%d : digital %d\r\n", pin, digitalForceRead(pin)), OP(PIN_OP_READ);
+                break;
+
+      // seq NUMBER
+      case 's' :
+                if (X(1) == 'e') {
+                  OP(PIN_OP_SEQ)->argi = i;
+                  if ((ret = cmd_pin_sequence(argc,argv,pin,&i)) != 0)
+                    return ret;
+                } else
+      // save
+                pin_save(pin), OP(PIN_OP_SAVE);
+                break;
+      // toggle
+      case 't' :
+                level = digitalForceRead(pin) ^ 1;
+                goto pin_set_level;
+      // up
+      case 'u' : 
+                pinForceMode(pin, (flags |= PULLUP));
+                OP(PIN_OP_MODE)->arg = PULLUP;
+                break;
+                
+      // all other stuff which we don't understand
+      default: return i;
+    };
+    i++;  // next keyword
+  }       // big fat "while (i < argc)"
+
+  // Not looped?
+  if (count == 1)
+    return 0;
 
-    // prepare to start over again from argv[1]      
-    i = 1;
+  pin_ops_optimize(ops, nops);
 
-    // A killpoint for looped foreground commands:
-    // Give a chance to cancel whole command if it is looped, before going for the next cycle
-    // TODO: only if there were no "delay" which is TOO_LONG
-    if (is_fore) {
-      if (anykey_pressed())
-        goto has_been_interrupted;
-    } else
-    // A killpoint for looped bg commands, which have no "delay" statement
-    // e.g. "pin 2 low high loop infinite &". Otherwise we have to "kill -9" instead of "kill".
-    // A killpoint decreases "pin 2 low high loop infinite &" performance from 354kHz down to 151kHz
-    if (!seen_delay) {
-      uint32_t sig = 0; 
-      if (task_wait_for_signal(&sig,0)) {
-        //q_print("% Termination signal\r\n");
-        if (sig == SIGNAL_TERM || sig == SIGNAL_KILL)
+  // Remaining passes: replay recorded ops. Value of zero means "infinity" so while() loop must be infinite as well
+  unsigned int passes = 1;
+  uint64_t t0 = q_micros();
+
+  while (!count || --count) {
+
+    // A killpoint for looped commands: give a chance to cancel whole command before going for the next cycle.
+    // Commands with "delay" are interrupted by delay_interruptible() itself, so these are checked on every pass
+    // only to be responsive to a keypress. Commands without "delay" (e.g. "pin 2 low high loop infinite &")
+    // check once per PIN_KILLPOINT passes: a killpoint on every pass decreased the rate from 354kHz down to 151kHz
+    if (seen_delay || !(passes % PIN_KILLPOINT)) {
+      if (is_fore) {
+        if (anykey_pressed())
           goto has_been_interrupted;
+      } else if (!seen_delay) {
+        uint32_t sig = 0; 
+        if (task_wait_for_signal(&sig,0))
+          if (sig == SIGNAL_TERM || sig == SIGNAL_KILL)
+            goto has_been_interrupted;
       }
     }
-  } // while ( true )
+
+    int ret = pin_ops_run(ops, nops, argc, argv, &flags);
+    if (ret < 0)
+      goto has_been_interrupted;
+    if (ret > 0)
+      return ret;
+    passes++;
+  }
+
+  // Loop rate: e.g. "pin 2 high low loop 100000" reports how many CPU cycles one high+low pair takes
+  t0 = q_micros() - t0;
+  VERBOSE(q_printf("%% %u passes, %llu CPU cycles per pass\r\n", passes, t0 * CPUFreq / (passes - 1)));
   return 0;
+#undef OP
 #undef X
 }
 
+// -- Batched multi-pin operations --
+//
+// "pins MASK [MASK] high|low|toggle|in|out|up|down|open|read|delay MS|loop COUNT ..."
+//
+// Unlike "pin", which processes one pin at a time, "pins" operates on groups of pins. A MASK is either
+// a 64-bit bitmask ("0x300034", "0b110100") or a list of GPIO numbers and ranges ("2,4,5", "12-15").
+// Every MASK selects a new group of pins for the keywords which follow it.
+//
+// The command is compiled once into an array of ops. Levels are set with direct writes to GPIO_OUT_W1TS
+// and GPIO_OUT_W1TC registers: all pins of the group change their level at once, with no HAL calls.
+// Adjacent "high" and "low" on non-overlapping groups are merged into a single op: "pins 2,4 high 5 low"
+// is one W1TS write followed by one W1TC write.
+//
+#define PINS_OP_WRITE  0  // set and/or clear
+#define PINS_OP_TOGGLE 1  // invert output levels
+#define PINS_OP_MODE   2  // pinForceMode() for every pin of the group
+#define PINS_OP_READ   3  // read and display levels
+#define PINS_OP_DELAY  4  // delay, milliseconds
+
+// How often looped "pins" commands check for a keypress or for the "kill" command, passes
+#define PINS_KILLPOINT 64
+
+struct pins_op {
+  uint8_t  code;   // PINS_OP_WRITE ...
+  uint32_t arg;    // flags for PINS_OP_MODE, milliseconds for PINS_OP_DELAY
+  uint64_t set;    // pins to set (PINS_OP_WRITE); pins to operate on (all other ops)
+  uint64_t clr;    // pins to clear (PINS_OP_WRITE)
+};
+
+// Parse a group of pins: "0x34", "0b110100" or "2,4,5", "12-15,18"
+// Returns /false/ if the mask is malformed or mentions GPIOs which do not exist
+//
+static bool pins_parse_mask(const char *p, uint64_t *pmask) {
+
+  unsigned int from, to;
+  uint64_t m = 0;
+  int pin;
+
+  if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X' || p[1] == 'b' || p[1] == 'B')) {
+    if ((m = q_atoll(p, 0)) == 0)
+      return false;
+  } else
+    while (*p) {
+      if (*p < '0' || *p > '9')
+        return false;
+      from = to = strtoul(p, (char **)&p, 10);
+      if (*p == '-') {
+        p++;
+        if (*p < '0' || *p > '9')
+          return false;
+        to = strtoul(p, (char **)&p, 10);
+      }
+      if (*p == ',')
+        p++;
+      else if (*p)
+        return false;
+      if (from > to || to > 63)
+        return false;
+      while (from <= to)
+        m |= 1ULL << from++;
+    }
+
+  for (uint64_t t = m; t; t &= t - 1)
+    if (!pin_exist_silent((pin = __builtin_ctzll(t)))) {
+      q_printf("%% <e>GPIO%d does not exist</>\r\n", pin);
+      return false;
+    }
+
+  *pmask = m;
+  return m != 0;
+}
+
+// Compile "pins" arguments into an array of ops. /ops/ must have room for /argc/ entries
+// Returns number of ops compiled or a negative index of the bad argument. /*count/ is set by "loop",
+// /*wmask/ receives all the pins which are written to (their outputs must be enabled)
+//
+static int pins_compile(int argc, char **argv, struct pins_op *ops, unsigned int *count, uint64_t *wmask) {
+
+  uint64_t pmask = 0;
+  unsigned int flags = 0;
+  int i, n = 0;
+  struct pins_op *op;
+
+  *wmask = 0;
+
+  for (i = 1; i < argc; i++) {
+
+    const char *p = argv[i];
+
+    // New group of pins
+    if (p[0] >= '0' && p[0] <= '9') {
+      if (!pins_parse_mask(p, &pmask))
+        return -i;
+      continue;
+    }
+
+    if (!pmask) {
+      HELP(q_print("% <e>A pin mask or a list of pins is expected first</>\r\n"));
+      return -i;
+    }
+
+    if (!q_strcmp(p, "high") || !q_strcmp(p, "low") || !q_strcmp(p, "toggle")) {
+
+      for (uint64_t t = pmask; t; t &= t - 1)
+        if (pin_is_input_only_pin(__builtin_ctzll(t))) {
+          q_printf("%% <e>Pin %u is **INPUT-ONLY**, can not be set \"%s\"</>\r\n", __builtin_ctzll(t), p);
+          return -i;
+        }
+      *wmask |= pmask;
+
+      if (p[0] == 't') {
+        op = &ops[n++];
+        op->code = PINS_OP_TOGGLE;
+        op->set = pmask;
+        continue;
+      }
+
+      // Merge with the previous write if pins do not overlap: the order of writes would matter otherwise
+      op = (n && ops[n - 1].code == PINS_OP_WRITE && !((ops[n - 1].set | ops[n - 1].clr) & pmask)) ? &ops[n - 1] : NULL;
+      if (!op) {
+        op = &ops[n++];
+        op->code = PINS_OP_WRITE;
+        op->set = op->clr = 0;
+      }
+      if (p[0] == 'h')
+        op->set |= pmask;
+      else
+        op->clr |= pmask;
+      continue;
+    }
+
+    op = &ops[n];
+
+    if (!q_strcmp(p, "in"))        flags |= INPUT; else
+    if (!q_strcmp(p, "out"))       flags |= OUTPUT_ONLY; else
+    if (!q_strcmp(p, "up"))        flags |= PULLUP; else
+    if (!q_strcmp(p, "down"))      flags |= PULLDOWN; else
+    if (!q_strcmp(p, "open"))      flags |= OPEN_DRAIN; else
+    if (!q_strcmp(p, "read")) {
+      op->code = PINS_OP_READ;
+      op->set = pmask;
+      n++;
+      continue;
+    } else if (!q_strcmp(p, "delay")) {
+      if (i + 1 >= argc || (op->arg = q_atol(argv[i + 1], DEF_BAD)) == DEF_BAD) {
+        HELP(q_print("% <e>Delay value (milliseconds) is expected after \"delay\"</>\r\n"));
+        return -i;
+      }
+      op->code = PINS_OP_DELAY;
+      n++;
+      i++;
+      continue;
+    } else if (!q_strcmp(p, "loop")) {
+      if (i + 2 != argc) {
+        HELP(q_print("% <e>\"loop COUNT\" must be the last keyword</>\r\n"));
+        return -i;
+      }
+      *count = q_atol(argv[++i], 0); // "infinite" and other non-numbers are 0, i.e. infinite loop
+      continue;
+    } else
+      return -i;
+
+    // Mode keywords: flags accumulate, as in "pin" command
+    op->code = PINS_OP_MODE;
+    op->arg = flags;
+    op->set = pmask;
+    n++;
+  }
+
+  return n;
+}
+
+// Execute a single pass. Returns /false/ if a delay was interrupted
+//
+static bool pins_run(const struct pins_op *ops, int n) {
+
+  const struct pins_op *op;
+  uint64_t t;
+
+  for (op = ops; op < ops + n; op++)
+    switch (op->code) {
+      case PINS_OP_WRITE:
+        pins_write(op->set, op->clr);
+        break;
+      case PINS_OP_TOGGLE:
+        t = pins_out();
+        pins_write(~t & op->set, t & op->set);
+        break;
+      case PINS_OP_MODE:
+        for (t = op->set; t; t &= t - 1)
+          pinForceMode(__builtin_ctzll(t), op->arg);
+        break;
+      case PINS_OP_READ:
+        t = pins_in();
+        q_printf("%% GPIO mask 0x%llx : levels 0x%llx\r\n", (unsigned long long)op->set, (unsigned long long)(t & op->set));
+        break;
+      case PINS_OP_DELAY:
+        if (delay_interruptible(op->arg) != op->arg)
+          return false;
+        break;
+      default:
+        MUST_NOT_HAPPEN(true);
+    }
+  return true;
+}
+
+// "pins MASK [MASK] high|low|toggle|in|out|up|down|open|read|delay MS|loop COUNT ..."
+//
+static int cmd_pins(int argc, char **argv) {
+
+  struct pins_op ops[argc];
+  unsigned int count = 1, passes = 0, i;
+  uint64_t wmask, t0;
+  bool is_fore = is_foreground_task(), interrupted = false;
+  int n;
+
+  if (argc < 3)
+    return CMD_MISSING_ARG;
+
+  if ((n = pins_compile(argc, argv, ops, &count, &wmask)) < 0)
+    return -n;
+
+  // Enable outputs once, before the first pass. "pin" does it on every write (digitalForceWrite())
+  for (; wmask; wmask &= wmask - 1) {
+    i = __builtin_ctzll(wmask);
+    gpio_ll_output_enable(&GPIO, i);
+  }
+
+  if (count != 1)
+    HELP(q_printf("%% Repeating %s, %s to abort\r\n", count ? "whole command" : "infinitely", is_fore ? "press <Enter>" : "use \"kill\""));
+
+  t0 = q_micros();
+
+  while (true) {
+
+    if (!pins_run(ops, n)) {
+      interrupted = true;
+      break;
+    }
+    passes++;
+
+    if (count && --count == 0)
+      break;
+
+    // Killpoint, not on every pass: for looped commands without delays this is the most expensive part
+    if (!(passes % PINS_KILLPOINT)) {
+      if (is_fore) {
+        if (anykey_pressed()) {
+          interrupted = true;
+          break;
+        }
+      } else {
+        uint32_t sig = 0;
+        if (task_wait_for_signal(&sig, 0) && (sig == SIGNAL_TERM || sig == SIGNAL_KILL)) {
+          interrupted = true;
+          break;
+        }
+      }
+    }
+  }
+
+  if (interrupted)
+    HELP(q_printf("%% Command \"%s\" has been interrupted\r\n", argv[0]));
+
+  // Loop rate, useful to compare with "pin"
+  if (passes > 1) {
+    t0 = q_micros() - t0;
+    VERBOSE(q_printf("%% %u passes in %llu us, %llu CPU cycles per pass\r\n", passes, t0, t0 * CPUFreq / passes));
+  }
+
+  return 0;
+}
+
 
 #endif // #if COMPILING_ESPSHELL
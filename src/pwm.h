@@ -19,14 +19,12 @@
 // (i.e. channel 0 & 1, 2 & 3, etc.) share the same frequency. This is because
 // there are only 4 timers per 8 channels.
 //
-// ESPShell uses EVEN channel numbers, ensuring that all PWM frequencies
-// are independent.
+// Channels are selected by the LEDC allocator (see pwm_alloc() below) which knows which channels are used
+// by ESPShell, the sketch and the camera. Channel which shares a timer with another output is only
+// used if both run at the same frequency and resolution, so all PWM frequencies stay independent.
 //
-// This approach, however, reduces the number of simultaneously active
-// generators from 8 to 4 (on ESP32-S3; from 16 to 8 on ESP32).
-// This behavior can be changed by setting /pwm_ch_inc/ to 1: you'll get
-// twice as many PWM channels, but adjacent channels will then run at
-// the same frequency.
+// By default (/pwm_ch_inc/ is 2) every output gets a timer of its own while there are free timers;
+// setting /pwm_ch_inc/ to 1 makes the allocator prefer sharing timers between outputs with equal frequencies.
 //
 // BUG: There is an issue where the ESP32 sometimes fails to start PWM at low
 //      frequencies (around 100 Hz).
@@ -155,30 +153,161 @@ static uint32_t pwm_source_clock_frequency() {
 
 
 
+// -- LEDC resource allocator --
+//
+// Arduino Core maps LEDC channels to timers statically: channels 2N and 2N+1 share the same timer, so a channel
+// "pair" always runs at the same frequency (and resolution). Channels above 7 belong to the second speed group
+// (ESP32 only) and use their own set of timers.
+//
+// Before every allocation ESPShell builds a map of all LEDC channels (pwm_map_build()): channels attached to pins
+// are found via the periman API (ours and sketch's), the camera's XCLK channel and timer are taken from
+// the camera module. Allocation itself (pwm_alloc()) is a pure function of that map.
+//
+#define PWM_FREE   0   // channel is free
+#define PWM_SHELL  1   // channel is used by ESPShell ("pwm" or "pin" commands)
+#define PWM_SKETCH 2   // channel is used by user sketch (attached by the sketch via ledcAttach())
+#define PWM_CAMERA 3   // channel (or its timer) is used by the camera to generate XCLK
+
+#define PWM_PARTNER(_Ch) ((_Ch) ^ 1)                    // channel which shares the timer
+#define PWM_TIMER(_Ch)   (((_Ch) / 2) % 4)               // timer number used by a channel (Arduino Core mapping)
+#define PWM_GROUP(_Ch)   ((_Ch) / SOC_LEDC_CHANNEL_NUM)  // LEDC speed mode of a channel (Arduino Core mapping)
+#define PWM_GCHAN(_Ch)   ((_Ch) % SOC_LEDC_CHANNEL_NUM)  // channel number within its speed mode
+
+struct pwm_map {
+  uint8_t  owner[PWM_CHANNELS_NUM];  // PWM_FREE, PWM_SHELL, ...
+  uint8_t  pin[PWM_CHANNELS_NUM];    // GPIO number (if owner is not PWM_FREE)
+  uint8_t  res[PWM_CHANNELS_NUM];    // duty resolution, bits
+  uint32_t freq[PWM_CHANNELS_NUM];   // frequency, Hz. 0 if unknown (camera)
+};
+
+static uint8_t pwm_own[PWM_CHANNELS_NUM] = { 0 }; // GPIO+1 for channels attached by ESPShell, 0 otherwise
+
+// Owner name for "show pwm"
+//
+static const char *pwm_owner_name(unsigned int owner) {
+  return owner == PWM_SHELL  ? "ESPShell" :
+         owner == PWM_SKETCH ? "Sketch"   :
+         owner == PWM_CAMERA ? "Camera"   : "Free";
+}
+
+// Build the LEDC resource map
+//
+static void pwm_map_build(struct pwm_map *m) {
+
+  uint8_t pin;
+  int ch;
+
+  memset(m, 0, sizeof(*m));
+
+  for (pin = 0; pin < NUM_PINS; pin++)
+    if (pin_exist_silent(pin)) {
+      ledc_channel_handle_t *bus;
+      if ((bus = (ledc_channel_handle_t *)perimanGetPinBus(pin, ESP32_BUS_TYPE_LEDC)) != NULL && bus->channel < PWM_CHANNELS_NUM) {
+        ch = bus->channel;
+        m->owner[ch] = pwm_own[ch] == pin + 1 ? PWM_SHELL : PWM_SKETCH;
+        m->pin[ch] = pin;
+        m->res[ch] = bus->channel_resolution;
+        m->freq[ch] = ledcReadFreq(pin);
+      }
+    }
+
+  // forget channels which were released by someone else (e.g. "pin X input")
+  for (ch = 0; ch < PWM_CHANNELS_NUM; ch++)
+    if (m->owner[ch] != PWM_SHELL)
+      pwm_own[ch] = 0;
+
+#if WITH_ESPCAM
+  // Camera uses its channel and its timer: the timer makes both channels of a pair unusable for us
+  unsigned int cam_chan, cam_timer;
+  if (espcam_ledc(&cam_chan, &cam_timer)) {
+    if (cam_chan < PWM_CHANNELS_NUM)
+      m->owner[cam_chan] = PWM_CAMERA;
+    if (cam_timer * 2 + 1 < PWM_CHANNELS_NUM) {
+      if (m->owner[cam_timer * 2] == PWM_FREE) m->owner[cam_timer * 2] = PWM_CAMERA;
+      if (m->owner[cam_timer * 2 + 1] == PWM_FREE) m->owner[cam_timer * 2 + 1] = PWM_CAMERA;
+    }
+  }
+#endif
+}
+
+// Can channel /ch/ run at /freq/ with /res/ bits of resolution without disturbing anyone?
+// /pin/ is the GPIO which is going to use the channel: its own channels don't count as conflicting.
+// Returns PWM_FREE if channel can be used or owner of the conflicting channel
+//
+static unsigned int pwm_conflict(const struct pwm_map *m, unsigned int ch, unsigned int pin, uint32_t freq, uint8_t res) {
+
+  unsigned int p = PWM_PARTNER(ch);
+
+  if (m->owner[ch] != PWM_FREE && m->pin[ch] != pin)
+    return m->owner[ch];
+
+  if (p < PWM_CHANNELS_NUM && m->owner[p] != PWM_FREE && m->pin[p] != pin)
+    if (m->owner[p] == PWM_CAMERA || m->freq[p] != freq || m->res[p] != res)
+      return m->owner[p];
+
+  return PWM_FREE;
+}
+
+// Select LEDC channel for /pin/ to generate /freq/ with /res/ bits of resolution.
+// Channel already used by this pin is preferred. Then, if /share/ is true, free channels whose partner runs at
+// the same frequency & resolution (timer sharing, more outputs) are preferred over channels with a free
+// partner (a timer of its own); if /share/ is false it is the other way around.
+//
+// Returns channel number or -1 if there are no suitable channels
+//
+static int pwm_alloc(const struct pwm_map *m, unsigned int pin, uint32_t freq, uint8_t res, bool share) {
+
+  int ch, pass;
+
+  for (ch = 0; ch < PWM_CHANNELS_NUM; ch++)
+    if (m->owner[ch] != PWM_FREE && m->pin[ch] == pin && pwm_conflict(m, ch, pin, freq, res) == PWM_FREE)
+      return ch;
+
+  for (pass = 0; pass < 2; pass++) {
+    bool want_partner = (pass == 0) == share;
+    for (ch = 0; ch < PWM_CHANNELS_NUM; ch++) {
+      bool partner = PWM_PARTNER(ch) < PWM_CHANNELS_NUM && m->owner[PWM_PARTNER(ch)] != PWM_FREE;
+      if (m->owner[ch] == PWM_FREE && partner == want_partner && pwm_conflict(m, ch, pin, freq, res) == PWM_FREE)
+        return ch;
+    }
+  }
+  return -1;
+}
+
+// Forget channels attached by ESPShell to /pin/
+//
+static void pwm_release(unsigned int pin) {
+  int ch;
+  for (ch = 0; ch < PWM_CHANNELS_NUM; ch++)
+    if (pwm_own[ch] == pin + 1)
+      pwm_own[ch] = 0;
+}
+
+
 // Enable (freq > 0) or disable (freq == 0) PWM generation on the given pin.
 //
 // Frequency must be in the range (0..10,000,000 Hz). Duty is a floating-point
 // value in the range [0..1]. Depending on the frequency, a different LEDC
 // resolution may be chosen (unless the /ledc_res/ config variable is set).
 //
-// If /chan/ is less than zero, the channel number is auto-selected.
-// Auto-selection is a simple round-robin over available PWM channels,
-// with increments of 1 or 2 (default).
+// If /chan/ is less than zero, the channel number is selected by the LEDC allocator (pwm_alloc()),
+// otherwise requested channel is checked for conflicts with other PWM outputs, the sketch and the camera.
 //
 // To change the frequency and/or duty on the same pin, there is no need
 // to "disable" PWM before calling "enable" again — it is safe to call
-// enable multiple times on the same pin/channel.
+// enable multiple times on the same pin/channel. Whenever possible the output is not detached:
+// a duty change is just a duty register write, a frequency change on a channel which does not share
+// its timer is a timer reconfiguration.
 //
 static int pwm_enable_channel(unsigned int pin, unsigned int freq, float duty, signed char chan) {
 
   unsigned int resolution;      // Channel duty resolution, bits
-  static int channel = 0;       // LEDC channel# to use
+  int channel;                  // LEDC channel# to use
   unsigned int duty_abs;        // Scaled duty parameter
   unsigned long ledc_clock = 0; // LEDC clock frequency.
-
-  // <0 means "auto"
-  if (chan >= 0)
-    channel = chan;
+  unsigned int owner;
+  struct pwm_map m;
+  ledc_channel_handle_t *bus;
 
   // Only real GPIOs can participiate in PWM generation
   if (!pin_exist(pin) || pin_isvirtual(pin))
@@ -188,6 +317,7 @@ static int pwm_enable_channel(unsigned int pin, unsigned int freq, float duty, s
   if (freq == 0) {
     ledcDetach(pin);
     pinMode(pin, OUTPUT);
+    pwm_release(pin);
     VERBOSE(q_print("% PWM is disabled\r\n"));
     return 0;
   }
@@ -230,55 +360,158 @@ print_hint_and_exit:
     }
   } else
     resolution = ledc_res;
-  VERBOSE(q_printf("%% Selected duty cycle resolution is %u bits, LEDC channel is %u\r\n",resolution, channel));  
 
   // Calculate the absolute duty value.
   // Duty is in the range [0..1], so we scale it to fit the desired bit width.
   //
   duty_abs = (unsigned int)(duty * (float )((1 << resolution) - 1) + 0.5f); //  roundup duty cycle value;
 
+  bus = (ledc_channel_handle_t *)perimanGetPinBus(pin, ESP32_BUS_TYPE_LEDC);
+
   // If the channel is already running at the requested PWM frequency,
   // just update the duty cycle — don't stop the output.
-  if (ledcReadFreq(pin) == freq) {
+  if (bus && (chan < 0 || chan == bus->channel) && ledcReadFreq(pin) == freq) {
     if (ledcWrite(pin, duty_abs)) {
       VERBOSE(q_printf("%% PWM on pin#%u, %u Hz (%.1f%% duty cycle) is enabled\r\n",pin,freq,duty * 100.0f));
       return 0;
     }
     // FALL THROUGH
   }
+
+  pwm_map_build(&m);
+
+  // Frequency change: if the channel does not share its timer with anyone, reconfigure the timer without
+  // detaching the pin
+  if (bus && (chan < 0 || chan == bus->channel) && bus->channel < PWM_CHANNELS_NUM &&
+      bus->channel_resolution == resolution &&
+      m.owner[bus->channel] == PWM_SHELL &&
+      (PWM_PARTNER(bus->channel) >= PWM_CHANNELS_NUM || m.owner[PWM_PARTNER(bus->channel)] == PWM_FREE)) {
+    if (ledcChangeFrequency(pin, freq, resolution) && ledcWrite(pin, duty_abs)) {
+      VERBOSE(q_printf("%% PWM on pin#%u, %u Hz (%.1f%% duty cycle, channel#%u) is enabled\r\n",pin,freq,duty * 100.0f, bus->channel));
+      return 0;
+    }
+    // FALL THROUGH
+  }
+
+  if (chan >= 0) {
+    // Explicitly requested channel: check for conflicts
+    if ((owner = pwm_conflict(&m, chan, pin, freq, resolution)) != PWM_FREE) {
+      unsigned int c = m.owner[chan] != PWM_FREE && m.pin[chan] != pin ? chan : PWM_PARTNER(chan);
+      q_printf("%% <e>LEDC channel %u can not be used: ", chan);
+      if (c == chan)
+        q_printf("it is used by the %s", pwm_owner_name(owner));
+      else
+        q_printf("it shares timer %u with channel %u (%s)", PWM_TIMER(chan), c, pwm_owner_name(owner));
+      q_print("</>\r\n");
+      HELP(q_print("% Use \"<i>show pwm</>\" to display LEDC channels map\r\n"));
+      return -1;
+    }
+    channel = chan;
+  } else if ((channel = pwm_alloc(&m, pin, freq, resolution, pwm_ch_inc == 1)) < 0) {
+    q_printf("%% <e>No free LEDC channels to generate %u Hz</>\r\n", freq);
+    HELP(q_print("% Use \"<i>show pwm</>\" to display LEDC channels map\r\n"));
+    return -1;
+  }
+
+  VERBOSE(q_printf("%% Selected duty cycle resolution is %u bits, LEDC channel is %u\r\n",resolution, channel));  
+
   // Full circuit:
   ledcDetach(pin);
+  pwm_release(pin);
   pinMode(pin, OUTPUT); // TODO: investigate if it can be replaced with pinForceMode(pin, OUTPUT_ONLY)
   
-  if (freq) {
-        
-    if (ledcAttachChannel(pin, freq, resolution, channel)) {
-      if (ledcWrite(pin, duty_abs)) {
-        VERBOSE(q_printf("%% PWM on pin#%u, %u Hz (%.1f%% duty cycle, channel#%u) is enabled\r\n",pin,freq,duty * 100.0f, channel));
-        
-        // Advance to the next channel.
-        // Setting pwm_ch_inc to 0 will cause channel number to remain the same unless 4th argument is passed
-        channel += pwm_ch_inc;
-        if (channel >= PWM_CHANNELS_NUM)
-          channel = 0;
-        else if (channel < 0)
-          channel = PWM_CHANNELS_NUM - 1;
-        
-        if (chan >= 0) { // 4th argument triggers helpline
-          HELP(q_printf("%% PWM channel %u is to be used next, if not explicitly set\r\n", channel));
-        }
-        return 0;
+  if (ledcAttachChannel(pin, freq, resolution, channel)) {
+    pwm_own[channel] = pin + 1;
+    if (ledcWrite(pin, duty_abs)) {
+      VERBOSE(q_printf("%% PWM on pin#%u, %u Hz (%.1f%% duty cycle, channel#%u) is enabled\r\n",pin,freq,duty * 100.0f, channel));
+      return 0;
+    }
+    ledcDetach(pin);
+    pwm_release(pin);
+    q_printf("%% Failed to set the absolute duty cycle value to %u\r\n",duty_abs);
+  } else
+    q_printf("%% Failed to attach to the LEDC (channel=%u, resolution=%u, freq=%u, duty_abs=%u)\r\n",channel,resolution,freq,duty_abs);
+
+  // Regardless of the failure reason, if the requested frequency is below
+  // 10 Hz, inform the user about alternative ways to generate low-frequency PWM.
+  goto print_hint_and_exit;
+}
+
+// Batched PWM: "pwm PIN1,PIN2,...,PINn FREQ [DUTY | DUTY1,DUTY2,...,DUTYn]"
+//
+// Pins which are not running at FREQ yet are (re)configured one by one. For pins which are already running at
+// FREQ new duty values are written to LEDC registers first and then latched by all channels in one pass, so
+// duty changes on all pins take effect (almost) simultaneously, without detach/attach glitches
+//
+#define PWM_BATCH_MAX 16
+
+static int pwm_batch(int argc, char **argv) {
+
+  uint8_t      pins[PWM_BATCH_MAX];
+  float        duty[PWM_BATCH_MAX];
+  uint8_t      chan[PWM_BATCH_MAX];   // channels whose duty is to be latched
+  unsigned int n = 0, nd = 0, nc = 0, i, freq = 0, pin;
+  const char  *p;
+  char         tok[16];
+  int          ret = 0;
+
+  // Pin list
+  for (p = argv[1]; *p; ) {
+    if (n >= PWM_BATCH_MAX) {
+      q_print("% <e>Too many pins</>\r\n");
+      return 1;
+    }
+    if ((p = q_nextitem(p, tok, sizeof(tok))) == NULL || !pin_exist((pin = q_atol(tok, BAD_PIN))) || pin_isvirtual(pin))
+      return 1;
+    pins[n++] = pin;
+  }
+
+  if (argc > 2)
+    freq = q_atol(argv[2], 0);
+
+  // Duty list: one value for all pins or a value per pin
+  if (argc > 3) {
+    for (p = argv[3]; *p && nd < PWM_BATCH_MAX; ) {
+      if ((p = q_nextitem(p, tok, sizeof(tok))) == NULL || (duty[nd] = q_atof(tok, -1)) < 0 || duty[nd] > 1) {
+        HELP(q_print("% <e>Duty cycle is a number in range [0..1] (default is 0.5, i.e. 50%)</>\r\n"));
+        return 3;
       }
-      ledcDetach(pin);
-      q_printf("%% Failed to set the absolute duty cycle value to %u\r\n",duty_abs);
-    } else
-      q_printf("%% Failed to attach to the LEDC (channel=%u, resolution=%u, freq=%u, duty_abs=%u)\r\n",channel,resolution,freq,duty_abs);
-
-    // Regardless of the failure reason, if the requested frequency is below
-    // 10 Hz, inform the user about alternative ways to generate low-frequency PWM.
-    goto print_hint_and_exit;
+      nd++;
+    }
+    if (nd != 1 && nd != n) {
+      q_printf("%% <e>Expected 1 or %u duty values, got %u</>\r\n", n, nd);
+      return 3;
+    }
   }
-  return 0;
+  if (nd == 0)
+    duty[nd++] = 0.5f;
+  for (i = nd; i < n; i++)
+    duty[i] = duty[0];
+
+  // Pass 1: configure pins which are not running at the requested frequency (or stop PWM if freq is 0);
+  //         stage duty values for others
+  for (i = 0; i < n; i++) {
+    ledc_channel_handle_t *bus = (ledc_channel_handle_t *)perimanGetPinBus(pins[i], ESP32_BUS_TYPE_LEDC);
+    if (freq && bus && ledcReadFreq(pins[i]) == freq) {
+      unsigned int max_duty = (1 << bus->channel_resolution) - 1,
+                   duty_abs = (unsigned int)(duty[i] * (float )max_duty + 0.5f);
+      // Same as ledcWrite() does: all bits set means "full on", which needs one extra step
+      if (duty_abs == max_duty && max_duty != 1)
+        duty_abs = max_duty + 1;
+      ledc_set_duty(PWM_GROUP(bus->channel), PWM_GCHAN(bus->channel), duty_abs);
+      chan[nc++] = bus->channel;
+    } else if (pwm_enable_channel(pins[i], freq, duty[i], -1) != 0) {
+      q_printf("%% <e>GPIO%u: failed to set up PWM</>\r\n", pins[i]);
+      ret = CMD_FAILED;
+    }
+  }
+
+  // Pass 2: latch new duty values on all running channels
+  for (i = 0; i < nc; i++)
+    ledc_update_duty(PWM_GROUP(chan[i]), PWM_GCHAN(chan[i]));
+
+  VERBOSE(q_printf("%% %u PWM outputs updated (%u in one pass)\r\n", n, nc));
+  return ret;
 }
 
 // Same as above but autoselects PWM channel number.
@@ -335,6 +568,23 @@ static int cmd_show_pwm(UNUSED int argc, UNUSED char **argv) {
             pwm_clock_source(), 
             pwm_source_clock_frequency());
 
+  // LEDC channels map
+  struct pwm_map m;
+  unsigned int ch, nfree = 0;
+
+  pwm_map_build(&m);
+  q_print("%\r\n%      -- LEDC channels map --\r\n"
+          "%<r> Channel | Timer |  Owner   | GPIO | Frequency </>\r\n"
+          "% --------+-------+----------+------+-----------\r\n");
+  for (ch = 0; ch < PWM_CHANNELS_NUM; ch++)
+    if (m.owner[ch] == PWM_FREE)
+      nfree++;
+    else if (m.owner[ch] == PWM_CAMERA)
+      q_printf("%%    %2u   |  %u/%u  | %-8s |   -  |     -\r\n", ch, PWM_GROUP(ch), PWM_TIMER(ch), pwm_owner_name(m.owner[ch]));
+    else
+      q_printf("%%    %2u   |  %u/%u  | %-8s |  %2u  | %9lu\r\n", ch, PWM_GROUP(ch), PWM_TIMER(ch), pwm_owner_name(m.owner[ch]), m.pin[ch], (unsigned long)m.freq[ch]);
+  q_printf("%% %u of %u LEDC channels are free\r\n", nfree, PWM_CHANNELS_NUM);
+
     return 0;
 }
 
@@ -344,6 +594,7 @@ static int cmd_show_pwm(UNUSED int argc, UNUSED char **argv) {
 //"pwm PIN"               - pwm off
 //"pwm PIN 0"             - pwm off  <-- undoc
 //"pwm PIN off"           - pwm off  <-- undoc
+//"pwm PIN1,PIN2,... FREQ [DUTY1,DUTY2,...]" - batched update
 //
 static int cmd_pwm(int argc, char **argv) {
 
@@ -354,6 +605,9 @@ static int cmd_pwm(int argc, char **argv) {
   if (argc < 2) 
     return CMD_MISSING_ARG;
 
+  if (strchr(argv[1], ','))
+    return pwm_batch(argc, argv);
+
   // first parameter is the pin number
   // we don't assert pin_exist() here since it is done in pwm_enable_channel()
   pin = q_atol(argv[1], BAD_PIN);  
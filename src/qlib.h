@@ -1265,14 +1265,27 @@ static inline int q_atoi(const char *p, int def) {
   return isnum(p) ? atoi(p) : def;
 }
 
-// TODO: implement 64bit (long long int) version of q_atol
+// 64bit version of q_atol(): same formats, /def/ is returned if conversion fails
+//
 static uint64_t q_atoll(const char *p, uint64_t def) {
-  return (uint64_t )q_atol(p, (unsigned int)def);
+
+  if (!p || !*p)
+    return def;
+
+  if (p[0] == '0') {
+    if (p[1] == 'x' || p[1] == 'X')
+      return ishex(p) ? strtoull(p + 2, NULL, 16) : def;
+    if (p[1] == 'b' || p[1] == 'B')
+      return isbin(p) ? strtoull(p + 2, NULL, 2) : def;
+    return isoct(p) ? strtoull(p, NULL, 8) : def;
+  }
+  return isnum(p) ? strtoull(p, NULL, 10) : def;
 }
 
-// TODO: implement 64bit (long long int) version of q_atoi
-static int64_t q_atoii(const char *p, uint64_t def) {
-  return (int64_t )q_atoi(p, (int)def);
+// 64bit version of q_atoi(): decimal numbers only
+//
+static int64_t q_atoii(const char *p, int64_t def) {
+  return isnum(p) ? strtoll(p, NULL, 10) : def;
 }
 
 
@@ -1332,6 +1345,25 @@ static inline  char *q_findchar(const char *str, char sym) {
   return NULL;
 }
 
+// Fetch next element of a comma-separated list (e.g. "4,5,0x10") into /tok/ (/size/ bytes).
+// Unlike strtok(), the source string is not modified: alias lines keep their argv[] and execute it
+// again, so command handlers must not write to argv[].
+// Returns pointer to the next element, an empty string at the end of the list, or NULL if the element is
+// too long to fit in /tok/
+//
+static const char *q_nextitem(const char *p, char *tok, unsigned int size) {
+
+  unsigned int len = 0;
+
+  while (p[len] && p[len] != ',')
+    len++;
+  if (len >= size)
+    return NULL;
+  memcpy(tok, p, len);
+  tok[len] = '\0';
+  return p[len] ? p + len + 1 : p + len;
+}
+
 // Adopted from esp32-hal-uart.c Arduino Core.
 // Internal buffer is changed from static to stack because q_printf() can be called from different tasks
 // This function can be used in Out-of-memory situation however caller must not use strings larger than 256 bytes (after % expansion)
@@ -1436,6 +1468,108 @@ static int q_print(const char *str) {
   return len;
 }
 
+// Element formats for q_sprint_elem() and q_printarray()
+#define PA_NATIVE 0   // according to the element type
+#define PA_HEX    1   // hexadecimal, zero-padded to the element size
+#define PA_DEC    2   // decimal integer (floats are shown as their binary representation)
+#define PA_FLOAT  3   // 4 and 8 byte elements are shown as float and double
+
+// Print a single value of /size/ bytes (1,2,4 or 8) located at /p/ into the /out/.
+// Returns the number of characters written (never more than len - 1)
+//
+static unsigned int q_sprint_elem(char *out, size_t len, const void *p, unsigned int size, bool isu, bool isf, bool isp, int fmt) {
+
+  uint64_t u = 0;
+  unsigned int shift = 64 - 8 * size;
+  int n = 0;
+
+  memcpy(&u, p, size); // little-endian CPU: the value occupies lower bytes of /u/
+
+  if (fmt == PA_NATIVE) {
+    if (isp)
+      fmt = PA_HEX;
+    else if (isf)
+      fmt = PA_FLOAT;
+  }
+
+  if (fmt == PA_FLOAT) {
+    if (size == sizeof(float)) {
+      float f;
+      memcpy(&f, &u, sizeof(f));
+      n = snprintf(out, len, "%f", f);
+    } else if (size == sizeof(double)) {
+      double d;
+      memcpy(&d, &u, sizeof(d));
+      n = snprintf(out, len, "%f", d);
+    } else
+      fmt = PA_HEX;  // there are no floating point types of this size
+  }
+
+  if (fmt == PA_HEX)
+    n = snprintf(out, len, "0x%0*llx", size * 2, (unsigned long long)u);
+  else if (fmt != PA_FLOAT)
+    n = isu ? snprintf(out, len, "%llu", (unsigned long long)u)
+            : snprintf(out, len, "%lld", (long long)((int64_t)(u << shift) >> shift)); // sign-extend
+
+  return n < 0 ? 0 : (n < len ? n : len - 1);
+}
+
+// Print /count/ elements of /size/ bytes each, located /stride/ bytes apart (/stride/ is larger than /size/ for
+// fields of an array of structures), /per_line/ elements per line. Every line starts with the index of its
+// first element or, if /addr/ is true, with its address.
+//
+// Output is rendered into a local buffer in one pass, the buffer is sent to the console when it is about
+// to fill up, not on every element. Foreground tasks can interrupt the output by a keypress.
+// Returns /false/ if output was interrupted
+//
+#define PA_BUFSIZ 256
+
+static bool q_printarray(const void *base, unsigned int count, unsigned int stride, unsigned int size,
+                         bool isu, bool isf, bool isp, int fmt, unsigned int per_line, bool addr) {
+
+  const unsigned char *p = (const unsigned char *)base;
+  char buf[PA_BUFSIZ];
+  unsigned int i, pos = 0;
+  bool fg = is_foreground_task();
+
+  if (!p || !size || size > sizeof(uint64_t) || !per_line)
+    return true;
+
+  for (i = 0; i < count; i++, p += stride) {
+
+    // Leave room for a line prefix, a value and a separator. Values which do not fit are truncated
+    if (pos > sizeof(buf) - 64) {
+      buf[pos] = '\0';
+      q_print(buf);
+      pos = 0;
+      if (fg && anykey_pressed()) {
+        q_print("\r\n% Interrupted by a keypress\r\n");
+        return false;
+      }
+    }
+
+    if (i % per_line == 0)
+      pos += addr ? snprintf(buf + pos, sizeof(buf) - pos, "%% %p : ", p)
+                  : snprintf(buf + pos, sizeof(buf) - pos, "%%  [%4u] ", i);
+
+    pos += q_sprint_elem(buf + pos, sizeof(buf) - pos - 3, p, size, isu, isf, isp, fmt);
+
+    if (i % per_line == per_line - 1 || i == count - 1) {
+      buf[pos++] = '\r';
+      buf[pos++] = '\n';
+    } else {
+      buf[pos++] = ',';
+      buf[pos++] = ' ';
+    }
+  }
+
+  if (pos) {
+    buf[pos] = '\0';
+    q_print(buf);
+  }
+  return true;
+}
+
 // print /Address : Value/ pairs, decoding the data according to data type
 // 1,2,4 and 8 bytes long data types are supported
 // If it is more than 1 element in the table, then print a header also
@@ -1451,47 +1585,7 @@ static void q_printtable(const unsigned char *p,
     if (p && count && length) {
       if (count > 1)
         q_printf("%% Array of %u elements, %u bytes each\r\n%%  Address   :  Value    \r\n",count,length);
-      while (count) {
-        q_printf("%% %p : ", p);
-        if (isp) {
-          q_printf("%p\r\n", (void *)(*((intptr_t *)p)));
-        } else if (isf) {
-            if (force_hex)
-              q_printf("0x%08x)\r\n",*((unsigned int *)p)); // TODO: warning
-            else
-              q_printf("%ff\r\n", *((float *)p));
-        } else {
-          if (length == sizeof(unsigned int)) {
-            if (force_hex)
-              q_printf("0x%08x)\r\n",*((unsigned int *)p));
-            else if (isu)
-              q_printf("%u (0x%x)\r\n",*((unsigned int *)p),*((unsigned int *)p));
-            else
-              q_printf("%i\r\n",*((signed int *)p));
-          } else if (length == sizeof(unsigned short)) {
-            if (force_hex)
-              q_printf("0x%04x)\r\n",*((unsigned short *)p));
-            else if (isu)
-              q_printf("%u (0x%x)\r\n",*((unsigned short *)p),*((unsigned short *)p));
-            else
-              q_printf("%i\r\n",*((signed short *)p));
-          } else if (length == sizeof(unsigned char)) {
-            if (isu)
-              q_printf("%u (0x%x)\r\n",*((unsigned char *)p),*((unsigned char *)p));
-            else
-              q_printf("%i\r\n",*((signed char *)p));
-          } else if (length == sizeof(unsigned long long)) {
-            if (isu)
-              q_printf("%llu\r\n",*((unsigned long long *)p));
-            else
-              q_printf("%lld \r\n",*((signed long long *)p));
-          } else {
-            MUST_NOT_HAPPEN( true ); // fatal error, likely memory corruption. abort the shell, don't make things worse
-          }
-        }
-        p += length;
-        count--;
-      }
+      q_printarray(p, count, length, length, isu, isf, isp, force_hex ? PA_HEX : PA_NATIVE, 1, true);
     }
 }
 // make fancy hex data output: mixed hex values
@@ -18,7 +18,8 @@
 // A "pulse"  : two consecutive levels,
 //              e.g. logic 0 for X ticks, then logic 1 for Y ticks
 //
-// "bits"    : a user-defined ASCIIZ string consisting of '1' and '0'
+// "bits"    : a user-defined ASCIIZ string consisting of '1' and '0'.
+//              Stored packed, 8 bits per byte
 // "bytes"   : a user-defined ASCIIZ string representing a byte stream,
 //              e.g. "1af4c675..."
 //
@@ -53,8 +54,6 @@
 // See seq_*() functions and cmd_sequence_if().
 
 // TODO: When padding, use zero rmt item, so user input will not be altered
-// TODO: RMT RX, RMT decode
-// TODO: profiles (nec, lg, samsung)
 
 #if COMPILING_ESPSHELL
 
@@ -62,6 +61,25 @@
 #define SEQUENCE_MAX (SEQUENCES_NUM - 1)  // max number that can be used as sequence id
 #define SEQ_IDLE_THRESHOLD 32767          // if signal does not change during 32767 ticks - consider frame end, RX idle.
 
+// RX decoder: converts RMT symbols to packed bits. See seq_decode()
+struct sequence;
+typedef unsigned int (*seq_decoder_t)(const struct sequence *s, const rmt_data_t *sym, unsigned int n, unsigned int tol, uint8_t *bits, unsigned int max, unsigned int *used);
+
+// Protocol profile. See seq_profiles[]
+struct seq_profile {
+  const char    *name;
+  float          tick;         // microseconds
+  uint32_t       mod_freq;     // carrier frequency, Hz. HIGH levels (marks) are modulated
+  float          mod_duty;     // carrier duty, 0..1
+  rmt_data_t     alph[2];      // "zero" and "one"
+  rmt_data_t     ht[2];        // "head" and "tail"
+  uint8_t        nbits;        // frame length, bits
+  bool           msb;          // most significant bit is transmitted first
+  uint64_t     (*pack)(uint32_t addr, uint32_t cmd);
+  bool         (*unpack)(uint64_t frame, uint32_t *addr, uint32_t *cmd);
+  seq_decoder_t  decoder;      // NULL for the alphabet decoder
+};
+
 // Structure holding a sequence description
 //
 static struct sequence {
@@ -71,6 +89,7 @@ static struct sequence {
   unsigned int mod_high : 1;   // modulate "1"s or "0"s
   unsigned int filter_ns : 8;  // Filter is 8-but wide, 0..255ns absolute value
   unsigned int eot : 1;        // end of transmission level
+  unsigned int stream : 1;     // sequence is too long to be compiled: RMT symbols are generated during transmission
   unsigned short idle_thresh;  // RX-Idle treshold (in ticks)
 #define SEQ_LOOP_INFINITE ((unsigned int)(-1))
 #define SEQ_LOOP_NONE 1
@@ -80,10 +99,13 @@ static struct sequence {
   rmt_data_t *seq;          // array of rmt_data_t
   rmt_data_t alph[2];       // alphabet. representation of "0" and "1"
   rmt_data_t ht[2];         // "head" [0] and "tail" [1]. TODO: make 2 members with proper names
+  rmt_data_t lut[4];        // short form: RMT symbols for bit pairs "00", "01", "10" and "11". Built by seq_compile()
 
-  char *bits;   // asciiz "100101101"
-  char *bytes;  // char * to the raw 8bit data. can not be printfed
-  int bytes_len;
+  uint8_t *bits;            // packed bits, MSB first: "bits 10010110" and "bytes \x96" are stored as one byte 0x96
+  unsigned int nbits;       // number of bits in ->bits
+  bool bytes;               // ->bits were set by the "bytes" command
+  seq_decoder_t decoder;    // RX decoder, NULL for the default (alphabet) decoder
+  const struct seq_profile *profile; // protocol profile, if loaded by "profile" command
 
 } sequences[SEQUENCES_NUM] = { 0 };  // TODO: refactor: use g_ prefix to global names
 
@@ -110,11 +132,13 @@ static unsigned long __attribute__((const)) seq_tick2freq(const float tick_us) {
 //
 //
 static void seq_drop_levels(int seq) {
-  if (seq >= 0 && seq < SEQUENCES_NUM)
+  if (seq >= 0 && seq < SEQUENCES_NUM) {
     if (sequences[seq].seq) {
       q_free(sequences[seq].seq);
       sequences[seq].seq = NULL;
     }
+    sequences[seq].stream = 0;
+  }
 }
 
 // Free memory buffers associated with the sequence:
@@ -128,14 +152,13 @@ static void seq_freemem(int seq) {
       q_free(sequences[seq].bits);
       sequences[seq].bits = NULL;
     }
-    if (sequences[seq].bytes) {
-      q_free(sequences[seq].bytes);
-      sequences[seq].bytes = NULL;
-    }
+    sequences[seq].nbits = 0;
+    sequences[seq].bytes = false;
     if (sequences[seq].seq) {
       q_free(sequences[seq].seq);
       sequences[seq].seq = NULL;
     }
+    sequences[seq].stream = 0;
   }
 }
 
@@ -185,6 +208,30 @@ static void seq_fprintf_rmt_symbol(FILE *fp, rmt_data_t *sym) {
 }
 
 
+// Value of bit number /n/ of a packed bit string
+//
+static INLINE unsigned int seq_bit(const struct sequence *s, unsigned int n) {
+  return (s->bits[n >> 3] >> (7 - (n & 7))) & 1;
+}
+
+// Print packed bits as a string of "1" and "0", to the file /fp/ or, if /fp/ is NULL, to the user
+//
+static void seq_print_bits(FILE *fp, const struct sequence *s) {
+
+  char buf[65];
+  unsigned int i, j;
+
+  for (i = 0; i < s->nbits; i += j) {
+    for (j = 0; j < sizeof(buf) - 1 && i + j < s->nbits; j++)
+      buf[j] = '0' + seq_bit(s, i + j);
+    buf[j] = '\0';
+    if (fp)
+      fputs(buf, fp);
+    else
+      q_print(buf);
+  }
+}
+
 // dump sequence content
 static void seq_show(unsigned int seq) {
 
@@ -203,6 +250,8 @@ static void seq_show(unsigned int seq) {
   // if nothing is set - hint about levels, bits and bytes
 
   q_printf("%%\r\n%% Sequence #%d:\r\n%% Resolution : %.4fuS per tick  (Frequency: %lu Hz)\r\n", seq, s->tick, seq_tick2freq(s->tick));
+  if (s->profile)
+    q_printf("%% Protocol profile: <i>%s</>, %u bit frames\r\n", s->profile->name, s->profile->nbits);
   if (s->seq) {
     int i;
     unsigned long total = 0;
@@ -214,23 +263,23 @@ static void seq_show(unsigned int seq) {
       total += s->seq[i].duration0 + s->seq[i].duration1;
     }
     q_printf("\r\n%% Total: %d levels, duration: %lu ticks, (~%lu uS)\r\n", s->seq_len * 2, total, (unsigned long)((float)total * s->tick));
+  } else if (s->stream) {
+    q_printf("%% Levels: %d levels, generated during transmission (sequence is too long to be precompiled)\r\n", s->seq_len * 2);
   } else {
-    if (s->bits || s->bytes)
+    if (s->bits)
       q_print("% <i>Incomplete</>: set the alphabet with \"one\" and \"zero\"\r\n");
     else
       q_print("% <i>Incomplete</>: set the waveform with \"levels\", \"bits\" or \"bytes\"\r\n");
   }
 
-  if (s->bits || s->bytes) {
+  if (s->bits) {
     if (s->bytes) {
-      q_printf("%% Bytes sequence: (%d byte%s)\"\r\n", PPA(s->bytes_len));
-      q_printhex((unsigned char *)s->bytes, s->bytes_len);
+      q_printf("%% Bytes sequence: (%u byte%s)\"\r\n", PPA(s->nbits / 8));
+      q_printhex(s->bits, s->nbits / 8);
     } else {
-      size_t x = strlen(s->bits);
-      q_printf("%% Bits sequence: (%d bit%s)\r\n"
-               "%% %s\r\n",
-               PPA(x),
-               s->bits);
+      q_printf("%% Bits sequence: (%u bit%s)\r\n%% ", PPA(s->nbits));
+      seq_print_bits(NULL, s);
+      q_print("\r\n");
     }
   }
 
@@ -305,10 +354,103 @@ static int seq_atol(int *level, int *duration, char *p) {
 
 // check if sequence is configured and an be used
 // to generate pulses. The criteria is:
-// ->seq must be initialized
+// ->seq must be initialized (or the sequence is streamed)
 // ->tick must be set
 static inline bool seq_isready(unsigned int seq) {
-  return (seq < SEQUENCES_NUM) && (sequences[seq].seq != NULL) && (sequences[seq].tick != 0.0f);
+  return (seq < SEQUENCES_NUM) && (sequences[seq].seq != NULL || sequences[seq].stream) && (sequences[seq].tick != 0.0f);
+}
+
+// -- RMT symbol encoder --
+//
+// Converts packed "bits" to RMT symbols using the alphabet. Symbols are produced starting from an arbitrary index, in
+// chunks: seq_compile() encodes the whole sequence at once into ->seq, while streamed sequences are encoded
+// chunk by chunk directly into RMT channel memory, during transmission (see seq_send_stream())
+//
+// Symbol index /k/ is mapped to bits as follows:
+//   long form:  symbol 0 is "head", symbol (seq_len - 1) is "tail" (if they are set), others carry 1 bit each
+//   short form: symbol k carries bits 2k and 2k+1
+//
+
+// Sequences longer than this (in RMT symbols) are not compiled into ->seq array but streamed instead.
+// 1024 symbols = 4KB of RAM
+#define SEQ_STREAM_MIN 1024
+
+// Streaming requires the "simple encoder" of the IDF RMT driver, which appeared in ESP-IDF 5.3
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0)
+#  define SEQ_STREAMING 1
+#else
+#  define SEQ_STREAMING 0
+#endif
+
+// Encode up to /n/ symbols, starting from symbol number /first/.
+// Sequence must be validated by seq_compile() first: ->seq_len and ->lut must be set
+// Returns number of symbols written to /out/
+//
+// Bits are converted a whole byte at a time, using lookup tables: ->alph[] for the long form (8 symbols per byte)
+// and ->lut[] for the short form (4 symbols per byte). Only unaligned bits at the beginning and at the end of
+// the requested range are processed one by one
+//
+static unsigned int seq_encode(const struct sequence *s, unsigned int first, rmt_data_t *out, unsigned int n) {
+
+  const uint8_t *p;
+  unsigned int k, last;
+
+  if (first >= s->seq_len)
+    return 0;
+
+  if (n > s->seq_len - first)
+    n = s->seq_len - first;
+
+  last = first + n;
+
+  if (s->alph[0].duration1) {
+    // long form: 1 bit per symbol, optional head and tail
+    const rmt_data_t *a = s->alph;
+    unsigned int ht = s->ht[0].duration0 ? 1 : 0,
+                 e = last - ht > s->nbits ? s->nbits : last - ht;   // bit number after the last bit to encode
+
+    if (ht && first == 0)
+      *out++ = s->ht[0];
+
+    for (k = first > ht ? first - ht : 0; k < e && (k & 7); k++)
+      *out++ = a[seq_bit(s, k)];
+
+    for (p = s->bits + (k >> 3); k + 8 <= e; k += 8, p++, out += 8) {
+      out[0] = a[*p >> 7];
+      out[1] = a[(*p >> 6) & 1];
+      out[2] = a[(*p >> 5) & 1];
+      out[3] = a[(*p >> 4) & 1];
+      out[4] = a[(*p >> 3) & 1];
+      out[5] = a[(*p >> 2) & 1];
+      out[6] = a[(*p >> 1) & 1];
+      out[7] = a[*p & 1];
+    }
+
+    for (; k < e; k++)
+      *out++ = a[seq_bit(s, k)];
+
+    if (ht && last == s->seq_len)
+      *out = s->ht[1];
+  } else {
+    // short form: 2 bits per symbol. Symbol /k/ is bits 2k and 2k+1
+    const rmt_data_t *t = s->lut;
+#define PAIR(_K) ((s->bits[(_K) >> 2] >> (6 - 2 * ((_K) & 3))) & 3)
+
+    for (k = first; k < last && (k & 3); k++)
+      *out++ = t[PAIR(k)];
+
+    for (p = s->bits + (k >> 2); k + 4 <= last; k += 4, p++, out += 4) {
+      out[0] = t[*p >> 6];
+      out[1] = t[(*p >> 4) & 3];
+      out[2] = t[(*p >> 2) & 3];
+      out[3] = t[*p & 3];
+    }
+
+    for (; k < last; k++)
+      *out++ = t[PAIR(k)];
+#undef PAIR
+  }
+  return n;
 }
 
 // compile 'bits' or 'bytes' to 'seq'
@@ -320,12 +462,16 @@ static inline bool seq_isready(unsigned int seq) {
 //
 // 'head' and 'tail' are optional
 //
+// Long sequences (more than SEQ_STREAM_MIN RMT symbols) are not compiled but marked as "streamed":
+// their RMT symbols are generated during transmission
+//
 static int seq_compile(int seq) {
 
   struct sequence *s = &sequences[seq];
   int ht = 0;  // how many extra RMT symbols we need to add Head and Tail?
+  int i;
 
-  if (s->seq)  //already compiled
+  if (s->seq || s->stream)  //already compiled
     return 0;
 
   // If used, both 'tail' and 'head' are expected to be set
@@ -337,107 +483,380 @@ static int seq_compile(int seq) {
   if (s->ht[0].duration0)
     ht = 2;
 
-  if (s->alph[0].duration0 && s->alph[1].duration0 && s->bits) {
+  if (!s->alph[0].duration0 || !s->alph[1].duration0 || !s->bits)
+    return 0;
+
+  // if "0" is defined as a "pulse" (i.e. both parts of rmt_data_t used
+  // to define a symbol (IR protocols-type encoding) then we need "1" to
+  // be defined as a "pulse" as well.
+  if (s->alph[0].duration1) {
+
+    //long form. 1 rmt symbol carries 1 bit of data
+    if (!s->alph[1].duration1) {
+      q_print("% <e>\"One\" is defined as a level, but \"Zero\" is a pulse</>\r\n");
+      return -1;
+    }
 
+    if ((i = s->nbits) == 0)
+      return -2;
 
-    // if "0" is defined as a "pulse" (i.e. both parts of rmt_data_t used
-    // to define a symbol (IR protocols-type encoding) then we need "1" to
-    // be defined as a "pulse" as well.
-    //
-    // allocate strlen(bits) items for a 'seq', initialize 'seq' items with
-    // either "alph[0]" or "alph[1]" according to "bits"
-    if (s->alph[0].duration1) {
+    s->seq_len = i + ht;
 
-      //long form. 1 rmt symbol carries 1 bit of data
-      if (!s->alph[1].duration1) {
-        q_print("% <e>\"One\" is defined as a level, but \"Zero\" is a pulse</>\r\n");
-        return -1;
-      }
+  } else {
+    // short form (1 rmt symbol carry 2 bits of data)
+    if (s->alph[1].duration1) {
+      q_print("% <e>\"One\" is defined as a pulse, but \"Zero\" is a level</>\r\n");
+      return -4;
+    }
 
-      int j = 0, i = strlen(s->bits) + ht, k = 0;
+    i = s->nbits;
 
-      if (!i)
-        return -2;
+    // 1 rmt symbol can carry 2 bits so we want our "bits" string to be of even size.
+    // if number of bits user had entered is not divisible by 2 then:
+    //     TODO: if there is "tail" set, then we just add tail (always 1 level) to the bitstring
+    //     TODO: if not - then pad with 0/0 0/0 rmt symbol
+    if (ht)
+      HELP(q_print("% \"head\" and \"tail\" are ignored for a short-form level sequence\r\n"));
 
-      if ((s->seq = (rmt_data_t *)q_malloc(sizeof(rmt_data_t) * i, MEM_SEQUENCE)) == NULL)
-        return -3;
+    // There is always a room for one extra bit: see cmd_seq_bits()
+    if (i & 1) {
+      if (seq_bit(s, i - 1))
+        s->bits[i >> 3] |= 0x80 >> (i & 7);
+      else
+        s->bits[i >> 3] &= ~(0x80 >> (i & 7));
+      s->nbits = ++i;
+      // TODO: must be padded with 0/0 RMT symbol!!!
+      q_printf("%% Bit string was padded with one extra \"%u\" (must be even number of bits)\r\n", seq_bit(s, i - 1));
+    }
 
-      // first element is a 'head' symbol
-      if (ht)
-        s->seq[j++] = s->ht[0];
+    s->seq_len = i / 2;
 
-      // s->seq[j] = s->alph[0] or s->alph[1], depending on s->bits[j] value ('0' or '1')
-      for (s->seq_len = i; s->bits[k] != 0; j++, k++)
-        s->seq[j] = s->alph[s->bits[k] - '0'];
+    // Symbols for every possible pair of bits
+    for (int pair = 0; pair < 4; pair++) {
+      s->lut[pair].level0 = s->alph[pair >> 1].level0;
+      s->lut[pair].duration0 = s->alph[pair >> 1].duration0;
+      s->lut[pair].level1 = s->alph[pair & 1].level0;
+      s->lut[pair].duration1 = s->alph[pair & 1].duration0;
+    }
+  }
 
-      // last element is a 'tail' symbol
-      if (ht)
-        s->seq[j++] = s->ht[1];
+#if SEQ_STREAMING
+  // Too long to keep all RMT symbols in memory: ->bits will be encoded during transmission
+  if (s->seq_len > SEQ_STREAM_MIN) {
+    s->stream = 1;
+    return 0;
+  }
+#endif
 
-    } else {
-      // short form (1 rmt symbol carry 2 bits of data)
-      if (s->alph[1].duration1) {
-        q_print("% <e>\"One\" is defined as a pulse, but \"Zero\" is a level</>\r\n");
-        return -4;
-      }
-      int k, j, i = strlen(s->bits);
-
-      // 1 rmt symbol can carry 2 bits so we want our "bits" string to be of even size.
-      // if number of bits user had entered is not divisible by 2 then:
-      //     TODO: if there is "tail" set, then we just add tail (always 1 level) to the bitstring
-      //     TODO: if not - then pad with 0/0 0/0 rmt symbol
-      if (ht)
-        HELP(q_print("% \"head\" and \"tail\" are ignored for a short-form level sequence\r\n"));
-
-      if (i & 1) {
-        char *r = (char *)q_realloc(s->bits, i + 2, MEM_SEQUENCE);
-        if (!r)
-          return -5;
-        s->bits = r;
-        s->bits[i + 0] = s->bits[i - 1];
-        s->bits[i + 1] = '\0';
-        // TODO: must be padded with 0/0 RMT symbol!!!
-        q_printf("%% Bit string was padded with one extra \"%c\" (must be even number of bits)\r\n", s->bits[i]);
-        i++;
-      }
+  // allocate seq_len items for a 'seq', initialize 'seq' items with
+  // either "alph[0]" or "alph[1]" according to "bits"
+  if ((s->seq = (rmt_data_t *)q_malloc(sizeof(rmt_data_t) * s->seq_len, MEM_SEQUENCE)) == NULL)
+    return -3;
 
-      s->seq_len = i / 2;
-      s->seq = (rmt_data_t *)q_malloc(sizeof(rmt_data_t) * s->seq_len, MEM_SEQUENCE);
+  seq_encode(s, 0, s->seq, s->seq_len);
 
-      if (!s->seq)
-        return -6;
+  return 0;
+}
 
-      j = 0;  // index of a bit from /.bits/ string
-      k = 0;  // index of a corresponding RMT entry
 
-      while (j < i) {
+#if SEQ_STREAMING
+// RMT "simple encoder" callback: called by the RMT driver whenever there is free space in the channel memory.
+// Fills RMT memory with next portion of symbols.
+// NOTE: Called from the RMT ISR
+//
+static size_t seq_stream_cb(const void *data, size_t data_size, size_t symbols_written, size_t symbols_free, rmt_symbol_word_t *symbols, bool *done, void *arg) {
 
-        if (s->bits[j] == '1') {
-          s->seq[k].level0 = s->alph[1].level0;
-          s->seq[k].duration0 = s->alph[1].duration0;
-        } else {
-          s->seq[k].level0 = s->alph[0].level0;
-          s->seq[k].duration0 = s->alph[0].duration0;
-        }
+  const struct sequence *s = (const struct sequence *)data;
+  size_t n = seq_encode(s, symbols_written, (rmt_data_t *)symbols, symbols_free);
 
-        j++;
+  *done = (symbols_written + n >= s->seq_len);
+  return n;
+}
 
-        if (s->bits[j] == '1') {
-          s->seq[k].level1 = s->alph[1].level0;
-          s->seq[k].duration1 = s->alph[1].duration0;
-        } else {
-          s->seq[k].level1 = s->alph[0].level0;
-          s->seq[k].duration1 = s->alph[0].duration0;
-        }
+// Create and enable an RMT TX channel for sequence /s/ on GPIO /pin/: channel memory is /mem/ symbols.
+// Streamed sequences get an encoder which calls seq_stream_cb(), compiled ones are copied from ->seq
+// Returns /true/ on success
+//
+static bool seq_channel_new(unsigned int pin, const struct sequence *s, size_t mem, rmt_channel_handle_t *chan, rmt_encoder_handle_t *enc) {
+
+  rmt_tx_channel_config_t cfg = { 0 };
+
+  *chan = NULL;
+  *enc = NULL;
+
+  // Release the pin if it is used by Arduino's RMT (e.g. by previous "pin X sequence Y") or any other bus
+  perimanClearPinBus(pin);
+
+  cfg.gpio_num = pin;
+  cfg.clk_src = RMT_CLK_SRC_DEFAULT;
+  cfg.resolution_hz = seq_tick2freq(s->tick);
+  cfg.mem_block_symbols = mem;
+  cfg.trans_queue_depth = 4;
+
+  if (rmt_new_tx_channel(&cfg, chan) != ESP_OK) {
+    HELP(q_printf("%% RMT failed to initialize (GPIO%u)\r\n", pin));
+    *chan = NULL;
+    return false;
+  }
+
+  if (s->mod_freq) {
+    rmt_carrier_config_t ccfg = { 0 };
+    ccfg.frequency_hz = s->mod_freq;
+    ccfg.duty_cycle = s->mod_duty;
+    ccfg.flags.polarity_active_low = s->mod_high == 1 ? false : true;
+    if (rmt_apply_carrier(*chan, &ccfg) != ESP_OK) {
+      HELP(q_print("% RMT failed to set carrier (bad frequency / duty range?)\r\n"));
+      goto del_channel;
+    }
+  }
+
+  if (s->stream) {
+    rmt_simple_encoder_config_t ecfg = { 0 };
+    ecfg.callback = seq_stream_cb;
+    if (rmt_new_simple_encoder(&ecfg, enc) != ESP_OK)
+      goto no_encoder;
+  } else {
+    rmt_copy_encoder_config_t ecfg = { 0 };
+    if (rmt_new_copy_encoder(&ecfg, enc) != ESP_OK)
+      goto no_encoder;
+  }
+
+  if (rmt_enable(*chan) == ESP_OK)
+    return true;
+
+  rmt_del_encoder(*enc);
+  *enc = NULL;
+  goto del_channel;
+
+no_encoder:
+  HELP(q_print("% RMT failed to create an encoder\r\n"));
+  *enc = NULL;
+del_channel:
+  rmt_del_channel(*chan);
+  *chan = NULL;
+  return false;
+}
+
+// Disable and delete a channel created by seq_channel_new()
+//
+static void seq_channel_del(rmt_channel_handle_t chan, rmt_encoder_handle_t enc) {
+  if (chan) {
+    rmt_disable(chan);
+    rmt_del_channel(chan);
+  }
+  if (enc)
+    rmt_del_encoder(enc);
+}
+
+// Queue a transmission of sequence /s/ on the channel
+//
+static INLINE esp_err_t seq_channel_transmit(rmt_channel_handle_t chan, rmt_encoder_handle_t enc, const struct sequence *s) {
+
+  rmt_transmit_config_t tcfg = { 0 };
+
+  tcfg.flags.eot_level = s->eot;
+  return s->stream ? rmt_transmit(chan, enc, s, sizeof(*s), &tcfg)
+                   : rmt_transmit(chan, enc, s->seq, s->seq_len * sizeof(rmt_data_t), &tcfg);
+}
+
+// Wait for the channel to complete transmission. Polling allows user to interrupt long transmissions
+// Returns /false/ if interrupted or failed
+//
+static bool seq_channel_wait(rmt_channel_handle_t chan) {
+
+  esp_err_t err;
+
+  while ((err = rmt_tx_wait_all_done(chan, TIMO_QUANTUM)) == ESP_ERR_TIMEOUT)
+    if (is_foreground_task() ? anykey_pressed() : task_wait_for_signal(NULL, 0)) {
+      HELP(q_print("% Transmission interrupted\r\n"));
+      return false;
+    }
+  return err == ESP_OK;
+}
+
+// Send a streamed sequence.
+// Arduino's rmtWrite() needs the whole sequence to be in memory as rmt_data_t array, so for streamed
+// sequences the IDF RMT driver is used directly: RMT channel memory is used as a ping-pong buffer which
+// is refilled by seq_stream_cb()
+//
+static int seq_send_stream(unsigned int pin, struct sequence *s) {
+
+  rmt_channel_handle_t chan;
+  rmt_encoder_handle_t enc;
+  unsigned int count = s->loop_count > SEQ_LOOP_NONE ? s->loop_count : 1;
+  int ret = -1;
+
+  if (s->loop_count == SEQ_LOOP_INFINITE) {
+    q_print("% <e>Continuous looping is not supported for long sequences</>\r\n");
+    return -1;
+  }
+
+  // 2 memory blocks, same as RMT_MEM_NUM_BLOCKS_2 for rmtInit()
+  if (!seq_channel_new(pin, s, 2 * SOC_RMT_MEM_WORDS_PER_CHANNEL, &chan, &enc))
+    return -1;
+
+  // Finite looping is done by queueing the same transaction multiple times:
+  // RMT hardware looping requires the whole sequence to fit in RMT memory
+  while (count--) {
+    if (seq_channel_transmit(chan, enc, s) != ESP_OK) {
+      HELP(q_print("% RMT failed (rmt_transmit)\r\n"));
+      goto del_channel;
+    }
+    if (!seq_channel_wait(chan))
+      goto del_channel;
+  }
+  ret = 0;
+
+del_channel:
+  seq_channel_del(chan, enc);
+  return ret;
+}
+
+// -- Synchronized transmission --
+//
+// "sequence send PIN SEQ [PIN SEQ ...]"
+//
+// Sequences are loaded onto separate RMT TX channels and started at once. On SoCs with the RMT sync manager
+// (SOC_RMT_SUPPORT_TX_SYNCHRO) all channels start on the same clock edge; on others (ESP32) channels are
+// started one after another as fast as possible and the start spread is reported.
+// Sequences are sent once: loop settings are ignored
+//
+#define SEQ_GROUP_MAX SOC_RMT_TX_CANDIDATES_PER_GROUP
+
+struct seq_group {
+  unsigned int n;                  // number of channels
+  size_t       mem;                // RMT memory per channel, symbols
+  uint8_t      pin[SEQ_GROUP_MAX];
+  uint8_t      seq[SEQ_GROUP_MAX];
+};
+
+// Parse and validate "PIN SEQ" pairs starting at argv[start], share RMT memory between channels.
+// Returns 0 on success or the index of a bad argument
+//
+static int seq_group_plan(struct seq_group *g, int argc, char **argv, int start) {
+
+  unsigned int pin, seq, j, blocks;
+  int i;
+
+  g->n = 0;
+
+  if (argc - start < 2)
+    return CMD_MISSING_ARG;
+
+  if ((argc - start) & 1) {
+    HELP(q_print("% <e>Arguments are pairs of GPIO and sequence numbers</>\r\n"));
+    return argc - 1;
+  }
+
+  for (i = start; i < argc; i += 2) {
+
+    if (g->n >= SEQ_GROUP_MAX) {
+      q_printf("%% <e>No more than %u sequences can be sent at once</>\r\n", SEQ_GROUP_MAX);
+      return i;
+    }
 
-        j++;
-        k++;
+    if (!pin_exist((pin = q_atol(argv[i], BAD_PIN))))
+      return i;
+
+    for (j = 0; j < g->n; j++)
+      if (g->pin[j] == pin) {
+        q_printf("%% <e>GPIO%u is used twice</>\r\n", pin);
+        return i;
       }
-    }  // short form end
-  }    //if compilation criteria are met
+
+    if (!seq_isready((seq = q_atol(argv[i + 1], DEF_BAD)))) {
+      q_printf("%% <e>Sequence %u is not configured</>\r\n", seq);
+      return i + 1;
+    }
+
+    g->pin[g->n] = pin;
+    g->seq[g->n++] = seq;
+  }
+
+  // Every channel gets an equal share of TX memory blocks, but no more than 2 blocks (ping-pong buffer
+  // for streamed sequences). Compiled sequences longer than channel memory are refilled by the driver
+  blocks = SEQ_GROUP_MAX / g->n;
+  if (blocks > 2)
+    blocks = 2;
+  g->mem = blocks * SOC_RMT_MEM_WORDS_PER_CHANNEL;
+
   return 0;
 }
 
+// Send a group of sequences, started simultaneously
+//
+static int seq_send_group(const struct seq_group *g) {
+
+  rmt_channel_handle_t chan[SEQ_GROUP_MAX] = { 0 };
+  rmt_encoder_handle_t enc[SEQ_GROUP_MAX] = { 0 };
+#if SOC_RMT_SUPPORT_TX_SYNCHRO
+  rmt_sync_manager_handle_t sync = NULL;
+#endif
+  uint32_t t0, t1;
+  unsigned int i;
+  int ret = CMD_FAILED;
+
+  for (i = 0; i < g->n; i++)
+    if (!seq_channel_new(g->pin[i], &sequences[g->seq[i]], g->mem, &chan[i], &enc[i]))
+      goto cleanup;
+
+#if SOC_RMT_SUPPORT_TX_SYNCHRO
+  // Channels which belong to the sync manager wait until all of them have a transaction queued
+  if (g->n > 1) {
+    rmt_sync_manager_config_t scfg = { 0 };
+    scfg.tx_channel_array = chan;
+    scfg.array_size = g->n;
+    if (rmt_new_sync_manager(&scfg, &sync) != ESP_OK) {
+      q_print("% <e>RMT failed to create a sync manager</>\r\n");
+      goto cleanup;
+    }
+  }
+#endif
+
+  t0 = cpu_ticks();
+  for (i = 0; i < g->n; i++)
+    if (seq_channel_transmit(chan[i], enc[i], &sequences[g->seq[i]]) != ESP_OK) {
+      HELP(q_print("% RMT failed (rmt_transmit)\r\n"));
+      goto cleanup;
+    }
+  t1 = cpu_ticks();
+
+  for (i = 0; i < g->n; i++)
+    if (!seq_channel_wait(chan[i]))
+      goto cleanup;
+
+#if SOC_RMT_SUPPORT_TX_SYNCHRO
+  if (sync)
+    VERBOSE(q_printf("%% %u channels started synchronously (RMT sync manager)\r\n", g->n));
+  else
+#endif
+  if (g->n > 1)
+    q_printf("%% %u channels started with up to %lu CPU cycles of skew\r\n", g->n, (unsigned long)(t1 - t0));
+  ret = 0;
+
+cleanup:
+#if SOC_RMT_SUPPORT_TX_SYNCHRO
+  if (sync)
+    rmt_del_sync_manager(sync);
+#endif
+  for (i = 0; i < g->n; i++)
+    seq_channel_del(chan[i], enc[i]);
+  return ret;
+}
+
+// "sequence send PIN SEQ [PIN SEQ ...]"
+//
+static int cmd_seq_send_group(int argc, char **argv) {
+
+  struct seq_group g;
+  int ret;
+
+  if ((ret = seq_group_plan(&g, argc, argv, 2)) != 0)
+    return ret;
+
+  return seq_send_group(&g);
+}
+#endif // SEQ_STREAMING
 
 //Send sequence 'seq' using GPIO 'pin'
 //Sequence is fully configured
@@ -445,6 +864,11 @@ static int seq_send(unsigned int pin, unsigned int seq) {
 
   struct sequence *s = &sequences[seq];
 
+#if SEQ_STREAMING
+  if (s->stream)
+    return seq_send_stream(pin, s);
+#endif
+
   // S2 and C3 have only 2 TX blocks, others CPU have more
   if (!rmtInit(pin, RMT_TX_MODE, RMT_MEM_NUM_BLOCKS_2, seq_tick2freq(s->tick))) {
     HELP(q_print("% RMT failed to initialize\r\n"));
@@ -507,6 +931,19 @@ static int cmd_seq_if(int argc, char **argv) {
   if (argc < 2)
     return CMD_MISSING_ARG;
 
+  // "sequence send PIN SEQ [PIN SEQ ...]"
+  if (!q_strcmp(argv[1], "send")) {
+#if SEQ_STREAMING
+    return cmd_seq_send_group(argc, argv);
+#else
+    q_print("% Update your Arduino Core (ESP-IDF 5.3 or newer) to use this feature\r\n");
+    return CMD_FAILED;
+#endif
+  }
+
+  if (argc > 2)
+    return 2;
+
   if ((seq = q_atol(argv[1], SEQUENCES_NUM)) >= SEQUENCES_NUM) {
     HELP(q_print("% <e>Sequence numbers are 0.." xstr(SEQUENCE_MAX) "</>\r\n"));
     return 1;
@@ -668,11 +1105,11 @@ static int cmd_seq_zeroone(int argc, char **argv) {
   //
   if (!q_strcmp(argv[0], "one")) {
     alph = &s->alph[1];
-    if (s->bits != NULL || s->bytes != NULL)
+    if (s->bits != NULL)
       recompile = true;
   } else if (!q_strcmp(argv[0], "zero")) {
     alph = &s->alph[0];
-    if (s->bits != NULL || s->bytes != NULL)
+    if (s->bits != NULL)
       recompile = true;
   } else if (!q_strcmp(argv[0], "head")) {
     alph = &s->ht[0];
@@ -778,12 +1215,20 @@ static int cmd_seq_bits(int argc, char **argv) {
   if (*bits != '\0')
     return 1;  // first argument is bad binary number
 
+  unsigned int i, nbits = bits - argv[1];
+
   seq_freemem(seq_num);
-  s->bits = q_strdup(argv[1], MEM_SEQUENCE);
 
-  if (!s->bits)
+  // Pack bits. One extra bit is reserved for padding of short-form sequences (see seq_compile())
+  if ((s->bits = (uint8_t *)q_malloc(nbits / 8 + 1, MEM_SEQUENCE)) == NULL)
     return CMD_FAILED;
 
+  memset(s->bits, 0, nbits / 8 + 1);
+  for (i = 0; i < nbits; i++)
+    if (argv[1][i] == '1')
+      s->bits[i >> 3] |= 0x80 >> (i & 7);
+  s->nbits = nbits;
+
   seq_compile(seq_num);
 
   return 0;
@@ -944,10 +1389,16 @@ static int cmd_seq_save(int argc, char **argv) {
 
   fprintf(fp, "\r\n// Sequence configuration\r\n");
   fprintf(fp, "sequence %u\r\n", seq_num);
+  // Profile goes first: it overwrites tick, alphabet and modulation, which are saved below
+  if (s->profile)
+    fprintf(fp, "  profile %s\r\n", s->profile->name);
   fprintf(fp, "  tick %.4f\r\n", s->tick);
-  // if we have bytes then we also have bits
-  if (s->bits)
-    fprintf(fp, "  bits %s\r\n", s->bits);
+  // sequences set by "bytes" are saved as bits
+  if (s->bits) {
+    fprintf(fp, "  bits ");
+    seq_print_bits(fp, s);
+    fprintf(fp, "\r\n");
+  }
   else if (s->seq) {
     fprintf(fp, "  levels");
     for (int i = 0; i < s->seq_len; i++)
@@ -1008,55 +1459,617 @@ static int cmd_seq_bytes(int argc, char **argv) {
   if (argc < 2)
     return CMD_MISSING_ARG;
 
-  // Read user input to a continous buffer
+  // Read user input to a continous buffer. Bytes are packed bits already
   len = userinput_join(argc, argv, 1, &out);
   if (len < 1 || !out) {
-cancel_and_return:
     q_print("% Out of memory");
     return CMD_FAILED;
   }
-  // allocate x8+1 byte for trailing zero
-  char *bits = (char *)q_malloc(len * 8 + 1, MEM_SEQUENCE);
-  if (!bits) {
-    q_free(out);
-    goto cancel_and_return;
-  }
-
-  // Convert bytes to bits and store them as an asciiz string in s->bits
-  // TODO: refactor. Use byte_encoder
-  int x = 0;
-  for (int byte = 0; byte < len; byte++) {
-    bits[x++] = '0' + ((out[byte] >> 7) & 1);
-    bits[x++] = '0' + ((out[byte] >> 6) & 1);
-    bits[x++] = '0' + ((out[byte] >> 5) & 1);
-    bits[x++] = '0' + ((out[byte] >> 4) & 1);
-    bits[x++] = '0' + ((out[byte] >> 3) & 1);
-    bits[x++] = '0' + ((out[byte] >> 2) & 1);
-    bits[x++] = '0' + ((out[byte] >> 1) & 1);
-    bits[x++] = '0' + ((out[byte] >> 0) & 1);
-  }
-  bits[x] = '\0';
-  seq_freemem(seq_num);
-  s->bits = bits;
-  s->bytes = out;
-  s->bytes_len = len;
 
-  q_printf("s->bytes=%p, s->bytes_len=%u\r\n", s->bytes, s->bytes_len);
+  seq_freemem(seq_num);
+  s->bits = (uint8_t *)out;
+  s->nbits = len * 8;
+  s->bytes = true;
 
   seq_compile(seq_num);
 
   return 0;
 }
 
-// decode
+// -- RMT decoder --
+//
+// Converts captured RMT symbols back to bits, using the sequence alphabet ("one" and "zero"). Durations are
+// allowed to be off by +/- TOLERANCE percent. Decoding stops at the end-of-frame marker (a zero duration),
+// at the first symbol which does not match the alphabet (e.g. a "tail"), or when the output buffer is full.
+//
+// Decoders are pluggable: ->decoder of a sequence points to a decoder function; NULL means the default
+// alphabet decoder, seq_decode()
+//
+#define SEQ_TOLERANCE 20         // default tolerance, percents
+#define SEQ_FRAME_MAX 256        // continuous capture: max frame length, RMT symbols
+#define SEQ_FRAME_BITS 2048      // max bits decoded from a single frame
+#define SEQ_RING_SIZE 2048       // continuous capture: ring buffer size, RMT symbols (8KB)
+
+// Duration range: reference value +/- tolerance
+struct seq_range {
+  uint16_t lo, hi;
+};
+
+#define IN_RANGE(_D, _R) ((_D) >= (_R).lo && (_D) <= (_R).hi)
+
+static void seq_range_set(struct seq_range *r, unsigned int ref, unsigned int tol) {
+
+  unsigned int delta = ref * tol / 100;
+
+  r->lo = ref > delta ? ref - delta : 1;
+  r->hi = ref + delta > 32767 ? 32767 : ref + delta;
+}
+
+// Append /count/ bits of value /bit/ to the packed bit string /bits/ which already has /nb/ bits
+// Returns new number of bits, not exceeding /max/
+//
+static unsigned int seq_put_bits(uint8_t *bits, unsigned int nb, unsigned int max, unsigned int bit, unsigned int count) {
+
+  while (count-- && nb < max) {
+    if (bit)
+      bits[nb >> 3] |= 0x80 >> (nb & 7);
+    else
+      bits[nb >> 3] &= ~(0x80 >> (nb & 7));
+    nb++;
+  }
+  return nb;
+}
+
+// Default decoder. Decodes up to /n/ symbols from /sym/ to packed bits /bits/ (up to /max/ bits).
+// Returns number of bits decoded; /*used/ is set to the number of symbols consumed
+//
+static unsigned int seq_decode(const struct sequence *s, const rmt_data_t *sym, unsigned int n, unsigned int tol, uint8_t *bits, unsigned int max, unsigned int *used) {
+
+  struct seq_range r[2][2];
+  unsigned int k, b, nb = 0;
+
+  for (b = 0; b < 2; b++) {
+    seq_range_set(&r[b][0], s->alph[b].duration0, tol);
+    seq_range_set(&r[b][1], s->alph[b].duration1, tol);
+  }
+
+  if (s->alph[0].duration1) {
+    // long form: a symbol is a bit. Skip the "head", stop on the "tail" or on any unknown symbol
+    struct seq_range h[2];
+
+    seq_range_set(&h[0], s->ht[0].duration0, tol);
+    seq_range_set(&h[1], s->ht[0].duration1, tol);
+
+    for (k = 0; k < n && nb < max; k++) {
+
+      const rmt_data_t *p = &sym[k];
+
+      if (!p->duration0)
+        break;
+
+      if (k == 0 && s->ht[0].duration0 && p->level0 == s->ht[0].level0 && IN_RANGE(p->duration0, h[0]) && IN_RANGE(p->duration1, h[1]))
+        continue;
+
+      // Zero duration1 is the last symbol of a frame: its second level merged with the idle line. Only
+      // the first level can be matched, so it must be unambiguous
+      if (!p->duration1) {
+        bool m0 = (p->level0 == s->alph[0].level0 && IN_RANGE(p->duration0, r[0][0])),
+             m1 = (p->level0 == s->alph[1].level0 && IN_RANGE(p->duration0, r[1][0]));
+        if (m0 == m1)
+          break;
+        b = m1;
+      } else {
+        for (b = 0; b < 2; b++)
+          if (p->level0 == s->alph[b].level0 && IN_RANGE(p->duration0, r[b][0]) &&
+              p->level1 == s->alph[b].level1 && IN_RANGE(p->duration1, r[b][1]))
+            break;
+        if (b > 1)
+          break;
+      }
+      nb = seq_put_bits(bits, nb, max, b, 1);
+    }
+  } else {
+    // short form: a level is a bit. RMT receiver merges consecutive equal levels, so when "one" and "zero"
+    // have different levels (NRZ) the bit count is restored from the duration
+    bool nrz = s->alph[0].level0 != s->alph[1].level0;
+
+    for (k = 0; k < n && nb < max; k++) {
+
+      unsigned int half, level, d;
+
+      for (half = 0; half < 2; half++) {
+
+        level = half ? sym[k].level1 : sym[k].level0;
+        d = half ? sym[k].duration1 : sym[k].duration0;
+
+        if (!d)
+          goto done;
+
+        if (nrz) {
+          unsigned int ref, cnt, delta;
+
+          b = (level == s->alph[1].level0);
+          ref = s->alph[b].duration0;
+          cnt = (d + ref / 2) / ref;
+          delta = cnt * ref > d ? cnt * ref - d : d - cnt * ref;
+          if (!cnt || delta > ref * tol / 100)
+            goto done;
+          nb = seq_put_bits(bits, nb, max, b, cnt);
+        } else {
+          if (IN_RANGE(d, r[0][0]))
+            b = 0;
+          else if (IN_RANGE(d, r[1][0]))
+            b = 1;
+          else
+            goto done;
+          nb = seq_put_bits(bits, nb, max, b, 1);
+        }
+      }
+    }
+  }
+done:
+  *used = k;
+  return nb;
+}
+
+// -- Protocol profiles --
+//
+// A profile (struct seq_profile) describes a pulse protocol declaratively: tick, alphabet, head and tail,
+// carrier frequency, frame length and bit order. "profile NAME" loads these into the sequence.
+//
+// Each profile also has specialized routines: pack() builds a frame from an address and a command, which
+// is then written directly to packed bits ("frame ADDRESS COMMAND"), and unpack() recognizes decoded frames.
+// Protocols which can not be decoded by the alphabet decoder (Manchester coded RC5) have their own decoder
+//
+
+// RMT symbol initializer
+#define SYM(_L0, _D0, _L1, _D1) { .duration0 = (_D0), .level0 = (_L0), .duration1 = (_D1), .level1 = (_L1) }
+
+// NEC: address, ~address, command, ~command; LSB first. Extended NEC has 16-bit address instead of address, ~address
+//
+static uint64_t seq_nec_pack(uint32_t addr, uint32_t cmd) {
+  uint32_t a = addr > 0xff ? (addr & 0xffff) : ((addr & 0xff) | ((~addr & 0xff) << 8));
+  return a | ((cmd & 0xff) << 16) | ((~cmd & 0xffUL) << 24);
+}
+
+static bool seq_nec_unpack(uint64_t f, uint32_t *addr, uint32_t *cmd) {
+  if (((f >> 16) & 0xff) != (~(f >> 24) & 0xff))
+    return false;
+  *cmd = (f >> 16) & 0xff;
+  *addr = (f & 0xff) == (~(f >> 8) & 0xff) ? (f & 0xff) : (f & 0xffff);
+  return true;
+}
+
+// Samsung: address, address, command, ~command; LSB first
+//
+static uint64_t seq_samsung_pack(uint32_t addr, uint32_t cmd) {
+  return (addr & 0xff) | ((addr & 0xff) << 8) | ((cmd & 0xff) << 16) | ((~cmd & 0xffUL) << 24);
+}
+
+static bool seq_samsung_unpack(uint64_t f, uint32_t *addr, uint32_t *cmd) {
+  if ((f & 0xff) != ((f >> 8) & 0xff) || ((f >> 16) & 0xff) != (~(f >> 24) & 0xff))
+    return false;
+  *addr = f & 0xff;
+  *cmd = (f >> 16) & 0xff;
+  return true;
+}
+
+// LG: 8-bit address, 16-bit command, 4-bit checksum (sum of command nibbles); MSB first
+//
+static unsigned int seq_lg_csum(uint32_t cmd) {
+  return (cmd + (cmd >> 4) + (cmd >> 8) + (cmd >> 12)) & 0xf;
+}
+
+static uint64_t seq_lg_pack(uint32_t addr, uint32_t cmd) {
+  return ((addr & 0xff) << 20) | ((cmd & 0xffff) << 4) | seq_lg_csum(cmd & 0xffff);
+}
+
+static bool seq_lg_unpack(uint64_t f, uint32_t *addr, uint32_t *cmd) {
+  if (seq_lg_csum((f >> 4) & 0xffff) != (f & 0xf))
+    return false;
+  *addr = (f >> 20) & 0xff;
+  *cmd = (f >> 4) & 0xffff;
+  return true;
+}
+
+// RC5: start bit, field bit (inverted bit 6 of the command), toggle bit, 5-bit address, 6-bit command; MSB first
+//
+static uint64_t seq_rc5_pack(uint32_t addr, uint32_t cmd) {
+  return (1 << 13) | ((cmd & 0x40) ? 0 : (1 << 12)) | ((addr & 0x1f) << 6) | (cmd & 0x3f);
+}
+
+static bool seq_rc5_unpack(uint64_t f, uint32_t *addr, uint32_t *cmd) {
+  if (!(f & (1 << 13)))
+    return false;
+  *addr = (f >> 6) & 0x1f;
+  *cmd = (f & 0x3f) | ((f & (1 << 12)) ? 0 : 0x40);
+  return true;
+}
+
+// Manchester decoder (RC5). Every bit is two half-bit levels: "zero" and "one" have opposite levels.
+// Receiver merges equal adjacent halves, so a captured level lasts one or two half-bits. The first half of
+// the first bit is the idle line and is not captured, the same is true for the last half of the last bit.
+//
+static unsigned int seq_decode_manchester(const struct sequence *s, const rmt_data_t *sym, unsigned int n, unsigned int tol, uint8_t *bits, unsigned int max, unsigned int *used) {
+
+  struct seq_range r1, r2;
+  unsigned int k = 0, half, level, d, cnt, nb = 0;
+  int first = -1;   // level of the first half of the current bit, -1 if no half received yet
+
+  seq_range_set(&r1, s->alph[0].duration0, tol);
+  seq_range_set(&r2, s->alph[0].duration0 * 2, tol);
+
+  if (n && sym[0].duration0)
+    first = !sym[0].level0;
+
+  for (; k < n && nb < max; k++)
+    for (half = 0; half < 2; half++) {
+
+      level = half ? sym[k].level1 : sym[k].level0;
+      d = half ? sym[k].duration1 : sym[k].duration0;
+
+      // End of frame: the missing last half is the idle line
+      if (!d)
+        goto done;
+
+      if (IN_RANGE(d, r1))
+        cnt = 1;
+      else if (IN_RANGE(d, r2))
+        cnt = 2;
+      else
+        goto done;
+
+      while (cnt--)
+        if (first < 0)
+          first = level;
+        else if (first == (int)level)
+          goto done;    // no transition in the middle of a bit
+        else {
+          nb = seq_put_bits(bits, nb, max, first == s->alph[1].level0, 1);
+          first = -1;
+        }
+    }
+done:
+  if (first >= 0 && nb < max)
+    nb = seq_put_bits(bits, nb, max, first == s->alph[1].level0, 1);
+  *used = k;
+  return nb;
+}
+
+// Profile registry. Timings are in microseconds (tick is 1us)
 //
+static const struct seq_profile seq_profiles[] = {
+  { "nec",     1, 38000, 0.33, { SYM(1, 560, 0, 560), SYM(1, 560, 0, 1690) }, { SYM(1, 9000, 0, 4500), SYM(1, 560, 0, 0) },
+               32, false, seq_nec_pack, seq_nec_unpack, NULL },
+  { "samsung", 1, 38000, 0.33, { SYM(1, 560, 0, 560), SYM(1, 560, 0, 1690) }, { SYM(1, 4500, 0, 4500), SYM(1, 560, 0, 0) },
+               32, false, seq_samsung_pack, seq_samsung_unpack, NULL },
+  { "lg",      1, 38000, 0.33, { SYM(1, 560, 0, 560), SYM(1, 560, 0, 1690) }, { SYM(1, 9000, 0, 4500), SYM(1, 560, 0, 0) },
+               28, true,  seq_lg_pack, seq_lg_unpack, NULL },
+  // RC5: "zero" is mark-space, "one" is space-mark, 889us each. No head and tail
+  { "rc5",     1, 36000, 0.25, { SYM(1, 889, 0, 889), SYM(0, 889, 1, 889) },  { SYM(0, 0, 0, 0), SYM(0, 0, 0, 0) },
+               14, true,  seq_rc5_pack, seq_rc5_unpack, seq_decode_manchester },
+};
+
+#undef SYM
+
+// Convert a frame value to packed bits and back, according to the bit order of the profile
 //
-static UNUSED int cmd_seq_decode(int argc, char **argv) {
-  q_print("% RTM-RX: Not implemented yet, wait for the next version\r\n");
+static void seq_frame2bits(const struct seq_profile *p, uint64_t frame, uint8_t *bits) {
+  for (unsigned int i = 0; i < p->nbits; i++)
+    seq_put_bits(bits, i, p->nbits, (frame >> (p->msb ? p->nbits - 1 - i : i)) & 1, 1);
+}
+
+static uint64_t seq_bits2frame(const struct seq_profile *p, const uint8_t *bits) {
+  uint64_t frame = 0;
+  for (unsigned int i = 0; i < p->nbits; i++)
+    if ((bits[i >> 3] >> (7 - (i & 7))) & 1)
+      frame |= 1ULL << (p->msb ? p->nbits - 1 - i : i);
+  return frame;
+}
+
+// Decode a frame and print the result: "% Frame #N: X symbols, Y bits: 0x1f 0x3c ..."
+//
+static void seq_decode_print(const struct sequence *s, unsigned int frame, const rmt_data_t *sym, unsigned int n, unsigned int tol) {
+
+  uint8_t bits[SEQ_FRAME_BITS / 8];
+  unsigned int used, nb, i;
+
+  nb = (s->decoder ? s->decoder : seq_decode)(s, sym, n, tol, bits, SEQ_FRAME_BITS, &used);
+
+  q_printf("%% Frame #%u: %u symbol%s, %u bit%s", frame, PPA(n), PPA(nb));
+  if (nb) {
+    q_print(":");
+    for (i = 0; i < (nb + 7) / 8; i++)
+      q_printf(" %02x", bits[i]);
+  }
+  if (used < n && sym[used].duration0)
+    q_printf(" <i>(stopped at symbol %u)</>", used);
+
+  // Frame of a known protocol?
+  if (s->profile && nb == s->profile->nbits) {
+    uint32_t addr, cmd;
+    if (s->profile->unpack(seq_bits2frame(s->profile, bits), &addr, &cmd))
+      q_printf(", <i>%s: address 0x%lx, command 0x%lx</>", s->profile->name, (unsigned long)addr, (unsigned long)cmd);
+  }
+  q_print("\r\n");
+}
+
+// "decode [TOLERANCE] [FILE]"
+//
+// Decode sequence levels (e.g. captured by "capture") to bits, which replace current bits of the sequence.
+// With FILE argument a symbol dump (written by "capture PIN continuous ... FILE") is decoded frame by frame
+//
+static int cmd_seq_decode(int argc, char **argv) {
+
+  unsigned int tol = SEQ_TOLERANCE, used, nb;
+  uint8_t *bits;
+  int i = 1;
+
+  THIS_SEQUENCE(s);
+
+  if (!s->alph[0].duration0 || !s->alph[1].duration0) {
+    q_print("% <e>Set the alphabet first: \"one\" and \"zero\"</>\r\n");
+    return CMD_FAILED;
+  }
+
+  if (argc > i && isnum(argv[i])) {
+    if ((tol = q_atol(argv[i], SEQ_TOLERANCE)) > 100)
+      return i;
+    i++;
+  }
+
+#if WITH_FS
+  if (argc > i) {
+
+    rmt_data_t *buf;
+    unsigned int n = 0, z, frames = 0, syms = 0;
+    uint64_t t0;
+    size_t rd;
+    FILE *fp;
+
+    if ((fp = files_fopen(argv[i], "rb")) == NULL)
+      return CMD_FAILED;
+
+    if ((buf = (rmt_data_t *)q_malloc(SEQ_FRAME_MAX * sizeof(rmt_data_t), MEM_TMP)) == NULL) {
+      files_fclose(fp);
+      return CMD_FAILED;
+    }
+
+    t0 = q_micros();
+
+    // Read the dump, split it to frames by zero symbols. Frames longer than the buffer are split
+    do {
+      rd = fread(buf + n, sizeof(rmt_data_t), SEQ_FRAME_MAX - n, fp);
+      n += rd;
+      while (n) {
+        for (z = 0; z < n && buf[z].val; z++)
+          ;
+        if (z == n && rd && n < SEQ_FRAME_MAX)
+          break; // incomplete frame, read more
+        if (z)
+          seq_decode_print(s, frames++, buf, z, tol);
+        syms += z;
+        if (z < n)
+          z++; // skip frame separator
+        memmove(buf, buf + z, (n - z) * sizeof(rmt_data_t));
+        n -= z;
+      }
+    } while (rd);
+
+    t0 = q_micros() - t0;
+    q_free(buf);
+    files_fclose(fp);
+
+    q_printf("%% %u frame%s, %u symbol%s decoded\r\n", PPA(frames), PPA(syms));
+    VERBOSE(q_printf("%% Decoding (with output) took %llu us\r\n", t0));
+    return 0;
+  }
+#endif
+
+  if (!s->seq) {
+    q_print("% <e>Nothing to decode: sequence has no levels. Use \"capture\" or \"levels\"</>\r\n");
+    return CMD_FAILED;
+  }
+
+  // Long form: 1 bit per symbol; short form: bits restored from durations, can be many per symbol
+  if ((bits = (uint8_t *)q_malloc(SEQ_FRAME_BITS / 8 + 1, MEM_SEQUENCE)) == NULL)
+    return CMD_FAILED;
+
+  nb = (s->decoder ? s->decoder : seq_decode)(s, s->seq, s->seq_len, tol, bits, SEQ_FRAME_BITS, &used);
+  if (!nb) {
+    q_free(bits);
+    q_print("% <e>Levels do not match the alphabet</>\r\n");
+    return CMD_FAILED;
+  }
+
+  // Replace bits. Levels are kept: they are what was captured
+  if (s->bits)
+    q_free(s->bits);
+  s->bits = bits;
+  s->nbits = nb;
+  s->bytes = false;
+
+  q_printf("%% Decoded %u bit%s from %u symbol%s\r\n", PPA(nb), PPA(used));
+  if (used < (unsigned int)s->seq_len && s->seq[used].duration0)
+    q_printf("%% Decoding stopped at symbol #%u: it does not match the alphabet\r\n", used);
+  HELP(q_print("% Use \"show\" to display decoded bits\r\n"));
   return 0;
 }
 
+// -- Continuous capture --
+//
+// Received frames are appended to a ring buffer of SEQ_RING_SIZE symbols, frames are separated by a zero
+// symbol. Oldest frames are overwritten. When capture stops, whole frames from the ring (separators
+// removed) become sequence levels.
+// Frames can also be written to a file (raw rmt_data_t, same zero separators) and decoded on the fly
+//
+struct seq_ring {
+  rmt_data_t *buf;
+  unsigned int head;     // next write position
+  unsigned int len;      // number of valid symbols
+  bool wrapped;          // oldest symbols were overwritten: the first frame in the ring is incomplete
+};
+
+static void seq_ring_push(struct seq_ring *r, const rmt_data_t *sym, unsigned int n) {
+
+  while (n--) {
+    r->buf[r->head] = *sym++;
+    r->head = (r->head + 1) % SEQ_RING_SIZE;
+    if (r->len < SEQ_RING_SIZE)
+      r->len++;
+    else
+      r->wrapped = true;
+  }
+}
+
+// Copy ring content, oldest symbols first. /out/ must have room for r->len symbols
+//
+static void seq_ring_copy(const struct seq_ring *r, rmt_data_t *out) {
+
+  unsigned int tail = (r->head + SEQ_RING_SIZE - r->len) % SEQ_RING_SIZE,
+               n = SEQ_RING_SIZE - tail < r->len ? SEQ_RING_SIZE - tail : r->len;
+
+  memcpy(out, r->buf + tail, n * sizeof(rmt_data_t));
+  memcpy(out + n, r->buf, (r->len - n) * sizeof(rmt_data_t));
+}
+
+// Keep whole frames only: drop the partially overwritten oldest frame and remove frame separators, so
+// the result can be transmitted. /seq/ holds /len/ symbols copied by seq_ring_copy().
+// Returns the new length, /frames/ is set to the number of frames kept
+//
+static unsigned int seq_ring_frames(const struct seq_ring *r, rmt_data_t *seq, unsigned int len, unsigned int *frames) {
+
+  unsigned int i = 0, j = 0;
+
+  *frames = 0;
+
+  if (r->wrapped)
+    while (i < len && seq[i++].val)
+      ;
+
+  for (; i < len; i++)
+    if (seq[i].val)
+      seq[j++] = seq[i];
+    else
+      (*frames)++;
+
+  return j;
+}
+
+// "capture PIN continuous [decode] [FILE]"
+// RMT receiver is already initialized by cmd_seq_capture(): every exit path must go through "stop", which
+// shuts the receiver down
+//
+static int seq_capture_continuous(struct sequence *s, unsigned int seq_num, unsigned int pin, int argc, char **argv) {
+
+  struct seq_ring ring = { 0 };
+  rmt_data_t *frame = NULL;
+  bool decode = false, fg = is_foreground_task();
+  unsigned int frames = 0, kept = 0, saved = 0, tol = SEQ_TOLERANCE;
+  size_t len;
+  FILE *fp = NULL;
+  int i, file = 0, ret = 0;
+
+  for (i = 3; i < argc; i++)
+    if (!q_strcmp(argv[i], "decode")) {
+      if (!s->alph[0].duration0 || !s->alph[1].duration0) {
+        q_print("% <e>Set the alphabet first: \"one\" and \"zero\"</>\r\n");
+        ret = CMD_FAILED;
+        goto stop;
+      }
+      decode = true;
+    } else if (file || !WITH_FS) {
+      ret = i;
+      goto stop;
+    } else
+      file = i;
+
+#if WITH_FS
+  if (file && (fp = files_fopen(argv[file], "wb")) == NULL) {
+    ret = CMD_FAILED;
+    goto stop;
+  }
+#endif
+
+  frame = (rmt_data_t *)q_malloc(SEQ_FRAME_MAX * sizeof(rmt_data_t), MEM_SEQUENCE);
+  ring.buf = (rmt_data_t *)q_malloc(SEQ_RING_SIZE * sizeof(rmt_data_t), MEM_SEQUENCE);
+
+  if (!frame || !ring.buf) {
+    q_print("% Out of memory\r\n");
+    ret = CMD_FAILED;
+    goto stop;
+  }
+
+  HELP(q_printf("%% Capturing frames on GPIO#%u => sequence#%u, %s to stop\r\n", pin, seq_num, fg ? "press <Enter>" : "use \"kill\""));
+
+  while (true) {
+
+    len = SEQ_FRAME_MAX;
+    rmtReadAsync(pin, frame, &len);
+
+    // Wait for a frame. Receiver finishes a frame after ->idle_thresh ticks of silence
+    while (!rmtReceiveCompleted(pin))
+      if ((fg && anykey_pressed()) || delay_interruptible(TIMO_QUANTUM) != TIMO_QUANTUM)
+        goto stop;
+
+    if (!len)
+      continue;
+
+    seq_ring_push(&ring, frame, len);
+    seq_ring_push(&ring, &(rmt_data_t){ 0 }, 1);
+#if WITH_FS
+    if (fp) {
+      rmt_data_t zero = { 0 };
+      if (fwrite(frame, sizeof(rmt_data_t), len, fp) != len || fwrite(&zero, sizeof(zero), 1, fp) != 1) {
+        q_printf("%% <e>Write error, \"%s\"</>\r\n", argv[file]);
+        ret = CMD_FAILED;
+        goto stop;
+      }
+    }
+#endif
+    if (decode)
+      seq_decode_print(s, frames, frame, len, tol);
+    frames++;
+  }
+
+stop:
+  // Here we heavily depend on Arduino/Periman logic to stop reception and graceful RMT shutdown
+  pinMode(pin, INPUT);
+#if WITH_FS
+  if (fp)
+    files_fclose(fp);
+#endif
+  if (frame)
+    q_free(frame);
+
+  // Capture has not started (bad arguments or out of memory)
+  if (!ring.buf || (ret && !frames)) {
+    if (ring.buf)
+      q_free(ring.buf);
+    return ret;
+  }
+
+  // Whole frames from the ring become sequence levels
+  if (ring.len > 1) {
+    rmt_data_t *seq = (rmt_data_t *)q_malloc(ring.len * sizeof(rmt_data_t), MEM_SEQUENCE);
+    if (seq) {
+      seq_ring_copy(&ring, seq);
+      if ((saved = seq_ring_frames(&ring, seq, ring.len, &kept)) != 0) {
+        seq_freemem(seq_num);
+        s->seq = seq;
+        s->seq_len = saved;
+      } else
+        q_free(seq);
+    } else
+      q_print("% Out of memory, captured frames are not saved\r\n");
+  }
+  q_printf("%% Captured %u frame%s, last %u frame%s (%u symbols) are saved in sequence#%u\r\n", PPA(frames), PPA(saved ? kept : 0), saved, seq_num);
+  q_free(ring.buf);
+  return ret;
+}
+
 // capture PIN [SYM_NUM|all] [TIMEOUT_MILLIS]
+// capture PIN continuous [decode] [FILE]
 //
 static int cmd_seq_capture(int argc, char **argv) {
 
@@ -1065,6 +2078,7 @@ static int cmd_seq_capture(int argc, char **argv) {
   size_t rbuf_size = 32;  // rx buffer length (symbols count)
   uint32_t num_syms = 0;  // requested symbols count
   uint32_t timo = 2000;   // rx timeout if >0
+  bool continuous = false; // "capture PIN continuous ..."
   int seq_idx;
 
   THIS_SEQUENCE(s);
@@ -1079,7 +2093,9 @@ static int cmd_seq_capture(int argc, char **argv) {
     return 1;
 
   // Read symbols count and the timeout value
-  if (argc > 2) {
+  if (argc > 2 && !q_strcmp(argv[2], "continuous"))
+    continuous = true;
+  else if (argc > 2) {
     num_syms = q_atol(argv[2], num_syms);
     if (num_syms)
       rbuf_size = num_syms;
@@ -1119,6 +2135,11 @@ static int cmd_seq_capture(int argc, char **argv) {
                       s->mod_freq,
                       s->mod_duty)) {
 
+      if (continuous) {
+        q_free(rbuf);
+        return seq_capture_continuous(s, seq_idx, pin, argc, argv);
+      }
+
       // Start async read
       HELP(q_printf("%% Capturing on GPIO#%u => sequence#%u (max %u symbols, demod:%u Hz)...\r\n", pin, seq_idx, rbuf_size, s->mod_freq));
       rmtReadAsync(pin, rbuf, &rbuf_size);
@@ -1192,13 +2213,94 @@ stop_and_exit:
   return CMD_FAILED;
 }
 
-// "profile nec|samsung|lg|lg32"
+// "profile nec|samsung|lg|rc5|none"
 //
+// Load protocol presets: tick, alphabet, head and tail, modulation. "none" detaches the profile but
+// keeps current settings
 //
+static int cmd_seq_profile(int argc, char **argv) {
+
+  const struct seq_profile *p = NULL;
+  unsigned int i;
+
+  THIS_SEQUENCE(s);
+
+  if (argc < 2)
+    return CMD_MISSING_ARG;
+
+  if (!q_strcmp(argv[1], "none")) {
+    s->profile = NULL;
+    s->decoder = NULL;
+    return 0;
+  }
+
+  for (i = 0; i < sizeof(seq_profiles) / sizeof(seq_profiles[0]); i++)
+    if (!q_strcmp(argv[1], seq_profiles[i].name)) {
+      p = &seq_profiles[i];
+      break;
+    }
+
+  if (!p) {
+    q_print("% <e>Unknown profile. Available profiles are:</>");
+    for (i = 0; i < sizeof(seq_profiles) / sizeof(seq_profiles[0]); i++)
+      q_printf(" %s", seq_profiles[i].name);
+    q_print(" none\r\n");
+    return 1;
+  }
+
+  s->tick = p->tick;
+  s->mod_freq = p->mod_freq;
+  s->mod_duty = p->mod_duty;
+  s->mod_high = 1;
+  memcpy(s->alph, p->alph, sizeof(s->alph));
+  memcpy(s->ht, p->ht, sizeof(s->ht));
+  s->profile = p;
+  s->decoder = p->decoder;
+
+  // Alphabet has changed: recompile bits, if any. Levels set by "levels" or "capture" are kept
+  if (s->bits) {
+    seq_drop_levels(seq_num);
+    seq_compile(seq_num);
+  }
 
-static UNUSED int cmd_seq_profile(int argc, char **argv) {
-  q_print("% RTM-RX: Not implemented yet, wait for the next version\r\n");
+  HELP(q_printf("%% Profile \"%s\" loaded. Use \"frame ADDRESS COMMAND\" to set bits\r\n", p->name));
   return 0;
 }
 
+// "frame ADDRESS COMMAND"
+//
+// Build a frame according to the sequence profile. Bits are written directly in the packed form
+//
+static int cmd_seq_frame(int argc, char **argv) {
+
+  const struct seq_profile *p;
+  uint32_t addr, cmd;
+
+  THIS_SEQUENCE(s);
+
+  if (argc < 3)
+    return CMD_MISSING_ARG;
+
+  if ((p = s->profile) == NULL) {
+    q_print("% <e>Load a protocol profile first (command \"profile\")</>\r\n");
+    return CMD_FAILED;
+  }
+
+  if ((addr = q_atol(argv[1], DEF_BAD)) == DEF_BAD)
+    return 1;
+  if ((cmd = q_atol(argv[2], DEF_BAD)) == DEF_BAD)
+    return 2;
+
+  seq_freemem(seq_num);
+
+  // One extra bit is reserved for padding of short-form sequences, as cmd_seq_bits() does
+  if ((s->bits = (uint8_t *)q_malloc(p->nbits / 8 + 1, MEM_SEQUENCE)) == NULL)
+    return CMD_FAILED;
+
+  seq_frame2bits(p, p->pack(addr, cmd), s->bits);
+  s->nbits = p->nbits;
+
+  return seq_compile(seq_num) < 0 ? CMD_FAILED : 0;
+}
+
 #endif
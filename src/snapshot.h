@@ -0,0 +1,720 @@
+/*
+ * This file is a part of the ESPShell Arduino library (Espressif's ESP32-family CPUs)
+ *
+ * Latest source code can be found at Github: https://github.com/vvb333007/espshell/
+ * Stable releases: https://github.com/vvb333007/espshell/tags
+ *
+ * Feel free to use this code as you wish: it is absolutely free for commercial and
+ * non-commercial, education purposes.  Credits, however, would be greatly appreciated.
+ *
+ * Author: Viacheslav Logunov <vvb333007@gmail.com>
+ */
+
+// -- Binary configuration snapshots --
+//
+// "snapshot save /FILE" and "snapshot load /FILE"
+//
+// Text configuration files (see "if save", sequence's "save") are human-readable, but restoring them means
+// tokenizing and parsing every line and going through the command processor: with hundreds of rules this
+// takes a while. A snapshot is a binary image of aliases (lines are stored pre-tokenized), "if"/"every"
+// conditions and sequences, which is read with a single fread() and then decoded in place: tokens are copied
+// and pointers are fixed up, no parsing involved.
+//
+// File layout: a header (struct snap_hdr) followed by records. Every record starts with a struct snap_rec,
+// its payload is padded to 4 bytes. All values are in CPU native byte order: snapshots are not meant to be
+// portable between different architectures.
+//
+// Snapshots are versioned: files with a different SNAP_VERSION are rejected, use text export to migrate
+//
+// Aliases with the same names are replaced; conditions are added (as "exec" of a text file does); sequences
+// are replaced.
+//
+
+#if COMPILING_ESPSHELL
+#if WITH_ALIAS && WITH_FS
+
+#define SNAP_MAGIC   0x504e5345  // "ESNP"
+#define SNAP_VERSION 4  // 2: 64 bit variable values in conditions, 3: packed sequence bits, 4: sequence profile
+
+// Record types
+#define SNAP_ALIAS    1
+#define SNAP_IFCOND   2
+#define SNAP_SEQUENCE 3
+
+// Round up to 4 bytes
+#define SNAP_ALIGN(_Len) (((_Len) + 3) & ~3UL)
+
+struct snap_hdr {
+  uint32_t magic;      // SNAP_MAGIC
+  uint16_t version;    // SNAP_VERSION
+  uint16_t hdr_size;   // sizeof(struct snap_hdr)
+  uint32_t size;       // file size, including the header
+  uint32_t hash;       // FNV-1a hash of everything after the header
+  uint16_t naliases;   // number of records of each type, for information only
+  uint16_t nifconds;
+  uint16_t nseqs;
+  uint16_t reserved;
+};
+
+struct snap_rec {
+  uint8_t  type;       // SNAP_ALIAS, SNAP_IFCOND or SNAP_SEQUENCE
+  uint8_t  reserved;
+  uint16_t reserved2;
+  uint32_t len;        // payload length, not counting this structure. Multiple of 4
+};
+
+// Alias: a struct snap_alias, the name (asciiz), then /nlines/ lines.
+// Every line is a struct snap_line followed by /argc/ asciiz tokens
+struct snap_alias {
+  uint16_t name_len;   // including the '\0'
+  uint16_t nlines;
+};
+
+struct snap_line {
+  uint16_t argc;
+  uint16_t text_len;   // length of all tokens, including their '\0's
+  uint8_t  has_amp;    // "&" flags, see struct argcargv
+  uint8_t  has_prio;
+  uint8_t  prio;
+   int8_t  core;
+};
+
+// "if" or "every": a struct snap_ifcond, the variable name (asciiz, if var_name_len != 0), then the alias name (asciiz)
+struct snap_ifcond {
+  uint8_t     trigger_pin;
+  uint8_t     rising;
+  uint8_t     is_inline;
+  uint8_t     disabled;
+  uint32_t    poll_interval;
+  uint32_t    delay_ms;         // 0 == no delay
+  uint32_t    limit;            // 0 == no limit
+  uint16_t    rlimit;           // 0 == no rate limit
+  uint16_t    var_name_len;     // 0 == no variable condition
+  uint32_t    high, high1;
+  uint32_t    low, low1;
+  composite_t var_imm;          // variable condition: same as struct convar_cond
+  uint8_t     var_size;
+  uint8_t     var_type;
+  uint8_t     var_op;
+  uint8_t     reserved;
+  uint16_t    exec_len;         // alias name length, including the '\0'
+  uint16_t    reserved2;
+};
+
+// Sequence: a struct snap_seq, /seq_len/ rmt_data_t, then packed bits ((nbits + 7) / 8 bytes)
+struct snap_seq {
+  uint8_t    num;               // sequence number
+  uint8_t    mod_high;
+  uint8_t    filter_ns;
+  uint8_t    eot;
+  float      tick;
+  float      mod_duty;
+  uint32_t   mod_freq;
+  uint32_t   loop_count;
+  uint16_t   idle_thresh;
+  uint8_t    bytes;             // bits were set by "bytes"
+  uint8_t    profile;           // protocol profile: index in seq_profiles[] + 1, 0 == no profile
+  uint32_t   nbits;
+  int32_t    seq_len;
+  rmt_data_t alph[2];
+  rmt_data_t ht[2];
+};
+
+// FNV-1a hash of a memory buffer. /h/ is the hash of previous data, or 2166136261UL
+//
+static uint32_t snap_hash(uint32_t h, const void *buf, size_t len) {
+  const unsigned char *p = (const unsigned char *)buf;
+  while (len--) {
+    h ^= *p++;
+    h *= 16777619UL;
+  }
+  return h;
+}
+
+// Snapshot writer state
+struct snap_writer {
+  FILE    *fp;
+  uint32_t size;                // bytes written, including the header
+  uint32_t hash;
+  bool     error;
+};
+
+// Write /len/ bytes to the snapshot file
+//
+static void snap_write(struct snap_writer *w, const void *buf, size_t len) {
+  if (!w->error && len) {
+    if (fwrite(buf, 1, len, w->fp) != len)
+      w->error = true;
+    w->hash = snap_hash(w->hash, buf, len);
+    w->size += len;
+  }
+}
+
+// Pad the record payload to 4 bytes
+//
+static void snap_write_pad(struct snap_writer *w, size_t len) {
+  static const uint8_t zero[4] = { 0 };
+  snap_write(w, zero, SNAP_ALIGN(len) - len);
+}
+
+// Write a record header
+//
+static void snap_write_rec(struct snap_writer *w, uint8_t type, size_t len) {
+  struct snap_rec rec = { .type = type, .len = SNAP_ALIGN(len) };
+  snap_write(w, &rec, sizeof(rec));
+}
+
+// Save an alias. Alias must be locked by the caller
+//
+static void snap_save_alias(struct snap_writer *w, struct alias *al) {
+
+  struct snap_alias sa = { 0 };
+  struct snap_line sl;
+  argcargv_t *p;
+  size_t len;
+  int i;
+
+  sa.name_len = strlen(al->name) + 1;
+  len = sizeof(sa) + sa.name_len;
+
+  // calculate the payload length first
+  for (p = al->lines; p; p = p->next, sa.nlines++) {
+    len += sizeof(sl);
+    for (i = 0; i < p->argc; i++)
+      len += strlen(p->argv[i]) + 1;
+  }
+
+  snap_write_rec(w, SNAP_ALIAS, len);
+  snap_write(w, &sa, sizeof(sa));
+  snap_write(w, al->name, sa.name_len);
+
+  for (p = al->lines; p; p = p->next) {
+    sl.argc = p->argc;
+    sl.has_amp = p->has_amp;
+    sl.has_prio = p->has_prio;
+    sl.prio = p->prio;
+    sl.core = p->core;
+    for (sl.text_len = 0, i = 0; i < p->argc; i++)
+      sl.text_len += strlen(p->argv[i]) + 1;
+    snap_write(w, &sl, sizeof(sl));
+    for (i = 0; i < p->argc; i++)
+      snap_write(w, p->argv[i], strlen(p->argv[i]) + 1);
+  }
+  snap_write_pad(w, len);
+}
+
+// Save an ifcond. ifc_rw must be locked by the caller
+//
+static void snap_save_ifcond(struct snap_writer *w, struct ifcond *ifc) {
+
+  struct snap_ifcond si = { 0 };
+  size_t len;
+
+  si.trigger_pin = ifc->trigger_pin;
+  si.rising = ifc->trigger_rising;
+  si.is_inline = ifc->is_inline;
+  si.disabled = ifc->disabled;
+  si.poll_interval = ifc->poll_interval;
+  si.delay_ms = ifc->has_delay ? ifc->delay_ms : 0;
+  si.limit = ifc->has_limit ? ifc->limit : 0;
+  si.rlimit = ifc->has_rlimit ? ifc->rlimit : 0;
+  si.high = ifc->high;
+  si.high1 = ifc->high1;
+  si.low = ifc->low;
+  si.low1 = ifc->low1;
+  if (ifc->has_var && ifc->var.name) {
+    si.var_name_len = strlen(ifc->var.name) + 1;
+    si.var_imm = ifc->var.imm;
+    si.var_size = ifc->var.size;
+    si.var_type = ifc->var.type;
+    si.var_op = ifc->var.op;
+  }
+  si.exec_len = strlen(ifc->exec->name) + 1;
+
+  len = sizeof(si) + si.var_name_len + si.exec_len;
+  snap_write_rec(w, SNAP_IFCOND, len);
+  snap_write(w, &si, sizeof(si));
+  if (si.var_name_len)
+    snap_write(w, ifc->var.name, si.var_name_len);
+  snap_write(w, ifc->exec->name, si.exec_len);
+  snap_write_pad(w, len);
+}
+
+// Save a sequence
+//
+static void snap_save_seq(struct snap_writer *w, unsigned int num) {
+
+  struct sequence *s = &sequences[num];
+  struct snap_seq ss = { 0 };
+  size_t len;
+
+  ss.num = num;
+  ss.tick = s->tick;
+  ss.mod_duty = s->mod_duty;
+  ss.mod_freq = s->mod_freq;
+  ss.mod_high = s->mod_high;
+  ss.filter_ns = s->filter_ns;
+  ss.eot = s->eot;
+  ss.idle_thresh = s->idle_thresh;
+  ss.loop_count = s->loop_count;
+  ss.seq_len = s->seq ? s->seq_len : 0;
+  ss.nbits = s->bits ? s->nbits : 0;
+  ss.bytes = s->bytes;
+  ss.profile = s->profile ? s->profile - seq_profiles + 1 : 0;
+  memcpy(ss.alph, s->alph, sizeof(ss.alph));
+  memcpy(ss.ht, s->ht, sizeof(ss.ht));
+
+  len = sizeof(ss) + ss.seq_len * sizeof(rmt_data_t) + (ss.nbits + 7) / 8;
+  snap_write_rec(w, SNAP_SEQUENCE, len);
+  snap_write(w, &ss, sizeof(ss));
+  if (ss.seq_len)
+    snap_write(w, s->seq, ss.seq_len * sizeof(rmt_data_t));
+  if (ss.nbits)
+    snap_write(w, s->bits, (ss.nbits + 7) / 8);
+  snap_write_pad(w, len);
+}
+
+// "snapshot save /FILE"
+//
+static int cmd_snapshot_save(int argc, char **argv) {
+
+  struct snap_writer w = { 0 };
+  struct snap_hdr hdr = { 0 };
+  struct alias *al, **list;
+  struct ifcond *ifc;
+  unsigned int i, n;
+
+  // Aliases are stored in reverse order: loading inserts them to the list head,
+  // so the original order is restored
+  for (n = 0, al = atomic_load_explicit(&Aliases, memory_order_acquire); al; al = al->next)
+    n++;
+
+  list = NULL;
+  if (n && (list = (struct alias **)q_malloc(n * sizeof(struct alias *), MEM_TMP)) == NULL)
+    return CMD_FAILED;
+
+  for (i = 0, al = atomic_load_explicit(&Aliases, memory_order_acquire); al && i < n; al = al->next)
+    list[i++] = al;
+  n = i;
+
+  if ((w.fp = files_fopen(argv[2], "wb")) == NULL) {
+    if (list)
+      q_free(list);
+    return CMD_FAILED;
+  }
+
+  // Write a placeholder header first, it is rewritten when everything else is written
+  w.hash = 2166136261UL;
+  if (fwrite(&hdr, 1, sizeof(hdr), w.fp) != sizeof(hdr))
+    w.error = true;
+
+  // 1. Aliases, empty ones are saved too: they can be referenced by conditions
+  while (n--) {
+    al = list[n];
+    rw_lockr(&al->rw);
+    snap_save_alias(&w, al);
+    rw_unlockr(&al->rw);
+    hdr.naliases++;
+  }
+  if (list)
+    q_free(list);
+
+  // 2. Conditions
+  rw_lockr(&ifc_rw);
+  for (i = 0; i < IFC_LISTS; i++)
+    for (ifc = ifconds[i]; ifc; ifc = ifc->next) {
+      snap_save_ifcond(&w, ifc);
+      hdr.nifconds++;
+    }
+  rw_unlockr(&ifc_rw);
+
+  // 3. Sequences which were configured
+  for (i = 0; i < SEQUENCES_NUM; i++)
+    if (sequences[i].seq || sequences[i].bits) {
+      snap_save_seq(&w, i);
+      hdr.nseqs++;
+    }
+
+  hdr.magic = SNAP_MAGIC;
+  hdr.version = SNAP_VERSION;
+  hdr.hdr_size = sizeof(hdr);
+  hdr.size = w.size + sizeof(hdr);
+  hdr.hash = w.hash;
+
+  if (!w.error)
+    if (fseek(w.fp, 0, SEEK_SET) != 0 || fwrite(&hdr, 1, sizeof(hdr), w.fp) != sizeof(hdr))
+      w.error = true;
+
+  files_fclose(w.fp);
+
+  if (w.error) {
+    q_printf("%% <e>Failed to write \"%s\" (filesystem is full?)</>\r\n", argv[2]);
+    return CMD_FAILED;
+  }
+
+  q_printf("%% Saved %u aliases, %u conditions, %u sequences (%lu bytes)\r\n", hdr.naliases, hdr.nifconds, hdr.nseqs, hdr.size);
+  return 0;
+}
+
+// Make an argcargv_t out of /argc/ asciiz tokens located at /text/.
+// Allocations are the same as userinput_tokenize() makes, so userinput_unref() can free the result
+//
+static argcargv_t *snap_load_line(const struct snap_line *sl, const char *text) {
+
+  argcargv_t *a;
+  char *p;
+  int i;
+
+  if ((a = (argcargv_t *)q_malloc(sizeof(argcargv_t), MEM_ARGCARGV)) == NULL)
+    return NULL;
+
+  memset(a, 0, sizeof(*a));
+
+  // argify() allocates 2 extra pointers: cmd_exec() relies on argv[1] being writeable (see userinput_find_handler())
+  a->argv = (char **)q_malloc((sl->argc + 2) * sizeof(char *), MEM_ARGCARGV);
+  a->userinput = (char *)q_malloc(sl->text_len, MEM_ARGCARGV);
+
+  if (!a->argv || !a->userinput) {
+    if (a->argv)
+      q_free(a->argv);
+    if (a->userinput)
+      q_free(a->userinput);
+    q_free(a);
+    return NULL;
+  }
+
+  memcpy(a->userinput, text, sl->text_len);
+
+  // pointer fixups
+  for (p = a->userinput, i = 0; i < sl->argc; i++, p += strlen(p) + 1)
+    a->argv[i] = p;
+  a->argv[i] = a->argv[i + 1] = NULL;
+
+  a->argc = sl->argc;
+  a->ref = 1;
+  a->has_amp = sl->has_amp;
+  a->has_prio = sl->has_prio;
+  a->prio = sl->prio;
+  a->core = sl->core;
+
+  // Precache command handlers the same way cmd_alias_asterisk() does
+  if (!alias_is_stmt(a->argv[0])) {
+    const struct keywords_t *tmp = keywords_get();
+    keywords_set(main);
+    userinput_find_handler(a);
+    keywords_set_ptr(tmp);
+  }
+  return a;
+}
+
+// Check that /len/ bytes of asciiz strings at /p/ are consisting of exactly /count/ strings
+//
+static bool snap_strings_ok(const char *p, size_t len, unsigned int count) {
+  unsigned int n = 0;
+  if (!len || p[len - 1] != '\0')
+    return false;
+  while (len--)
+    if (*p++ == '\0')
+      n++;
+  return n == count;
+}
+
+// Load an alias record. Returns /false/ if the record is malformed
+//
+static bool snap_load_alias(const uint8_t *p, uint32_t len) {
+
+  const uint8_t *end = p + len, *q;
+  const struct snap_alias *sa = (const struct snap_alias *)p;
+  struct snap_line sl;
+  const char *name;
+  struct alias *al;
+  argcargv_t *a, *lines = NULL;
+  unsigned int i;
+
+  if (len < sizeof(*sa) || sizeof(*sa) + sa->name_len > len)
+    return false;
+
+  name = (const char *)(sa + 1);
+  if (!sa->name_len || name[sa->name_len - 1] != '\0')
+    return false;
+
+  p = (const uint8_t *)name + sa->name_len;
+
+  // Validate every line first: a malformed record must not leave a half-loaded alias behind.
+  // Lines follow a variable-length name, so snap_line headers are copied out rather than
+  // accessed in place (may be unaligned)
+  for (q = p, i = 0; i < sa->nlines; i++) {
+    if (q + sizeof(sl) > end)
+      return false;
+    memcpy(&sl, q, sizeof(sl));
+    q += sizeof(sl);
+    if (!sl.argc || q + sl.text_len > end || !snap_strings_ok((const char *)q, sl.text_len, sl.argc))
+      return false;
+    q += sl.text_len;
+  }
+
+  // Build the new content aside, so running out of memory leaves the existing alias intact
+  for (i = 0; i < sa->nlines; i++) {
+    memcpy(&sl, p, sizeof(sl));
+    p += sizeof(sl);
+    if ((a = snap_load_line(&sl, (const char *)p)) == NULL)
+      goto fail;
+    alias_add_line(&lines, a);
+    userinput_unref(a); // alias_add_line() holds its own reference
+    p += sl.text_len;
+  }
+
+  if ((al = alias_create_or_find(name)) == NULL)
+    goto fail;
+
+  rw_lockw(&al->rw);
+  alias_delete_line(&al->lines, -1);
+  al->lines = lines;
+
+  // Compile once, after all lines were added
+  alias_compile0(al);
+  rw_unlockw(&al->rw);
+
+  return true;
+fail:
+  alias_delete_line(&lines, -1);
+  return false;
+}
+
+// Load an "if" or "every" record. Returns /false/ if the record is malformed;
+// conditions which can not be restored (unknown variable) are skipped with a warning
+//
+static bool snap_load_ifcond(const uint8_t *p, uint32_t len) {
+
+  const struct snap_ifcond *si = (const struct snap_ifcond *)p;
+  const char *var_name, *exec;
+  struct convar_cond var, *pvar = NULL;
+  struct ifcond *ifc;
+  uint8_t trigger_pin;
+
+  if (len < sizeof(*si) || sizeof(*si) + si->var_name_len + si->exec_len > len)
+    return false;
+
+  var_name = (const char *)(si + 1);
+  exec = var_name + si->var_name_len;
+
+  if ((si->var_name_len && var_name[si->var_name_len - 1] != '\0') || !si->exec_len || exec[si->exec_len - 1] != '\0')
+    return false;
+
+  trigger_pin = si->trigger_pin;
+  if (trigger_pin >= IFC_LISTS || (trigger_pin < NO_TRIGGER && !pin_exist_silent(trigger_pin)))
+    return false;
+
+  // Variable condition: resolve the variable again, its address could change since the snapshot was made
+  if (si->var_name_len) {
+    struct convar_handle h;
+
+    if (!convar_resolve(var_name, &h, false) || h.isp || h.size != si->var_size ||
+        si->var_type != (h.isf ? CONVAR_COND_FLOAT : (h.isu ? CONVAR_COND_UNSIGNED : CONVAR_COND_SIGNED))) {
+      q_printf("%% Variable \"%s\" is unknown or has changed its type, condition is skipped\r\n", var_name);
+      return true;
+    }
+
+    memset(&var, 0, sizeof(var));
+    var.ptr = h.ptr;
+    var.name = (char *)var_name; // copied by ifc_create()
+    var.imm = si->var_imm;
+    var.size = si->var_size;
+    var.type = si->var_type;
+    var.op = si->var_op;
+    pvar = &var;
+  }
+
+  ifc = ifc_create(trigger_pin,
+                   si->rising,
+                   ((uint64_t)si->high1 << 32) | si->high,
+                   ((uint64_t)si->low1 << 32) | si->low,
+                   si->limit,
+                   pvar,
+                   exec);
+  if (!ifc)
+    return false;
+
+  ifc->poll_interval = si->poll_interval;
+  ifc->is_inline = si->is_inline;
+  ifc->disabled = si->disabled;
+  if (si->rlimit) {
+    ifc->has_rlimit = 1;
+    ifc->rlimit = si->rlimit;
+  }
+  if (si->delay_ms) {
+    ifc->has_delay = 1;
+    ifc->delay_ms = si->delay_ms;
+  }
+
+  // Same as cmd_if() does
+  if (trigger_pin < NO_TRIGGER)
+    ifc_claim_interrupt(trigger_pin);
+  else if (trigger_pin != VAR_IDX)
+    ifc_claim_timer(ifc);
+
+  return true;
+}
+
+// Load a sequence record. Returns /false/ if the record is malformed or if we are out of memory
+//
+static bool snap_load_seq(const uint8_t *p, uint32_t len) {
+
+  const struct snap_seq *ss = (const struct snap_seq *)p;
+  const uint8_t *bits;
+  struct sequence *s;
+  rmt_data_t *seq = NULL;
+  uint8_t *sbits = NULL;
+
+  // seq_len is checked against the record length before it is multiplied: a crafted seq_len would
+  // wrap the 32-bit product around and pass the check
+  if (len < sizeof(*ss) || ss->num >= SEQUENCES_NUM || ss->seq_len < 0 ||
+      (uint32_t)ss->seq_len > (len - sizeof(*ss)) / sizeof(rmt_data_t) ||
+      ((uint64_t)ss->nbits + 7) / 8 > len - sizeof(*ss) - ss->seq_len * sizeof(rmt_data_t) ||
+      ss->profile > sizeof(seq_profiles) / sizeof(seq_profiles[0]))
+    return false;
+
+  bits = (const uint8_t *)(ss + 1) + ss->seq_len * sizeof(rmt_data_t);
+
+  // Allocate first: on failure the sequence is left as it was
+  if (ss->seq_len && (seq = (rmt_data_t *)q_malloc(ss->seq_len * sizeof(rmt_data_t), MEM_SEQUENCE)) == NULL)
+    return false;
+
+  // One extra bit is reserved for padding, as cmd_seq_bits() does
+  if (ss->nbits && (sbits = (uint8_t *)q_malloc(ss->nbits / 8 + 1, MEM_SEQUENCE)) == NULL) {
+    if (seq)
+      q_free(seq);
+    return false;
+  }
+
+  s = &sequences[ss->num];
+  seq_freemem(ss->num);
+
+  s->tick = ss->tick;
+  s->mod_duty = ss->mod_duty;
+  s->mod_freq = ss->mod_freq;
+  s->mod_high = ss->mod_high;
+  s->filter_ns = ss->filter_ns;
+  s->eot = ss->eot;
+  s->idle_thresh = ss->idle_thresh;
+  s->loop_count = ss->loop_count;
+  memcpy(s->alph, ss->alph, sizeof(s->alph));
+  memcpy(s->ht, ss->ht, sizeof(s->ht));
+
+  // Profile settings are saved along with the rest: only the profile itself (frame packing, decoder) is restored
+  s->profile = ss->profile ? &seq_profiles[ss->profile - 1] : NULL;
+  s->decoder = s->profile ? s->profile->decoder : NULL;
+
+  s->seq_len = ss->seq_len;
+  if ((s->seq = seq) != NULL)
+    memcpy(s->seq, ss + 1, ss->seq_len * sizeof(rmt_data_t));
+
+  if ((s->bits = sbits) != NULL) {
+    memcpy(s->bits, bits, (ss->nbits + 7) / 8);
+    s->nbits = ss->nbits;
+    s->bytes = ss->bytes;
+  }
+
+  // Streamed sequences are saved without levels
+  if (!s->seq && s->bits)
+    seq_compile(ss->num);
+
+  return true;
+}
+
+// "snapshot load /FILE"
+//
+static int cmd_snapshot_load(int argc, char **argv) {
+
+  FILE *fp;
+  uint8_t *buf, *p, *end;
+  const struct snap_hdr *hdr;
+  const struct snap_rec *rec;
+  long size;
+  bool ok;
+  unsigned int records = 0, errors = 0;
+  uint64_t t0 = q_micros();
+
+  if ((fp = files_fopen(argv[2], "rb")) == NULL)
+    return CMD_FAILED;
+
+  // Read whole file at once
+  if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < (long)sizeof(struct snap_hdr) || fseek(fp, 0, SEEK_SET) != 0) {
+    files_fclose(fp);
+    q_print("% <e>Not a snapshot file</>\r\n");
+    return CMD_FAILED;
+  }
+
+  if ((buf = (uint8_t *)q_malloc(size, MEM_TMP)) == NULL) {
+    files_fclose(fp);
+    return CMD_FAILED;
+  }
+
+  ok = fread(buf, 1, size, fp) == (size_t)size;
+  files_fclose(fp);
+
+  hdr = (const struct snap_hdr *)buf;
+  if (!ok || hdr->magic != SNAP_MAGIC || hdr->hdr_size != sizeof(*hdr) || hdr->size != size) {
+    q_print("% <e>Not a snapshot file, or the file is truncated</>\r\n");
+    goto failed;
+  }
+
+  if (hdr->version != SNAP_VERSION) {
+    q_printf("%% <e>Unsupported snapshot version %u (expected %u)</>\r\n", hdr->version, SNAP_VERSION);
+    goto failed;
+  }
+
+  if (hdr->hash != snap_hash(2166136261UL, buf + sizeof(*hdr), size - sizeof(*hdr))) {
+    q_print("% <e>Snapshot file is corrupted (hash mismatch)</>\r\n");
+    goto failed;
+  }
+
+  // Records
+  for (p = buf + sizeof(*hdr), end = buf + size; p + sizeof(*rec) <= end; p += sizeof(*rec) + rec->len) {
+
+    rec = (const struct snap_rec *)p;
+    if (rec->len > end - p - sizeof(*rec)) {
+      errors++;
+      break;
+    }
+
+    switch (rec->type) {
+      case SNAP_ALIAS:    ok = snap_load_alias(p + sizeof(*rec), rec->len); break;
+      case SNAP_IFCOND:   ok = snap_load_ifcond(p + sizeof(*rec), rec->len); break;
+      case SNAP_SEQUENCE: ok = snap_load_seq(p + sizeof(*rec), rec->len); break;
+      default:
+        VERBOSE(q_printf("%% Unknown snapshot record type %u, skipped\r\n", rec->type));
+        ok = true;
+    }
+    records++;
+    if (!ok)
+      errors++;
+  }
+
+  q_free(buf);
+  q_printf("%% Loaded %u records (%u errors) in %lu us\r\n", records, errors, (unsigned long)(q_micros() - t0));
+  return errors ? CMD_FAILED : 0;
+
+failed:
+  q_free(buf);
+  return CMD_FAILED;
+}
+
+// "snapshot save|load /FILE"
+//
+static int cmd_snapshot(int argc, char **argv) {
+
+  if (argc < 3)
+    return CMD_MISSING_ARG;
+
+  if (!q_strcmp(argv[1], "save"))
+    return cmd_snapshot_save(argc, argv);
+
+  if (!q_strcmp(argv[1], "load"))
+    return cmd_snapshot_load(argc, argv);
+
+  return 1;
+}
+
+#endif // WITH_ALIAS && WITH_FS
+#endif // COMPILING_ESPSHELL
@@ -310,6 +310,7 @@ static INLINE bool is_background_task() {
 //
 // 1. amp_helper_task() (used to execute shell commands in the background) uses /.aa/.
 // 2. alias_helper_task() (used to run aliases in the background) uses /.al/ and /.delay_ms/
+//    Aliases started by "if" and "every" also set /.ifc/ and /.tsta/ to account the event-to-execution latency
 //
 // Although /.next/, /.aa/, and /.al/ are never used at the same time, putting them into a union is discouraged. 
 // Using a union would technically work but defeats the idea of having "permanent pointers"
@@ -319,6 +320,8 @@ struct helper_arg {
     struct alias            *al;
     argcargv_t              *aa;
     uint32_t                 delay_ms;
+    struct ifcond           *ifc;      // ifcond which triggered alias execution, or NULL
+    uint64_t                 tsta;     // timestamp of the ifcond event (microseconds)
     __typeof__(Context)      context;  // Task must copy this into the /Context/ thread variable
     const struct keywords_t *keywords; // Task must copy this into the /keywords/ thread variable
     char                    *cwd;      // Task must call files_set_cwd( ha->cwd )
@@ -347,6 +350,7 @@ static struct helper_arg *ha_get() {
   // to set its corresponding "global" (actually, _Thread_local) variables. The rest is populated by the caller
   //
   if (NULL != (ret = mb_get(&ha_pool))) {
+    ret->ifc = NULL;
     ret->context = context_get();
     ret->keywords = keywords_get();
     ret->cwd = q_strdup(files_get_cwd(), MEM_TMP); // its ok if strdup() return NULL; files_get_cwd() never return NULL
@@ -733,6 +733,11 @@ static int userinput_read_ctype(int argc,         // IN
         *is_float = true;
       } else
 
+        if (!q_strcmp(argv[start], "double")) {
+        size = sizeof(double);
+        *is_float = true;
+      } else
+
         // Detect arrays
         if (!q_strcmp("char[", argv[start]) || argv[start][0] == '[' || argv[start][0] == ']') *is_blob = true;
         else
@@ -0,0 +1,493 @@
+/*
+ * This file is a part of the ESPShell Arduino library (Espressif's ESP32-family CPUs)
+ *
+ * Latest source code can be found at Github: https://github.com/vvb333007/espshell/
+ * Stable releases: https://github.com/vvb333007/espshell/tags
+ *
+ * Feel free to use this code as you wish: it is absolutely free for commercial and
+ * non-commercial, education purposes.  Credits, however, would be greatly appreciated.
+ *
+ * Author: Viacheslav Logunov <vvb333007@gmail.com>
+ */
+
+// -- Variable watch --
+//
+// "var watch NAME [INTERVAL]"   - sample a sketch variable every INTERVAL milliseconds, log its changes
+// "var unwatch NAME|all"        - stop watching
+// "var watch"                   - display watched variables
+// "var watch log [csv|bin] [FILE] [follow]" - display or save logged changes
+//
+// A single sampler task ("watch") reads watched variables, each at its own rate. Variables are resolved
+// once, when the watch is added (see convar_resolve()), so sampling a variable is a memcpy() and a
+// compare. Only active watch slots are visited, the rest of the variables registry is never touched.
+//
+// When a value changes, a record (timestamp, watch slot, new value) is written to a preallocated ring
+// buffer. There is one writer (the sampler task) and one reader ("var watch log"); the reader detects
+// records which were overwritten before they were read and counts them as dropped.
+//
+// The sampler task is started by the first "var watch" and exits when the last variable is unwatched.
+//
+
+#if COMPILING_ESPSHELL
+
+#define WATCH_MAX          16   // max number of watched variables
+#define WATCH_RING_SIZE    256  // change log size, records. Must be a power of 2
+#define WATCH_INTERVAL_DEF 10   // default sampling interval, milliseconds
+#define WATCH_LOG_POLL     50   // "var watch log follow" polls the ring buffer this often, milliseconds
+
+#define WATCH_BIN_MAGIC    0x54415745  // "EWAT", binary log header
+
+struct watch {
+  struct convar_handle h;                     // resolved variable
+  char        name[CONVAR_NAMELEN_MAX + 16];  // name as it was typed (can be an array element)
+  uint32_t    interval;                       // sampling interval, ms
+  uint32_t    next;                           // next sampling time, ms (q_millis())
+  uint32_t    changes;                        // number of changes seen so far
+  composite_t last;                           // last sampled value
+  uint16_t    gen;                            // generation: changes every time the slot is (re)assigned
+};
+
+// Change log record
+struct watch_rec {
+  uint64_t    ts;    // q_micros() when the change was detected
+  composite_t val;   // new value
+  uint8_t     slot;  // watch slot (index in Watches[])
+  uint16_t    gen;   // watch slot generation. Records of unwatched variables are dropped
+};
+
+static struct watch      Watches[WATCH_MAX] = { 0 };
+static uint32_t          Watch_active = 0;         // bitmask of used Watches[] slots
+static mutex_t           Watch_mux = MUTEX_INIT;   // protects Watches[] and Watch_active
+static task_t            Watch_task = NULL;        // sampler task, NULL if not running
+static uint16_t          Watch_gen = 0;            // last assigned slot generation
+
+static struct watch_rec *Watch_ring = NULL;        // allocated by the first "var watch", never freed
+static _Atomic uint32_t  Watch_head = 0;           // number of records written so far
+static uint32_t          Watch_tail = 0;           // number of records consumed by "var watch log"
+static uint32_t          Watch_dropped = 0;        // records overwritten before they were read
+static mutex_t           Watch_rmux = MUTEX_INIT;  // serializes readers
+
+// Sample all watched variables which are due, log changes.
+// Returns number of milliseconds until the next sampling. Must be called with Watch_mux locked
+//
+static uint32_t watch_sample0() {
+
+  uint32_t now = q_millis(), wait = DELAY_INFINITE, m;
+
+  for (m = Watch_active; m; m &= m - 1) {
+
+    struct watch *w = &Watches[__builtin_ctz(m)];
+    int32_t left = (int32_t)(w->next - now);
+
+    if (left <= 0) {
+
+      composite_t val = { 0 };
+
+      memcpy(&val, w->h.ptr, w->h.size);
+
+      if (memcmp(&val, &w->last, sizeof(val))) {
+
+        uint32_t head = atomic_load_explicit(&Watch_head, memory_order_relaxed);
+        struct watch_rec *r = &Watch_ring[head & (WATCH_RING_SIZE - 1)];
+
+        r->ts = q_micros();
+        r->val = val;
+        r->slot = w - Watches;
+        r->gen = w->gen;
+        atomic_store_explicit(&Watch_head, head + 1, memory_order_release);
+
+        w->last = val;
+        w->changes++;
+      }
+
+      // Skip missed samples instead of trying to catch up
+      w->next += w->interval;
+      if ((int32_t)(w->next - now) <= 0)
+        w->next = now + w->interval;
+      left = w->interval;
+    }
+
+    if ((uint32_t)left < wait)
+      wait = left;
+  }
+
+  return wait;
+}
+
+// Sampler task. Sleeps until the next variable is due or until it is signalled
+// (watch list has changed). Exits when there is nothing to watch
+//
+static void watch_task(void *arg) {
+
+  uint32_t wait;
+
+  while (true) {
+
+    mutex_lock(Watch_mux);
+    if (!Watch_active) {
+      Watch_task = NULL;
+      mutex_unlock(Watch_mux);
+      break;
+    }
+    wait = watch_sample0();
+    mutex_unlock(Watch_mux);
+
+    task_wait_for_signal(NULL, wait);
+  }
+
+  task_finished();
+}
+
+// Print the value of a watched variable
+//
+static char *watch_sprint_value(const struct watch *w, const composite_t *val, char *buf, size_t len) {
+  q_sprint_elem(buf, len, val, w->h.size, w->h.isu, w->h.isf, w->h.isp, PA_NATIVE);
+  return buf;
+}
+
+// Find a watch slot by variable name. Must be called with Watch_mux locked
+// Returns slot number or -1
+//
+static int watch_find0(const char *name) {
+
+  uint32_t m;
+
+  for (m = Watch_active; m; m &= m - 1) {
+    int i = __builtin_ctz(m);
+    if (!strcmp(Watches[i].name, name))
+      return i;
+  }
+  return -1;
+}
+
+// "var watch NAME [INTERVAL]"
+// Start watching a variable or change its sampling interval
+//
+static int watch_add(int argc, char **argv) {
+
+  struct convar_handle h;
+  unsigned int interval = WATCH_INTERVAL_DEF;
+  const char *name = argv[2][0] == '$' ? argv[2] + 1 : argv[2];
+  int i, ret = 0;
+
+  if (argc > 3 && ((interval = q_atol(argv[3], DEF_BAD)) == DEF_BAD || interval == 0)) {
+    HELP(q_print("% <e>Sampling interval (milliseconds, 1 or more) is expected</>\r\n"));
+    return 3;
+  }
+
+  if (!convar_resolve(name, &h, true))
+    return 2;
+
+  if (!is_valid_address(h.ptr, h.size)) {
+    q_printf("%% <e>Variable address %p is not readable</>\r\n", h.ptr);
+    return 2;
+  }
+
+  // Change log is allocated once and never freed
+  if (!Watch_ring && (Watch_ring = (struct watch_rec *)q_malloc(sizeof(struct watch_rec) * WATCH_RING_SIZE, MEM_STATIC)) == NULL)
+    return CMD_FAILED;
+
+  mutex_lock(Watch_mux);
+
+  if ((i = watch_find0(name)) < 0) {
+
+    if (Watch_active == (uint32_t)((1ULL << WATCH_MAX) - 1)) {
+      q_printf("%% <e>Too many watched variables (max is %u)</>\r\n", WATCH_MAX);
+      ret = CMD_FAILED;
+      goto unlock;
+    }
+
+    i = __builtin_ctz(~Watch_active);
+    memset(&Watches[i], 0, sizeof(Watches[i]));
+    strlcpy(Watches[i].name, name, sizeof(Watches[i].name));
+    Watches[i].h = h;
+    Watches[i].gen = ++Watch_gen;
+    memcpy(&Watches[i].last, h.ptr, h.size);
+    Watch_active |= 1UL << i;
+  }
+
+  Watches[i].interval = interval;
+  Watches[i].next = q_millis() + interval;
+
+  // Start the sampler task or make it to reschedule
+  if (Watch_task)
+    task_signal(Watch_task, SIGNAL_HUP);
+  else if ((Watch_task = task_new(watch_task, NULL, "watch", shell_core)) == NULL) {
+    q_print("% <e>Failed to start the sampler task</>\r\n");
+    Watch_active &= ~(1UL << i);
+    ret = CMD_FAILED;
+    goto unlock;
+  }
+
+  HELP(q_printf("%% Watching \"%s\" every %u ms, use \"var watch log\" to see changes\r\n", name, interval));
+unlock:
+  mutex_unlock(Watch_mux);
+  return ret;
+}
+
+// "var unwatch NAME|all"
+//
+static int watch_delete(int argc, char **argv) {
+
+  const char *name;
+  int i;
+
+  if (argc < 3)
+    return CMD_MISSING_ARG;
+
+  name = argv[2][0] == '$' ? argv[2] + 1 : argv[2];
+
+  mutex_lock(Watch_mux);
+  if (!strcmp(name, "all"))
+    Watch_active = 0;
+  else if ((i = watch_find0(name)) >= 0)
+    Watch_active &= ~(1UL << i);
+  else {
+    mutex_unlock(Watch_mux);
+    q_printf("%% Variable \"%s\" is not watched\r\n", name);
+    return 2;
+  }
+
+  // Sampler task exits by itself when there is nothing to watch
+  if (Watch_task)
+    task_signal(Watch_task, SIGNAL_HUP);
+  mutex_unlock(Watch_mux);
+
+  return 0;
+}
+
+// "var watch"
+//
+static int watch_show() {
+
+  uint32_t m, n = 0;
+  char val[32];
+
+  mutex_lock(Watch_mux);
+  for (m = Watch_active; m; m &= m - 1) {
+
+    struct watch *w = &Watches[__builtin_ctz(m)];
+
+    if (!n++)
+      q_print("% Watched variables:\r\n<r>"
+              "% Variable name    | Interval, ms |  Changes  | Last value     </>\r\n"
+              "%------------------+--------------+-----------+----------------\r\n");
+
+    q_printf("%%<i>%17s</> | %12lu | %9lu | %s\r\n", w->name, w->interval, w->changes, watch_sprint_value(w, &w->last, val, sizeof(val)));
+  }
+  mutex_unlock(Watch_mux);
+
+  if (!n)
+    q_print("% No variables are watched. Use \"var watch NAME\" to start\r\n");
+  else
+    q_printf("%% Change log: %lu records pending, %lu dropped\r\n", atomic_load_explicit(&Watch_head, memory_order_acquire) - Watch_tail, Watch_dropped);
+
+  return 0;
+}
+
+// Log output formats
+#define WATCH_FMT_TEXT 0
+#define WATCH_FMT_CSV  1
+#define WATCH_FMT_BIN  2
+
+// Write binary log header: magic, then descriptors of watch slots which are in use.
+// Every descriptor is: slot, size, type (CONVAR_COND_SIGNED/UNSIGNED/FLOAT), name length, name
+// Records are: timestamp (4 bytes, microseconds, wraps every 71 minutes), slot (1 byte), value (size bytes)
+//
+static bool watch_write_hdr(FILE *fp) {
+
+  uint32_t magic = WATCH_BIN_MAGIC, m;
+  uint8_t d[4];
+  bool ok;
+
+  mutex_lock(Watch_mux);
+  ok = fwrite(&magic, 1, sizeof(magic), fp) == sizeof(magic);
+  d[0] = __builtin_popcount(Watch_active);
+  ok = ok && fwrite(d, 1, 1, fp) == 1;
+
+  for (m = Watch_active; ok && m; m &= m - 1) {
+
+    struct watch *w = &Watches[__builtin_ctz(m)];
+
+    d[0] = w - Watches;
+    d[1] = w->h.size;
+    d[2] = w->h.isf ? CONVAR_COND_FLOAT : (w->h.isu || w->h.isp ? CONVAR_COND_UNSIGNED : CONVAR_COND_SIGNED);
+    d[3] = strlen(w->name);
+    ok = fwrite(d, 1, 4, fp) == 4 && fwrite(w->name, 1, d[3], fp) == d[3];
+  }
+  mutex_unlock(Watch_mux);
+
+  return ok;
+}
+
+// Read and output all pending records. Must be called with Watch_rmux locked
+// Returns number of records processed or -1 on a write error
+//
+static int watch_drain0(FILE *fp, int fmt) {
+
+  uint32_t head = atomic_load_explicit(&Watch_head, memory_order_acquire);
+  int n = 0;
+
+  // Writer has lapped us: skip records which were overwritten. When the difference is exactly WATCH_RING_SIZE,
+  // the next record the writer writes goes to the /tail/ slot: it is skipped as well
+  if (head - Watch_tail >= WATCH_RING_SIZE) {
+    Watch_dropped += head - Watch_tail - WATCH_RING_SIZE + 1;
+    Watch_tail = head - WATCH_RING_SIZE + 1;
+  }
+
+  while (Watch_tail != head) {
+
+    struct watch_rec r = Watch_ring[Watch_tail & (WATCH_RING_SIZE - 1)];
+    struct watch ws;
+    const struct watch *w = &ws;
+    bool stale;
+    char val[32];
+
+    // Could have been overwritten while we were copying it. The fence orders the copy above before
+    // the /Watch_head/ re-read
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&Watch_head, memory_order_relaxed) - Watch_tail >= WATCH_RING_SIZE) {
+      Watch_dropped++;
+      Watch_tail++;
+      continue;
+    }
+    Watch_tail++;
+
+    // The variable could have been unwatched, and its slot reused, after the record was written:
+    // such records are dropped. Slot is copied as "var watch/unwatch" may change it while we print
+    mutex_lock(Watch_mux);
+    if ((stale = !(Watch_active & (1UL << r.slot)) || Watches[r.slot].gen != r.gen) == false)
+      ws = Watches[r.slot];
+    mutex_unlock(Watch_mux);
+
+    if (stale)
+      continue;
+    n++;
+
+    if (fmt == WATCH_FMT_BIN) {
+      uint32_t ts = r.ts;
+      if (fwrite(&ts, 1, sizeof(ts), fp) != sizeof(ts) ||
+          fwrite(&r.slot, 1, 1, fp) != 1 ||
+          fwrite(&r.val, 1, w->h.size, fp) != w->h.size)
+        return -1;
+      continue;
+    }
+
+    watch_sprint_value(w, &r.val, val, sizeof(val));
+
+    if (fmt == WATCH_FMT_CSV) {
+      if (fp)
+        fprintf(fp, "%llu,%s,%s\n", r.ts, w->name, val);
+      else
+        q_printf("%llu,%s,%s\r\n", r.ts, w->name, val);
+    } else {
+      if (fp)
+        fprintf(fp, "[%llu.%06llu] %s = %s\n", r.ts / 1000000ULL, r.ts % 1000000ULL, w->name, val);
+      else
+        q_printf("%% [%llu.%06llu] <i>%s</> = <g>%s</>\r\n", r.ts / 1000000ULL, r.ts % 1000000ULL, w->name, val);
+    }
+  }
+
+  return n;
+}
+
+// "var watch log [csv|bin] [FILE] [follow]"
+// Display or save logged changes. Without "follow" outputs what is logged so far, with "follow"
+// keeps streaming until interrupted by a keypress or by the "kill" command
+//
+static int watch_log(int argc, char **argv) {
+
+  int fmt = WATCH_FMT_TEXT, i, n;
+  bool follow = false, fg = is_foreground_task();
+  const char *path = NULL;
+  FILE *fp = NULL;
+  uint32_t sig;
+
+  for (i = 3; i < argc; i++)
+    if (!q_strcmp(argv[i], "csv"))
+      fmt = WATCH_FMT_CSV;
+    else if (!q_strcmp(argv[i], "bin"))
+      fmt = WATCH_FMT_BIN;
+    else if (!q_strcmp(argv[i], "follow"))
+      follow = true;
+    else
+      path = argv[i];
+
+  if (!Watch_ring) {
+    q_print("% Nothing was logged yet. Use \"var watch NAME\" first\r\n");
+    return 0;
+  }
+
+  if (path) {
+#if WITH_FS
+    if ((fp = files_fopen(path, fmt == WATCH_FMT_BIN ? "wb" : "a")) == NULL)
+      return CMD_FAILED;
+#else
+    HELP(q_print("% <e>File output requires filesystem support (WITH_FS)</>\r\n"));
+    return CMD_FAILED;
+#endif
+  } else if (fmt == WATCH_FMT_BIN) {
+    HELP(q_print("% <e>Binary log can only be written to a file</>\r\n"));
+    return 3;
+  }
+
+  if (fmt == WATCH_FMT_BIN && !watch_write_hdr(fp))
+    goto write_error;
+
+  if (follow)
+    HELP(q_printf("%% Streaming changes, %s to stop\r\n", fg ? "press <Enter>" : "use \"kill\""));
+
+  mutex_lock(Watch_rmux);
+  do {
+    if ((n = watch_drain0(fp, fmt)) < 0) {
+      mutex_unlock(Watch_rmux);
+      goto write_error;
+    }
+
+    if (follow && !n) {
+      if (fp)
+        fflush(fp);
+      if (fg) {
+        q_delay(WATCH_LOG_POLL);
+        if (anykey_pressed())
+          break;
+      } else if (task_wait_for_signal(&sig, WATCH_LOG_POLL))
+        break;
+    }
+  } while (follow);
+  mutex_unlock(Watch_rmux);
+
+#if WITH_FS
+  if (fp)
+    files_fclose(fp);
+#endif
+  return 0;
+
+write_error:
+  q_print("% <e>Write error</>\r\n");
+#if WITH_FS
+  if (fp)
+    files_fclose(fp);
+#endif
+  return CMD_FAILED;
+}
+
+// "var watch ..." and "var unwatch ..."
+// Called by cmd_var() when its first argument is "watch" or "unwatch"
+//
+static int cmd_var_watch(int argc, char **argv) {
+
+  if (!strcmp(argv[1], "unwatch"))
+    return watch_delete(argc, argv);
+
+  if (argc < 3)
+    return watch_show();
+
+  // A variable named "log" can be watched as "var watch $log"
+  if (!strcmp(argv[2], "log"))
+    return watch_log(argc, argv);
+
+  return watch_add(argc, argv);
+}
+
+#endif // #if COMPILING_ESPSHELL